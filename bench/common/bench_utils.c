@@ -0,0 +1,9 @@
+#include <stdint.h>
+
+#include "bench_utils.h"
+
+int compare_u64(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/**
+ * Helpers shared by the benchmarks.
+ */
+
+/**
+ * Compare two uint64_t, to sort the measures with qsort().
+ *
+ * \param a A pointer to the first uint64_t.
+ * \param b A pointer to the second uint64_t.
+ *
+ * \returns a negative value if a is lower than b, a positive value if it's
+ *          greater, or 0 if they are equal.
+ */
+int compare_u64(const void *a, const void *b);
@@ -0,0 +1,48 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+
+#include "cycle_counter.h"
+#include "log.h"
+
+static int counter_fd = -1;
+
+bool cycle_counter_init(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // glibc has no wrapper for perf_event_open().
+    counter_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counter_fd < 0) {
+        log_debugf("failed to open the cycle counter: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void cycle_counter_quit(void) {
+    if (counter_fd < 0) return;
+    close(counter_fd);
+    counter_fd = -1;
+}
+
+uint64_t cycle_counter_read(void) {
+    uint64_t cycles;
+    if (counter_fd < 0 ||
+        read(counter_fd, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+        return 0;
+    }
+
+    return cycles;
+}
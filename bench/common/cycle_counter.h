@@ -0,0 +1,33 @@
+#pragma once
+
+/**
+ * Counter of the CPU cycles spent by the calling thread in user space, read
+ * from the hardware counters through perf_event_open().
+ *
+ * The counter is unavailable in most virtual machines and when
+ * perf_event_paranoid forbids it, so the benchmarks report the cycles only
+ * when cycle_counter_init() succeeds.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Open the counter of the calling thread.
+ *
+ * \returns true on success, or false if the counter is unavailable.
+ */
+bool cycle_counter_init(void);
+
+/**
+ * Close the counter, if it was opened.
+ */
+void cycle_counter_quit(void);
+
+/**
+ * Read the counter.
+ *
+ * \returns the number of cycles since the counter was opened, or 0 if it isn't
+ *          available.
+ */
+uint64_t cycle_counter_read(void);
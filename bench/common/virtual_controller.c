@@ -0,0 +1,290 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <linux/uinput.h>
+
+#include "log.h"
+#include "virtual_controller.h"
+
+#define VIRTUAL_CONTROLLER_NAME "desktop-controller virtual controller"
+#define VIRTUAL_CONTROLLER_WAIT 2000  // ms
+
+// Buttons of the virtual controller
+#define VIRTUAL_CONTROLLER_BUTTONS \
+    BUTTON(BTN_SOUTH)              \
+    BUTTON(BTN_EAST)               \
+    BUTTON(BTN_NORTH)              \
+    BUTTON(BTN_WEST)               \
+    BUTTON(BTN_TL)                 \
+    BUTTON(BTN_TR)                 \
+    BUTTON(BTN_SELECT)             \
+    BUTTON(BTN_START)              \
+    BUTTON(BTN_MODE)               \
+    BUTTON(BTN_THUMBL)             \
+    BUTTON(BTN_THUMBR)
+
+// Axes of the virtual controller with their minimum and maximum values
+#define VIRTUAL_CONTROLLER_AXES \
+    AXIS(ABS_X, -32768, 32767)  \
+    AXIS(ABS_Y, -32768, 32767)  \
+    AXIS(ABS_RX, -32768, 32767) \
+    AXIS(ABS_RY, -32768, 32767) \
+    AXIS(ABS_Z, 0, 255)         \
+    AXIS(ABS_RZ, 0, 255)        \
+    AXIS(ABS_HAT0X, -1, 1)      \
+    AXIS(ABS_HAT0Y, -1, 1)
+
+struct _VirtualController {
+    int fd;
+    char path[PATH_MAX];
+
+    /**
+     * Thread answering the force feedback requests, which block the process
+     * using the controller until they are answered.
+     */
+    pthread_t ff_thread;
+    bool ff_thread_started;
+    int stop_fd;
+};
+
+/**
+ * Answer a force feedback request of the kernel.
+ *
+ * \param controller A pointer to the virtual controller.
+ * \param event The event of the request.
+ */
+static void virtual_controller_handle_ff(VirtualController *controller,
+                                         const struct input_event *event) {
+    if (event->code == UI_FF_UPLOAD) {
+        struct uinput_ff_upload upload;
+        memset(&upload, 0, sizeof(upload));
+        upload.request_id = event->value;
+        if (ioctl(controller->fd, UI_BEGIN_FF_UPLOAD, &upload) < 0) return;
+        upload.retval = 0;
+        ioctl(controller->fd, UI_END_FF_UPLOAD, &upload);
+    } else if (event->code == UI_FF_ERASE) {
+        struct uinput_ff_erase erase;
+        memset(&erase, 0, sizeof(erase));
+        erase.request_id = event->value;
+        if (ioctl(controller->fd, UI_BEGIN_FF_ERASE, &erase) < 0) return;
+        erase.retval = 0;
+        ioctl(controller->fd, UI_END_FF_ERASE, &erase);
+    }
+}
+
+/**
+ * Main function of the force feedback thread.
+ *
+ * \param data A pointer to the virtual controller.
+ *
+ * \returns NULL.
+ */
+static void *virtual_controller_ff_thread(void *data) {
+    VirtualController *controller = data;
+
+    struct pollfd fds[] = {
+        {.fd = controller->fd, .events = POLLIN},
+        {.fd = controller->stop_fd, .events = POLLIN},
+    };
+    for (;;) {
+        if (poll(fds, sizeof(fds) / sizeof(*fds), -1) < 0) {
+            if (errno == EINTR) continue;
+            log_errorf("failed to poll uinput: %s", strerror(errno));
+            return NULL;
+        }
+        if (fds[1].revents) return NULL;
+
+        struct input_event event;
+        while (read(controller->fd, &event, sizeof(event)) == sizeof(event)) {
+            if (event.type == EV_UINPUT) {
+                virtual_controller_handle_ff(controller, &event);
+            }
+        }
+    }
+}
+
+/**
+ * Find the event device of the virtual controller and wait for it to be
+ * accessible.
+ *
+ * \param controller A pointer to the virtual controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool virtual_controller_find_path(VirtualController *controller) {
+    char sysname[64];
+    if (ioctl(controller->fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+        log_errorf("failed to get uinput device name: %s", strerror(errno));
+        return false;
+    }
+
+    char sys_path[PATH_MAX];
+    snprintf(sys_path, sizeof(sys_path), "/sys/devices/virtual/input/%s",
+             sysname);
+    DIR *dir = opendir(sys_path);
+    if (!dir) {
+        log_errorf("failed to open %s: %s", sys_path, strerror(errno));
+        return false;
+    }
+    controller->path[0] = '\0';
+    for (struct dirent *entry; (entry = readdir(dir));) {
+        if (strncmp(entry->d_name, "event", 5) == 0) {
+            snprintf(controller->path, sizeof(controller->path),
+                     "/dev/input/%s", entry->d_name);
+            break;
+        }
+    }
+    closedir(dir);
+    if (!controller->path[0]) {
+        log_errorf("no event device for %s", sys_path);
+        return false;
+    }
+
+    // The permissions of the device may be set by udev after its creation.
+    for (int i = 0; i < VIRTUAL_CONTROLLER_WAIT; ++i) {
+        if (access(controller->path, R_OK | W_OK) == 0) return true;
+        usleep(1000);
+    }
+    log_errorf("failed to access %s: %s", controller->path, strerror(errno));
+    return false;
+}
+
+VirtualController *virtual_controller_create(void) {
+    VirtualController *controller = malloc(sizeof(*controller));
+    if (!controller) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return NULL;
+    }
+    controller->ff_thread_started = false;
+    controller->stop_fd = -1;
+
+    controller->fd = open("/dev/uinput", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (controller->fd < 0) {
+        log_errorf("failed to open /dev/uinput: %s", strerror(errno));
+        free(controller);
+        return NULL;
+    }
+
+    bool success = (
+        ioctl(controller->fd, UI_SET_EVBIT, EV_KEY) == 0 &&
+#define BUTTON(button_code) \
+        ioctl(controller->fd, UI_SET_KEYBIT, button_code) == 0 &&
+        VIRTUAL_CONTROLLER_BUTTONS
+#undef BUTTON
+        ioctl(controller->fd, UI_SET_EVBIT, EV_ABS) == 0 &&
+#define AXIS(axis_code, axis_min, axis_max) \
+        ioctl(controller->fd, UI_SET_ABSBIT, axis_code) == 0 &&
+        VIRTUAL_CONTROLLER_AXES
+#undef AXIS
+        ioctl(controller->fd, UI_SET_EVBIT, EV_FF) == 0 &&
+        ioctl(controller->fd, UI_SET_FFBIT, FF_RUMBLE) == 0
+    );
+
+#define AXIS(axis_code, axis_min, axis_max)                             \
+    if (success) {                                                      \
+        struct uinput_abs_setup abs_setup;                              \
+        memset(&abs_setup, 0, sizeof(abs_setup));                       \
+        abs_setup.code = axis_code;                                     \
+        abs_setup.absinfo.minimum = axis_min;                           \
+        abs_setup.absinfo.maximum = axis_max;                           \
+        success = ioctl(controller->fd, UI_ABS_SETUP, &abs_setup) == 0; \
+    }
+    VIRTUAL_CONTROLLER_AXES
+#undef AXIS
+
+    if (success) {
+        struct uinput_setup setup;
+        memset(&setup, 0, sizeof(setup));
+        setup.id.bustype = BUS_VIRTUAL;
+        strcpy(setup.name, VIRTUAL_CONTROLLER_NAME);
+        setup.ff_effects_max = 1;
+        success = (
+            ioctl(controller->fd, UI_DEV_SETUP, &setup) == 0 &&
+            ioctl(controller->fd, UI_DEV_CREATE) == 0
+        );
+    }
+    if (!success) {
+        log_errorf("failed to create virtual controller: %s",
+                   strerror(errno));
+        close(controller->fd);
+        free(controller);
+        return NULL;
+    }
+
+    controller->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (controller->stop_fd < 0) {
+        log_errorf("failed to create eventfd: %s", strerror(errno));
+        virtual_controller_destroy(controller);
+        return NULL;
+    }
+    const int err = pthread_create(&controller->ff_thread, NULL,
+                                   virtual_controller_ff_thread, controller);
+    if (err) {
+        log_errorf("failed to create force feedback thread: %s",
+                   strerror(err));
+        virtual_controller_destroy(controller);
+        return NULL;
+    }
+    controller->ff_thread_started = true;
+
+    if (!virtual_controller_find_path(controller)) {
+        virtual_controller_destroy(controller);
+        return NULL;
+    }
+
+    return controller;
+}
+
+void virtual_controller_destroy(VirtualController *controller) {
+    if (controller->ff_thread_started) {
+        const uint64_t value = 1;
+        if (write(controller->stop_fd, &value, sizeof(value)) < 0) {
+            log_errorf("failed to write eventfd: %s", strerror(errno));
+        }
+        pthread_join(controller->ff_thread, NULL);
+    }
+    if (controller->stop_fd >= 0) close(controller->stop_fd);
+    ioctl(controller->fd, UI_DEV_DESTROY);
+    close(controller->fd);
+    free(controller);
+}
+
+const char *virtual_controller_get_path(const VirtualController *controller) {
+    return controller->path;
+}
+
+bool virtual_controller_write(VirtualController *controller,
+                              const struct input_event *events,
+                              const size_t count) {
+    const ssize_t size = write(controller->fd, events,
+                               count * sizeof(*events));
+    if (size < 0) {
+        log_errorf("failed to write to uinput: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool virtual_controller_emit(VirtualController *controller,
+                             const unsigned int type, const unsigned int code,
+                             const int value) {
+    struct input_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    return virtual_controller_write(controller, &event, 1);
+}
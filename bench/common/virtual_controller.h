@@ -0,0 +1,70 @@
+#pragma once
+
+/**
+ * Virtual controller created with uinput for the benchmarks.
+ *
+ * The virtual controller has all the buttons, axes and force feedback effects
+ * required to be used as a controller by desktop-controller.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <linux/input.h>
+
+/**
+ * Represents a virtual controller.
+ */
+typedef struct _VirtualController VirtualController;
+
+/**
+ * Create a virtual controller. The controller need to be destroyed with
+ * virtual_controller_destroy().
+ *
+ * \returns a pointer to the virtual controller, or NULL on failure.
+ */
+VirtualController *virtual_controller_create(void);
+
+/**
+ * Destroy a virtual controller.
+ *
+ * \param controller A pointer to the virtual controller.
+ */
+void virtual_controller_destroy(VirtualController *controller);
+
+/**
+ * Get the path of the event device of a virtual controller.
+ *
+ * \param controller A pointer to the virtual controller.
+ *
+ * \returns the path of the device (example: /dev/input/event20).
+ */
+const char *virtual_controller_get_path(const VirtualController *controller);
+
+/**
+ * Send events from a virtual controller. The time of the events is set by the
+ * kernel.
+ *
+ * \param controller A pointer to the virtual controller.
+ * \param events The events to send.
+ * \param count The number of events.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool virtual_controller_write(VirtualController *controller,
+                              const struct input_event *events,
+                              const size_t count);
+
+/**
+ * Send a single event from a virtual controller.
+ *
+ * \param controller A pointer to the virtual controller.
+ * \param type The type of the event.
+ * \param code The code of the event.
+ * \param value The value of the event.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool virtual_controller_emit(VirtualController *controller,
+                             const unsigned int type, const unsigned int code,
+                             const int value);
@@ -0,0 +1,163 @@
+/**
+ * Benchmark comparing the discovery of the controllers from the capabilities
+ * exposed in sysfs with the scan opening every input device.
+ *
+ * usage: bench/discovery [ITERATIONS]
+ *
+ * Each line of the output is a list of key=value pairs.
+ */
+
+#define _GNU_SOURCE  // versionsort()
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libevdev/libevdev.h>
+
+#include "bench_utils.h"
+#include "controller.h"
+#include "log.h"
+#include "utils.h"
+
+#define DEFAULT_ITERATIONS 50
+
+/**
+ * Open a device and initialize libevdev on it, which is the cost paid for each
+ * device checked by a full libevdev initialization.
+ *
+ * \param device_path The path of the device.
+ * \param data A pointer to the number of devices opened.
+ *
+ * \returns true.
+ */
+static bool open_device(const char *device_path, void *data) {
+    size_t *opened = data;
+
+    const int fd = open(device_path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) return true;
+
+    struct libevdev *dev;
+    if (libevdev_new_from_fd(fd, &dev) == 0) {
+        ++*opened;
+        libevdev_free(dev);
+    }
+    close(fd);
+
+    return true;
+}
+
+/**
+ * Keep the event devices when scanning the input directory.
+ * See scandir().
+ */
+static int filter_event_device(const struct dirent *entry) {
+    return strncmp(entry->d_name, "event", 5) == 0;
+}
+
+/**
+ * Open every input device, like the discovery without sysfs did.
+ *
+ * \param opened A pointer to the number of devices opened.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool scan_all_devices(size_t *opened) {
+    struct dirent **entries;
+    const int entries_count = scandir("/dev/input", &entries,
+                                      filter_event_device, versionsort);
+    if (entries_count < 0) {
+        log_errorf("failed to scan /dev/input: %s", strerror(errno));
+        return false;
+    }
+
+    for (int i = 0; i < entries_count; ++i) {
+        char device_path[PATH_MAX];
+        snprintf(device_path, sizeof(device_path), "/dev/input/%s",
+                 entries[i]->d_name);
+        open_device(device_path, opened);
+        free(entries[i]);
+    }
+    free(entries);
+
+    return true;
+}
+
+/**
+ * Open the devices reported by controller_discover().
+ *
+ * \param opened A pointer to the number of devices opened.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool scan_sysfs_candidates(size_t *opened) {
+    return controller_discover(open_device, opened);
+}
+
+/**
+ * Run a discovery method several times and print its median duration.
+ *
+ * \param name The name of the method.
+ * \param scan The discovery method.
+ * \param iterations The number of runs.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool run(const char *name, bool (*scan)(size_t *),
+                const size_t iterations) {
+    uint64_t *durations = malloc(iterations * sizeof(*durations));
+    if (!durations) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return false;
+    }
+
+    size_t opened = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        opened = 0;
+        const uint64_t start = get_time_ns();
+        if (!scan(&opened)) {
+            free(durations);
+            return false;
+        }
+        durations[i] = get_time_ns() - start;
+    }
+
+    qsort(durations, iterations, sizeof(*durations), compare_u64);
+    printf("bench=discovery method=%s iterations=%zu opened=%zu "
+           "median_ns=%lu min_ns=%lu\n",
+           name, iterations, opened, durations[iterations / 2], durations[0]);
+    free(durations);
+
+    return true;
+}
+
+int main(const int argc, char *argv[]) {
+    if (!log_init("bench-discovery")) return EXIT_FAILURE;
+
+    size_t iterations = DEFAULT_ITERATIONS;
+    if (argc > 1) iterations = strtoul(argv[1], NULL, 10);
+    if (!iterations) {
+        log_errorf("invalid number of iterations: '%s'", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    // Warm up the dentry and sysfs caches so both methods start equal.
+    size_t opened = 0;
+    scan_all_devices(&opened);
+
+    const bool success = (
+        run("full_scan", scan_all_devices, iterations) &&
+        run("sysfs", scan_sysfs_candidates, iterations)
+    );
+
+    log_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
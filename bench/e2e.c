@@ -0,0 +1,591 @@
+/**
+ * End-to-end benchmark of desktop-controller: a virtual controller sends
+ * events to desktop-controller running against a headless X server, and an
+ * XInput2 listener receives the mouse events it generates.
+ *
+ * It measures:
+ * - The latency from a button press sent by the virtual controller to the raw
+ *   button event received from the X server.
+ * - While frames are sent at a given rate, the X events received per second
+ *   and the CPU usage of desktop-controller each second.
+ *
+ * usage: bench/e2e [RATE] [SECONDS]
+ *
+ * Xvfb is started on a free display if it is installed, otherwise the display
+ * of DISPLAY is used. desktop-controller must be built first. Each line of the
+ * output is a list of key=value pairs. The benchmark is skipped if /dev/uinput
+ * can't be used, if desktop-controller isn't built or if there is no X server
+ * with XInput2.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#include "bench_utils.h"
+#include "log.h"
+#include "utils.h"
+#include "virtual_controller.h"
+
+#define EXEC_PATH "./desktop-controller"
+#define DEFAULT_RATE 1000  // frames per second
+#define DEFAULT_SECONDS 5
+#define LATENCY_CLICKS 200
+#define DISPLAY_NAME_SIZE 32
+#define CONFIG_DIR_TEMPLATE "/tmp/bench-e2e-XXXXXX"
+#define CONFIG_NAME "config"
+
+/**
+ * The time given to desktop-controller to start and grab the controller.
+ */
+#define STARTUP_TIMEOUT (10 * NS_PER_S)
+#define EVENT_TIMEOUT NS_PER_S
+
+/**
+ * The button clicked by the virtual controller, which is mapped to the left
+ * mouse button by default.
+ */
+#define CLICK_BUTTON BTN_EAST
+
+/**
+ * The X server and the desktop-controller process being measured, with the
+ * XInput2 listener.
+ */
+typedef struct {
+    pid_t x_server;  // -1 if an existing X server is used.
+    pid_t desktop_controller;
+    Display *display;
+    int xi_opcode;
+} Session;
+
+/**
+ * The X events received by the listener, by type.
+ */
+typedef struct {
+    uint64_t motions;
+    uint64_t button_presses;
+    uint64_t button_releases;
+} EventCounts;
+
+/**
+ * Start a process.
+ *
+ * \param argv The arguments of the process, starting with the executable
+ *             searched in PATH.
+ * \param display The X display given to the process, or NULL to keep DISPLAY.
+ * \param quiet Whether to discard the standard and error outputs.
+ * \param keep_fd A file descriptor to keep open in the process, or -1.
+ *
+ * \returns the pid of the process, or -1 on failure.
+ */
+static pid_t spawn(char *const argv[], const char *display, const bool quiet,
+                   const int keep_fd) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+        log_errorf("failed to fork: %s", strerror(errno));
+        return -1;
+    }
+    if (pid > 0) return pid;
+
+    if (display) setenv("DISPLAY", display, true);
+    if (quiet) {
+        const int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            if (null_fd != keep_fd) close(null_fd);
+        }
+    }
+    execvp(argv[0], argv);
+    _exit(127);
+}
+
+/**
+ * Stop a process started with spawn() and wait for it.
+ *
+ * \param pid The pid of the process.
+ */
+static void stop(const pid_t pid) {
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+}
+
+/**
+ * Start Xvfb on a free display.
+ *
+ * \param display A buffer where the name of the display will be stored.
+ * \param size The size of the buffer.
+ *
+ * \returns the pid of Xvfb, or -1 if it couldn't be started.
+ */
+static pid_t start_xvfb(char *display, const size_t size) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        log_errorf("failed to create a pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    // Xvfb writes the number of the display it chose once it is ready.
+    char fd_string[16];
+    snprintf(fd_string, sizeof(fd_string), "%d", fds[1]);
+    char *argv[] = {"Xvfb", "-displayfd", fd_string, "-nolisten", "tcp", NULL};
+    const pid_t pid = spawn(argv, NULL, true, fds[1]);
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return -1;
+    }
+
+    char number[16] = {0};
+    ssize_t length;
+    do {
+        length = read(fds[0], number, sizeof(number) - 1);
+    } while (length < 0 && errno == EINTR);
+    close(fds[0]);
+    // The pipe is closed without a number if Xvfb isn't installed.
+    if (length <= 0) {
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+
+    number[strcspn(number, "\n")] = '\0';
+    snprintf(display, size, ":%s", number);
+    return pid;
+}
+
+/**
+ * Open the X display and listen to the raw mouse events of the master devices.
+ *
+ * \param session The session whose display is opened.
+ * \param display_name The name of the display.
+ *
+ * \returns true on success, or false if XInput2 isn't available.
+ */
+static bool listen_x_events(Session *session, const char *display_name) {
+    session->display = XOpenDisplay(display_name);
+    if (!session->display) {
+        log_debugf("failed to open the display %s", display_name);
+        return false;
+    }
+
+    int event, error;
+    int major = 2, minor = 2;
+    if (!XQueryExtension(session->display, "XInputExtension",
+                         &session->xi_opcode, &event, &error) ||
+        XIQueryVersion(session->display, &major, &minor) != Success) {
+        log_debugf("XInput2 isn't supported by the display %s", display_name);
+        return false;
+    }
+
+    unsigned char mask_bits[XIMaskLen(XI_LASTEVENT)] = {0};
+    XISetMask(mask_bits, XI_RawMotion);
+    XISetMask(mask_bits, XI_RawButtonPress);
+    XISetMask(mask_bits, XI_RawButtonRelease);
+    XIEventMask mask = {
+        .deviceid = XIAllMasterDevices,
+        .mask_len = sizeof(mask_bits),
+        .mask = mask_bits,
+    };
+    XISelectEvents(session->display, DefaultRootWindow(session->display),
+                   &mask, 1);
+    XSync(session->display, False);
+
+    return true;
+}
+
+/**
+ * Receive the X events until an event of a type is received or a deadline is
+ * reached.
+ *
+ * \param session The session receiving the events.
+ * \param type The XInput2 type of the event to wait for, or 0 to receive all
+ *             the events until the deadline.
+ * \param deadline The time on the monotonic clock in nanoseconds when to stop
+ *                 waiting.
+ * \param counts The counts of the events received, which are incremented.
+ *
+ * \returns true if an event of the type was received, or false otherwise.
+ */
+static bool receive_x_events(Session *session, const int type,
+                             const uint64_t deadline, EventCounts *counts) {
+    for (;;) {
+        while (XPending(session->display)) {
+            XEvent event;
+            XNextEvent(session->display, &event);
+            XGenericEventCookie *cookie = &event.xcookie;
+            if (cookie->type != GenericEvent ||
+                cookie->extension != session->xi_opcode) {
+                continue;
+            }
+
+            const int evtype = cookie->evtype;
+            if (evtype == XI_RawMotion) {
+                ++counts->motions;
+            } else if (evtype == XI_RawButtonPress) {
+                ++counts->button_presses;
+            } else if (evtype == XI_RawButtonRelease) {
+                ++counts->button_releases;
+            }
+            if (type && evtype == type) return true;
+        }
+
+        const uint64_t now = get_time_ns();
+        if (now >= deadline) return false;
+        struct pollfd fd = {
+            .fd = ConnectionNumber(session->display),
+            .events = POLLIN,
+        };
+        const int timeout = (deadline - now + NS_PER_MS - 1) / NS_PER_MS;
+        if (poll(&fd, 1, timeout) < 0 && errno != EINTR) {
+            log_errorf("failed to poll the X display: %s", strerror(errno));
+            return false;
+        }
+    }
+}
+
+/**
+ * Press or release the click button of the virtual controller.
+ *
+ * \param controller The virtual controller.
+ * \param pressed Whether the button is pressed.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool click(VirtualController *controller, const bool pressed) {
+    const struct input_event events[] = {
+        {.type = EV_KEY, .code = CLICK_BUTTON, .value = pressed},
+        {.type = EV_SYN, .code = SYN_REPORT},
+    };
+    return virtual_controller_write(controller, events,
+                                    sizeof(events) / sizeof(*events));
+}
+
+/**
+ * Wait for desktop-controller to handle the virtual controller, by clicking
+ * until the click is received from the X server.
+ *
+ * \param session The session.
+ * \param controller The virtual controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool wait_ready(Session *session, VirtualController *controller) {
+    const uint64_t deadline = get_time_ns() + STARTUP_TIMEOUT;
+    EventCounts counts = {0};
+    while (get_time_ns() < deadline) {
+        if (!click(controller, true) || !click(controller, false)) return false;
+        if (receive_x_events(session, XI_RawButtonRelease,
+                             get_time_ns() + 100 * NS_PER_MS, &counts)) {
+            // Drop the events of the clicks sent before.
+            receive_x_events(session, 0, get_time_ns() + 100 * NS_PER_MS,
+                             &counts);
+            return true;
+        }
+    }
+
+    log_errorf("desktop-controller didn't handle the virtual controller");
+    return false;
+}
+
+/**
+ * Measure the latency of clicks, from the write of the press to the virtual
+ * controller to the reception of the press from the X server.
+ *
+ * \param session The session.
+ * \param controller The virtual controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool measure_latency(Session *session, VirtualController *controller) {
+    uint64_t latencies[LATENCY_CLICKS];
+    EventCounts counts = {0};
+    for (size_t i = 0; i < LATENCY_CLICKS; ++i) {
+        const uint64_t start = get_time_ns();
+        if (!click(controller, true)) return false;
+        if (!receive_x_events(session, XI_RawButtonPress,
+                              start + EVENT_TIMEOUT, &counts)) {
+            log_errorf("lost the press of the click %zu", i);
+            return false;
+        }
+        latencies[i] = get_time_ns() - start;
+
+        if (!click(controller, false) ||
+            !receive_x_events(session, XI_RawButtonRelease,
+                              get_time_ns() + EVENT_TIMEOUT, &counts)) {
+            log_errorf("lost the release of the click %zu", i);
+            return false;
+        }
+    }
+
+    qsort(latencies, LATENCY_CLICKS, sizeof(*latencies), compare_u64);
+    printf("bench=e2e phase=latency clicks=%d min_us=%.1f p50_us=%.1f "
+           "p90_us=%.1f p99_us=%.1f max_us=%.1f\n", LATENCY_CLICKS,
+           (double)latencies[0] / NS_PER_US,
+           (double)latencies[LATENCY_CLICKS / 2] / NS_PER_US,
+           (double)latencies[LATENCY_CLICKS * 9 / 10] / NS_PER_US,
+           (double)latencies[LATENCY_CLICKS * 99 / 100] / NS_PER_US,
+           (double)latencies[LATENCY_CLICKS - 1] / NS_PER_US);
+
+    return true;
+}
+
+/**
+ * Get the CPU time used by a process.
+ *
+ * \param pid The pid of the process.
+ *
+ * \returns the user and system time of the process in clock ticks, or 0 on
+ *          failure.
+ */
+static uint64_t get_cpu_ticks(const pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+
+    char stat[1024];
+    const size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[length] = '\0';
+
+    // The name of the process may contain spaces, so the fields are counted
+    // from its closing parenthesis: utime and stime are the 12th and 13th.
+    const char *fields = strrchr(stat, ')');
+    unsigned long long utime, stime;
+    if (!fields || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u "
+                          "%*u %*u %llu %llu", &utime, &stime) != 2) {
+        return 0;
+    }
+
+    return utime + stime;
+}
+
+/**
+ * Send frames at a fixed rate and count the X events received, printing the
+ * X events and the CPU usage of desktop-controller for each second.
+ *
+ * Each frame toggles the click button, and tilts the left stick to the right
+ * or to the left so the pointer keeps moving, alternating every half second.
+ *
+ * \param session The session.
+ * \param controller The virtual controller.
+ * \param rate The number of frames per second.
+ * \param seconds The duration of the measure in seconds.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool measure_throughput(Session *session, VirtualController *controller,
+                               const uint64_t rate, const uint64_t seconds) {
+    const double ticks_per_second = sysconf(_SC_CLK_TCK);
+    const uint64_t period = NS_PER_S / rate;
+    const uint64_t half_second = rate / 2 ? rate / 2 : 1;
+
+    EventCounts total = {0};
+    uint64_t input_events = 0;
+    const uint64_t start = get_time_ns();
+    const uint64_t start_ticks = get_cpu_ticks(session->desktop_controller);
+    for (uint64_t second = 0; second < seconds; ++second) {
+        EventCounts counts = {0};
+        const uint64_t second_start = get_time_ns();
+        const uint64_t second_ticks = get_cpu_ticks(
+            session->desktop_controller
+        );
+
+        for (uint64_t i = 0; i < rate; ++i) {
+            const uint64_t frame = second * rate + i;
+            const struct input_event events[] = {
+                {.type = EV_KEY, .code = CLICK_BUTTON, .value = !(frame % 2)},
+                {
+                    .type = EV_ABS,
+                    .code = ABS_X,
+                    .value = (frame / half_second) % 2 ? -32768 : 32767,
+                },
+                {.type = EV_SYN, .code = SYN_REPORT},
+            };
+            if (!virtual_controller_write(controller, events,
+                                          sizeof(events) / sizeof(*events))) {
+                return false;
+            }
+            input_events += sizeof(events) / sizeof(*events);
+
+            receive_x_events(session, 0, start + (frame + 1) * period,
+                             &counts);
+        }
+
+        const uint64_t duration = get_time_ns() - second_start;
+        const uint64_t ticks = (
+            get_cpu_ticks(session->desktop_controller) - second_ticks
+        );
+        const uint64_t x_events = (
+            counts.motions + counts.button_presses + counts.button_releases
+        );
+        printf("bench=e2e phase=second second=%lu x_events=%lu "
+               "cpu_percent=%.1f\n", second + 1, x_events,
+               ticks / ticks_per_second * NS_PER_S / duration * 100.0);
+        total.motions += counts.motions;
+        total.button_presses += counts.button_presses;
+        total.button_releases += counts.button_releases;
+    }
+
+    // Receive the events of the last frames.
+    receive_x_events(session, 0, get_time_ns() + 100 * NS_PER_MS, &total);
+    const uint64_t duration = get_time_ns() - start;
+    const uint64_t ticks = (
+        get_cpu_ticks(session->desktop_controller) - start_ticks
+    );
+    const uint64_t frames = rate * seconds;
+    const uint64_t buttons = total.button_presses + total.button_releases;
+    const uint64_t x_events = total.motions + buttons;
+    printf("bench=e2e phase=throughput input_rate=%lu seconds=%lu "
+           "input_events=%lu x_events=%lu x_motions=%lu x_buttons=%lu "
+           "lost_buttons=%lu x_events_per_s=%.1f cpu_percent=%.1f\n",
+           rate, seconds, input_events, x_events, total.motions, buttons,
+           frames > buttons ? frames - buttons : 0,
+           (double)x_events * NS_PER_S / duration,
+           ticks / ticks_per_second * NS_PER_S / duration * 100.0);
+
+    return true;
+}
+
+/**
+ * Create an empty config in a new temporary directory, which keeps the default
+ * mapping whatever the user config. Unlike /dev/null, nothing else in the
+ * directory watched for the changes of the config is modified.
+ *
+ * \param path The buffer where the path of the config will be stored, of
+ *             sizeof(CONFIG_DIR_TEMPLATE "/" CONFIG_NAME) bytes.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool create_config(char *path) {
+    strcpy(path, CONFIG_DIR_TEMPLATE);
+    if (!mkdtemp(path)) {
+        log_errorf("failed to create a temporary directory: %s",
+                   strerror(errno));
+        return false;
+    }
+    strcat(path, "/" CONFIG_NAME);
+
+    const int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        log_errorf("failed to create %s: %s", path, strerror(errno));
+        rmdir(dirname(path));
+        return false;
+    }
+    close(fd);
+
+    return true;
+}
+
+/**
+ * Remove the config created by create_config() and its directory.
+ *
+ * \param path The path of the config, modified to the path of the directory.
+ */
+static void remove_config(char *path) {
+    if (unlink(path) < 0 || rmdir(dirname(path)) < 0) {
+        log_errorf("failed to remove %s: %s", path, strerror(errno));
+    }
+}
+
+/**
+ * Start the X server and desktop-controller, then run the measures.
+ *
+ * \param controller The virtual controller.
+ * \param rate The number of frames per second of the throughput measure.
+ * \param seconds The duration of the throughput measure in seconds.
+ *
+ * \returns true on success or if the benchmark is skipped, or false on
+ *          failure.
+ */
+static bool run(VirtualController *controller, const uint64_t rate,
+                const uint64_t seconds) {
+    Session session = {.x_server = -1, .desktop_controller = -1};
+
+    char display[DISPLAY_NAME_SIZE];
+    session.x_server = start_xvfb(display, sizeof(display));
+    if (session.x_server < 0) {
+        const char *default_display = getenv("DISPLAY");
+        snprintf(display, sizeof(display), "%s",
+                 default_display ? default_display : "");
+    }
+    if (!display[0] || !listen_x_events(&session, display)) {
+        printf("bench=e2e skipped=1\n");
+        if (session.display) XCloseDisplay(session.display);
+        if (session.x_server >= 0) stop(session.x_server);
+        return true;
+    }
+    printf("bench=e2e display=%s xvfb=%d\n", display, session.x_server >= 0);
+
+    char config_path[sizeof(CONFIG_DIR_TEMPLATE "/" CONFIG_NAME)];
+    const bool has_config = create_config(config_path);
+    char *argv[] = {
+        EXEC_PATH, "--config", config_path,
+        (char *)virtual_controller_get_path(controller), NULL,
+    };
+    if (has_config) {
+        session.desktop_controller = spawn(argv, display, false, -1);
+    }
+
+    bool success = (
+        session.desktop_controller >= 0 &&
+        wait_ready(&session, controller) &&
+        measure_latency(&session, controller) &&
+        measure_throughput(&session, controller, rate, seconds)
+    );
+    fflush(stdout);
+
+    if (session.desktop_controller >= 0) stop(session.desktop_controller);
+    if (has_config) remove_config(config_path);
+    XCloseDisplay(session.display);
+    if (session.x_server >= 0) stop(session.x_server);
+
+    return success;
+}
+
+int main(const int argc, char *argv[]) {
+    if (!log_init("bench-e2e")) return EXIT_FAILURE;
+
+    uint64_t rate = DEFAULT_RATE;
+    if (argc > 1) rate = strtoull(argv[1], NULL, 10);
+    if (!rate || rate > NS_PER_S) {
+        log_errorf("invalid rate: '%s'", argv[1]);
+        return EXIT_FAILURE;
+    }
+    uint64_t seconds = DEFAULT_SECONDS;
+    if (argc > 2) seconds = strtoull(argv[2], NULL, 10);
+    if (!seconds) {
+        log_errorf("invalid duration: '%s'", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (access("/dev/uinput", R_OK | W_OK) < 0 ||
+        access(EXEC_PATH, X_OK) < 0) {
+        printf("bench=e2e skipped=1\n");
+        log_quit();
+        return EXIT_SUCCESS;
+    }
+
+    VirtualController *controller = virtual_controller_create();
+    if (!controller) return EXIT_FAILURE;
+
+    const bool success = run(controller, rate, seconds);
+
+    virtual_controller_destroy(controller);
+    log_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
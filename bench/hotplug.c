@@ -0,0 +1,218 @@
+/**
+ * Check of the connection of the controllers through the device watcher.
+ *
+ * Like desktop-controller started without any controller, nothing is attached
+ * until the watcher reports a device. A virtual controller is then plugged and
+ * unplugged several times: after each plug, the controller must be attached by
+ * the watcher and report a button press, and after each unplug, reading it
+ * must fail so it is detached and attached again on the next plug, even when
+ * the kernel reuses the path of the device.
+ *
+ * usage: bench/hotplug [ROUNDS]
+ *
+ * Each line of the output is a list of key=value pairs. The check is skipped if
+ * /dev/uinput can't be used.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "controller.h"
+#include "device_watcher.h"
+#include "event_loop.h"
+#include "log.h"
+#include "utils.h"
+#include "virtual_controller.h"
+
+#define DEFAULT_ROUNDS 20
+#define HOTPLUG_TIMEOUT 2000  // ms
+
+/**
+ * State of the check, shared with the callback of the device watcher.
+ */
+typedef struct {
+    VirtualController *virtual_controller;  // NULL while unplugged.
+    Controller *controller;  // NULL while detached.
+    uint64_t plug_time;
+    uint64_t attach_duration;  // Total time from the plugs to the attaches.
+    uint64_t attached;
+    uint64_t pressed;
+    uint64_t detached;
+} Hotplug;
+
+static Hotplug hotplug = {0};
+
+/**
+ * Unplug the virtual controller once the controller reported the press sent
+ * when it was attached. See ControllerButtonEventCallBack.
+ *
+ * \param button The button pressed.
+ * \param data Unused.
+ */
+static void handle_button_down(const ControllerButton button, void *data) {
+    (void)data;
+
+    if (button != CONTROLLER_BUTTON_A || !hotplug.virtual_controller) return;
+    ++hotplug.pressed;
+    virtual_controller_destroy(hotplug.virtual_controller);
+    hotplug.virtual_controller = NULL;
+}
+
+static void handle_button_up(const ControllerButton button, void *data) {
+    (void)button;
+    (void)data;
+}
+
+/**
+ * Handle the pending events of the attached controller, and detach it when
+ * reading it fails because it was unplugged. See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_controller_events(void *data) {
+    (void)data;
+
+    if (controller_update(hotplug.controller, handle_button_down,
+                          handle_button_up, NULL)) {
+        return true;
+    }
+    if (hotplug.virtual_controller) return false;
+
+    event_loop_remove_fd(controller_get_fd(hotplug.controller));
+    controller_destroy(hotplug.controller);
+    hotplug.controller = NULL;
+    ++hotplug.detached;
+    event_loop_stop();
+
+    return true;
+}
+
+/**
+ * Attach the virtual controller when the watcher reports it, and press a
+ * button. See DeviceWatcherCallBack.
+ *
+ * \param device_path The path of the device.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_device(const char *device_path) {
+    if (hotplug.controller || !hotplug.virtual_controller) return true;
+    const char *path = virtual_controller_get_path(hotplug.virtual_controller);
+    if (!streq(device_path, path)) return true;
+
+    Controller *controller = controller_probe(device_path);
+    if (!controller) return true;
+    hotplug.attach_duration += get_time_ns() - hotplug.plug_time;
+    ++hotplug.attached;
+
+    hotplug.controller = controller;
+    if (!event_loop_add_fd(controller_get_fd(controller),
+                           handle_controller_events, NULL)) {
+        return false;
+    }
+
+    return (
+        virtual_controller_emit(hotplug.virtual_controller, EV_KEY, BTN_EAST,
+                                1) &&
+        virtual_controller_emit(hotplug.virtual_controller, EV_SYN,
+                                SYN_REPORT, 0)
+    );
+}
+
+/**
+ * Fail the round when the virtual controller isn't attached and detached in
+ * time. See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns false.
+ */
+static bool handle_timeout(void *data) {
+    (void)data;
+
+    log_errorf("timed out: attached=%lu pressed=%lu detached=%lu",
+               hotplug.attached, hotplug.pressed, hotplug.detached);
+    return false;
+}
+
+/**
+ * Plug and unplug the virtual controller, waiting each time for the
+ * controller to be attached, to report the press and to be detached.
+ *
+ * \param rounds The number of plugs.
+ *
+ * \returns true if every plug was attached and detached, or false on failure.
+ */
+static bool run(const uint64_t rounds) {
+    if (!device_watcher_init(handle_device)) return false;
+    const int timeout = event_loop_add_timer(handle_timeout, NULL);
+    if (timeout < 0) {
+        device_watcher_quit();
+        return false;
+    }
+
+    bool success = true;
+    for (uint64_t round = 0; success && round < rounds; ++round) {
+        hotplug.virtual_controller = virtual_controller_create();
+        if (!hotplug.virtual_controller) {
+            success = false;
+            break;
+        }
+        hotplug.plug_time = get_time_ns();
+
+        success = (
+            event_loop_set_timer(timeout, HOTPLUG_TIMEOUT * NS_PER_MS, 0) &&
+            event_loop_run()
+        );
+    }
+
+    if (hotplug.controller) {
+        event_loop_remove_fd(controller_get_fd(hotplug.controller));
+        controller_destroy(hotplug.controller);
+    }
+    if (hotplug.virtual_controller) {
+        virtual_controller_destroy(hotplug.virtual_controller);
+    }
+    event_loop_remove_timer(timeout);
+    device_watcher_quit();
+
+    if (success) {
+        printf("bench=hotplug rounds=%lu attached=%lu detached=%lu "
+               "attach_us=%.1f\n", rounds, hotplug.attached,
+               hotplug.detached,
+               (double)hotplug.attach_duration / hotplug.attached / NS_PER_US);
+        success = hotplug.attached == rounds && hotplug.detached == rounds;
+        if (!success) log_errorf("controller not reconnected");
+    }
+
+    return success;
+}
+
+int main(const int argc, char *argv[]) {
+    if (!log_init("bench-hotplug")) return EXIT_FAILURE;
+
+    uint64_t rounds = DEFAULT_ROUNDS;
+    if (argc > 1) rounds = strtoull(argv[1], NULL, 10);
+    if (!rounds) {
+        log_errorf("invalid number of rounds: '%s'", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (access("/dev/uinput", R_OK | W_OK) < 0) {
+        printf("bench=hotplug skipped=1\n");
+        log_quit();
+        return EXIT_SUCCESS;
+    }
+
+    if (!event_loop_init()) return EXIT_FAILURE;
+    const bool success = run(rounds);
+    event_loop_quit();
+    log_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
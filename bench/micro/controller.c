@@ -0,0 +1,347 @@
+/**
+ * Microbenchmarks of the processing of the controller events and of the stick
+ * values, on a controller without device fed with synthetic events.
+ *
+ * Each case processes the same array of random events several times, so the
+ * events stay in the cache like the events of a single read.
+ *
+ * usage: bench/micro/controller [ROUNDS]
+ *
+ * Each line of the output is a list of key=value pairs. The cycles are
+ * reported only if the hardware counters can be read.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/input.h>
+
+#include "controller.h"
+#include "curve.h"
+#include "cycle_counter.h"
+#include "log.h"
+#include "utils.h"
+
+#define DEFAULT_ROUNDS 2048
+#define EVENTS_COUNT 4096
+
+// Buttons sent by the "buttons" case
+#define MICRO_BUTTONS \
+    BUTTON(BTN_SOUTH) \
+    BUTTON(BTN_EAST)  \
+    BUTTON(BTN_NORTH) \
+    BUTTON(BTN_WEST)  \
+    BUTTON(BTN_TL)    \
+    BUTTON(BTN_TR)    \
+    BUTTON(BTN_SELECT)
+
+// Axes of the controller with their minimum and maximum values
+#define MICRO_AXES              \
+    AXIS(ABS_X, -32768, 32767)  \
+    AXIS(ABS_Y, -32768, 32767)  \
+    AXIS(ABS_RX, -32768, 32767) \
+    AXIS(ABS_RY, -32768, 32767) \
+    AXIS(ABS_HAT0X, -1, 1)      \
+    AXIS(ABS_HAT0Y, -1, 1)
+
+/**
+ * The duration and the cycles of a case.
+ */
+typedef struct {
+    uint64_t start_ns;
+    uint64_t start_cycles;
+    uint64_t ns;
+    uint64_t cycles;
+} Measure;
+
+/**
+ * Prevents the compiler from removing the computations whose results are
+ * otherwise unused.
+ */
+static volatile float sink;
+
+static uint64_t random_state = 0x2545f4914f6cdd1d;
+
+/**
+ * Get a pseudo-random number with xorshift64, the same on every run.
+ *
+ * \param range The number of values.
+ *
+ * \returns a number between 0 and range - 1.
+ */
+static uint32_t random_below(const uint32_t range) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (uint32_t)((random_state >> 32) % range);
+}
+
+/**
+ * Count the button changes. See ControllerButtonEventCallBack.
+ *
+ * \param button Unused.
+ * \param data A pointer to the number of button changes.
+ */
+static void count_button(const ControllerButton button, void *data) {
+    (void)button;
+
+    ++*(uint64_t *)data;
+}
+
+/**
+ * Start measuring a case.
+ *
+ * \param measure The measure to start.
+ */
+static void measure_start(Measure *measure) {
+    measure->start_cycles = cycle_counter_read();
+    measure->start_ns = get_time_ns();
+}
+
+/**
+ * Stop measuring a case.
+ *
+ * \param measure The measure to stop.
+ */
+static void measure_stop(Measure *measure) {
+    measure->ns = get_time_ns() - measure->start_ns;
+    measure->cycles = cycle_counter_read() - measure->start_cycles;
+}
+
+/**
+ * Print the result of a case.
+ *
+ * \param name The name of the case.
+ * \param unit The name of what is counted, such as "event".
+ * \param count The number of units processed.
+ * \param ns The duration in nanoseconds.
+ * \param cycles The number of cycles, or 0 if they aren't counted.
+ */
+static void print_result(const char *name, const char *unit,
+                         const uint64_t count, const uint64_t ns,
+                         const uint64_t cycles) {
+    printf("bench=micro case=%s %ss=%lu ns_per_%s=%.2f", name, unit, count,
+           unit, (double)ns / count);
+    if (cycles) printf(" cycles_per_%s=%.2f", unit, (double)cycles / count);
+    printf("\n");
+}
+
+/**
+ * Fill an array of events with frames of random values of some axes or
+ * buttons.
+ *
+ * \param events The array of EVENTS_COUNT events to fill.
+ * \param type The type of the events.
+ * \param codes The codes of the events of a frame.
+ * \param codes_count The number of codes, each frame ends with SYN_REPORT.
+ * \param min The minimum value.
+ * \param max The maximum value.
+ */
+static void fill_frames(struct input_event *events, const uint16_t type,
+                        const uint16_t *codes, const size_t codes_count,
+                        const int32_t min, const int32_t max) {
+    memset(events, 0, EVENTS_COUNT * sizeof(*events));
+    for (size_t i = 0; i < EVENTS_COUNT; ++i) {
+        const size_t position = i % (codes_count + 1);
+        if (position == codes_count) {
+            events[i].type = EV_SYN;
+            events[i].code = SYN_REPORT;
+            continue;
+        }
+        events[i].type = type;
+        events[i].code = codes[position];
+        events[i].value = min + (int32_t)random_below(max - min + 1);
+    }
+}
+
+/**
+ * Process the events with controller_process_event(), and optionally get the
+ * values of both sticks after each frame like the pointer update.
+ *
+ * \param controller The controller processing the events.
+ * \param events The EVENTS_COUNT events.
+ * \param rounds The number of times the events are processed.
+ * \param get_sticks Whether to get the sticks after each frame.
+ * \param measure The measure of the processing.
+ *
+ * \returns the number of frames.
+ */
+static uint64_t process_events(Controller *controller,
+                               const struct input_event *events,
+                               const uint64_t rounds, const bool get_sticks,
+                               Measure *measure) {
+    uint64_t buttons = 0, frames = 0;
+    measure_start(measure);
+    for (uint64_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < EVENTS_COUNT; ++i) {
+            controller_process_event(controller, &events[i], count_button,
+                                     count_button, &buttons);
+            if (events[i].type != EV_SYN) continue;
+
+            ++frames;
+            if (get_sticks) {
+                float lx, ly, rx, ry;
+                controller_get_stick(controller, CONTROLLER_STICK_LEFT, &lx,
+                                     &ly);
+                controller_get_stick(controller, CONTROLLER_STICK_RIGHT, &rx,
+                                     &ry);
+                sink = lx + ly + rx + ry;
+            }
+        }
+    }
+    measure_stop(measure);
+    sink = buttons;
+
+    return frames;
+}
+
+/**
+ * Measure the processing of events of some axes or buttons.
+ *
+ * \param name The name of the case.
+ * \param controller The controller processing the events.
+ * \param events The EVENTS_COUNT events.
+ * \param rounds The number of times the events are processed.
+ */
+static void run_events(const char *name, Controller *controller,
+                       const struct input_event *events,
+                       const uint64_t rounds) {
+    Measure measure;
+    process_events(controller, events, 1, false, &measure);  // Warm up.
+    process_events(controller, events, rounds, false, &measure);
+    print_result(name, "event", rounds * EVENTS_COUNT, measure.ns,
+                 measure.cycles);
+}
+
+/**
+ * Measure controller_get_stick() on the values of stick events, as the
+ * difference with processing the same events without getting the sticks.
+ *
+ * \param controller The controller processing the events.
+ * \param events The EVENTS_COUNT events of the sticks.
+ * \param rounds The number of times the events are processed.
+ */
+static void run_get_stick(Controller *controller,
+                          const struct input_event *events,
+                          const uint64_t rounds) {
+    Measure without, with;
+    process_events(controller, events, 1, true, &with);  // Warm up.
+    process_events(controller, events, rounds, false, &without);
+    const uint64_t frames = process_events(controller, events, rounds, true,
+                                           &with);
+
+    const uint64_t calls = frames * 2;
+    const uint64_t ns = with.ns > without.ns ? with.ns - without.ns : 0;
+    const uint64_t cycles = (
+        with.cycles > without.cycles ? with.cycles - without.cycles : 0
+    );
+    print_result("get_stick", "call", calls, ns, cycles);
+}
+
+/**
+ * Measure the evaluation of a curve for random stick values, which gives the
+ * scroll speed since get_scroll_speed() is baked into the scroll curve.
+ * Evaluating a curve costs the same whatever its shape.
+ *
+ * \param rounds The number of times the values are evaluated.
+ */
+static void run_scroll_speed(const uint64_t rounds) {
+    static const float points[] = {0.0f, 0.1f, 0.3f, 1.0f};
+    const CurveConfig config = {
+        .type = CURVE_SPLINE,
+        .gain = 30.0f,
+        .deadzone = 0.1f,
+        .saturation = 0.01f,
+        .points = points,
+        .points_count = sizeof(points) / sizeof(*points),
+    };
+    Curve curve;
+    curve_init(&curve, &config);
+
+    int16_t values[EVENTS_COUNT];
+    for (size_t i = 0; i < EVENTS_COUNT; ++i) {
+        values[i] = (int16_t)(random_below(UINT16_MAX + 1) + INT16_MIN);
+    }
+
+    Measure measure;
+    float sum = 0.0f;
+    measure_start(&measure);
+    for (uint64_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < EVENTS_COUNT; ++i) {
+            sum += curve_eval(&curve, values[i]);
+        }
+    }
+    measure_stop(&measure);
+    sink = sum;
+
+    print_result("scroll_speed", "call", rounds * EVENTS_COUNT, measure.ns,
+                 measure.cycles);
+}
+
+/**
+ * Create a controller without device with the axes of a gamepad.
+ *
+ * \returns a pointer to the controller, or NULL on failure.
+ */
+static Controller *create_controller(void) {
+    ControllerInfo info;
+    memset(&info, 0, sizeof(info));
+    snprintf(info.name, sizeof(info.name), "microbenchmark controller");
+    info.id.bustype = BUS_VIRTUAL;
+#define AXIS(code, axis_min, axis_max)       \
+    info.axes |= UINT64_C(1) << (code);      \
+    info.absinfo[code].minimum = (axis_min); \
+    info.absinfo[code].maximum = (axis_max);
+    MICRO_AXES
+#undef AXIS
+
+    return controller_from_info(&info, "microbenchmark");
+}
+
+int main(const int argc, char *argv[]) {
+    if (!log_init("bench-micro-controller")) return EXIT_FAILURE;
+
+    uint64_t rounds = DEFAULT_ROUNDS;
+    if (argc > 1) rounds = strtoull(argv[1], NULL, 10);
+    if (!rounds) {
+        log_errorf("invalid number of rounds: '%s'", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    Controller *controller = create_controller();
+    if (!controller) return EXIT_FAILURE;
+    cycle_counter_init();
+
+    static struct input_event events[EVENTS_COUNT];
+    static const uint16_t buttons[] = {
+#define BUTTON(code) code,
+        MICRO_BUTTONS
+#undef BUTTON
+    };
+    fill_frames(events, EV_KEY, buttons, sizeof(buttons) / sizeof(*buttons),
+                0, 1);
+    run_events("buttons", controller, events, rounds);
+
+    // The hats go through controller_handle_hat_event().
+    static const uint16_t hats[] = {ABS_HAT0X, ABS_HAT0Y};
+    fill_frames(events, EV_ABS, hats, sizeof(hats) / sizeof(*hats), -1, 1);
+    run_events("hat", controller, events, rounds);
+
+    static const uint16_t sticks[] = {ABS_X, ABS_Y, ABS_RX, ABS_RY};
+    fill_frames(events, EV_ABS, sticks, sizeof(sticks) / sizeof(*sticks),
+                -32768, 32767);
+    run_events("sticks", controller, events, rounds);
+    run_get_stick(controller, events, rounds);
+
+    run_scroll_speed(rounds);
+
+    cycle_counter_quit();
+    controller_destroy(controller);
+    log_quit();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/**
+ * Stress test of the synchronization of the controller after the kernel
+ * dropped events.
+ *
+ * A virtual controller sends bursts of button changes much larger than the
+ * buffer of the kernel, so most of them are dropped. After each burst, the
+ * buttons reported pressed by the callbacks must match the last state sent,
+ * and no button may be pressed or released twice in a row.
+ *
+ * usage: bench/overflow [ROUNDS]
+ *
+ * Each line of the output is a list of key=value pairs. The test is skipped if
+ * /dev/uinput can't be used.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "controller.h"
+#include "event_loop.h"
+#include "log.h"
+#include "utils.h"
+#include "virtual_controller.h"
+
+#define DEFAULT_ROUNDS 200
+
+/**
+ * Number of frames of a burst, far more than the buffer of the kernel.
+ */
+#define FRAMES_PER_BURST 512
+
+// Buttons sent by the virtual controller with their code
+#define OVERFLOW_BUTTONS                   \
+    BUTTON(CONTROLLER_BUTTON_A, BTN_EAST)  \
+    BUTTON(CONTROLLER_BUTTON_B, BTN_SOUTH) \
+    BUTTON(CONTROLLER_BUTTON_Y, BTN_NORTH) \
+    BUTTON(CONTROLLER_BUTTON_X, BTN_WEST)  \
+    BUTTON(CONTROLLER_BUTTON_L, BTN_TL)    \
+    BUTTON(CONTROLLER_BUTTON_R, BTN_TR)
+
+/**
+ * State of the buttons sent by the virtual controller.
+ */
+typedef struct {
+    bool buttons[CONTROLLER_BUTTON_COUNT];
+} ButtonsState;
+
+/**
+ * Buttons reported by the callbacks of the controller.
+ */
+typedef struct {
+    bool pressed[CONTROLLER_BUTTON_COUNT];
+    uint64_t callbacks;
+    uint64_t duplicates;
+} Report;
+
+static void handle_button_down(const ControllerButton button, void *data) {
+    Report *report = data;
+    if (report->pressed[button]) ++report->duplicates;
+    report->pressed[button] = true;
+    ++report->callbacks;
+}
+
+static void handle_button_up(const ControllerButton button, void *data) {
+    Report *report = data;
+    if (!report->pressed[button]) ++report->duplicates;
+    report->pressed[button] = false;
+    ++report->callbacks;
+}
+
+/**
+ * Append an event to a burst.
+ */
+static void push_event(struct input_event *events, size_t *count,
+                       const uint16_t type, const uint16_t code,
+                       const int32_t value) {
+    memset(&events[*count], 0, sizeof(*events));
+    events[*count].type = type;
+    events[*count].code = code;
+    events[*count].value = value;
+    ++*count;
+}
+
+/**
+ * Send a burst of random frames, each one changing the state of the buttons,
+ * the D-pad and ZL.
+ *
+ * \param virtual_controller The virtual controller sending the events.
+ * \param sent The state of the buttons, updated to the last state sent.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool send_burst(VirtualController *virtual_controller,
+                       ButtonsState *sent) {
+    // Each frame has an event per button, the D-pad, ZL and SYN_REPORT.
+    static struct input_event events[FRAMES_PER_BURST * 16];
+    size_t count = 0;
+    for (size_t frame = 0; frame < FRAMES_PER_BURST; ++frame) {
+#define BUTTON(controller_button, button_code)              \
+        if (rand() % 2) {                                   \
+            sent->buttons[controller_button] =              \
+                !sent->buttons[controller_button];          \
+            push_event(events, &count, EV_KEY, button_code, \
+                       sent->buttons[controller_button]);   \
+        }
+        OVERFLOW_BUTTONS
+#undef BUTTON
+
+        const int hat = rand() % 3 - 1;
+        sent->buttons[CONTROLLER_BUTTON_LEFT] = hat < 0;
+        sent->buttons[CONTROLLER_BUTTON_RIGHT] = hat > 0;
+        push_event(events, &count, EV_ABS, ABS_HAT0X, hat);
+
+        const int trigger = rand() % 2 ? 255 : 0;
+        sent->buttons[CONTROLLER_BUTTON_ZL] = trigger != 0;
+        push_event(events, &count, EV_ABS, ABS_Z, trigger);
+
+        push_event(events, &count, EV_SYN, SYN_REPORT, 0);
+    }
+
+    return virtual_controller_write(virtual_controller, events, count);
+}
+
+/**
+ * Send bursts from the virtual controller and check the state reported by the
+ * controller after each one.
+ *
+ * \param virtual_controller The virtual controller sending the events.
+ * \param rounds The number of bursts to send.
+ *
+ * \returns true if the state always matched, or false on failure.
+ */
+static bool run(VirtualController *virtual_controller, const uint64_t rounds) {
+    Controller *controller = controller_from_device_path(
+        virtual_controller_get_path(virtual_controller)
+    );
+    if (!controller) return false;
+
+    ButtonsState sent;
+    memset(&sent, 0, sizeof(sent));
+    Report report;
+    memset(&report, 0, sizeof(report));
+    uint64_t mismatches = 0, sync_duration = 0;
+    bool success = true;
+    for (uint64_t round = 0; success && round < rounds; ++round) {
+        if (!send_burst(virtual_controller, &sent)) {
+            success = false;
+            break;
+        }
+
+        const uint64_t start = get_time_ns();
+        success = controller_update(controller, handle_button_down,
+                                    handle_button_up, &report);
+        sync_duration += get_time_ns() - start;
+
+        if (memcmp(report.pressed, sent.buttons, sizeof(sent.buttons))) {
+            ++mismatches;
+        }
+    }
+
+    if (success) {
+        printf("bench=overflow rounds=%lu frames_per_round=%d callbacks=%lu "
+               "duplicates=%lu mismatches=%lu ns_per_round=%.1f\n",
+               rounds, FRAMES_PER_BURST, report.callbacks, report.duplicates,
+               mismatches, (double)sync_duration / rounds);
+        success = !report.duplicates && !mismatches;
+        if (!success) log_errorf("state of the controller out of sync");
+    }
+
+    controller_destroy(controller);
+
+    return success;
+}
+
+int main(const int argc, char *argv[]) {
+    if (!log_init("bench-overflow")) return EXIT_FAILURE;
+
+    uint64_t rounds = DEFAULT_ROUNDS;
+    if (argc > 1) rounds = strtoull(argv[1], NULL, 10);
+    if (!rounds) {
+        log_errorf("invalid number of rounds: '%s'", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (access("/dev/uinput", R_OK | W_OK) < 0) {
+        printf("bench=overflow skipped=1\n");
+        log_quit();
+        return EXIT_SUCCESS;
+    }
+
+    if (!event_loop_init()) return EXIT_FAILURE;
+    VirtualController *virtual_controller = virtual_controller_create();
+    if (!virtual_controller) return EXIT_FAILURE;
+
+    srand(1);
+    const bool success = run(virtual_controller, rounds);
+
+    virtual_controller_destroy(virtual_controller);
+    event_loop_quit();
+    log_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
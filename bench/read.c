@@ -0,0 +1,214 @@
+/**
+ * Benchmark comparing the batched read() of the controller events with reading
+ * them one by one with libevdev, under a flood of synthetic events sent by a
+ * virtual controller.
+ *
+ * usage: bench/read [FRAMES]
+ *
+ * Each line of the output is a list of key=value pairs. The benchmark is
+ * skipped if /dev/uinput can't be used.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libevdev/libevdev.h>
+
+#include "controller.h"
+#include "event_loop.h"
+#include "log.h"
+#include "utils.h"
+#include "virtual_controller.h"
+
+#define DEFAULT_FRAMES 200000
+
+/**
+ * Number of frames sent before reading them, small enough to never overflow
+ * the buffer of the kernel.
+ */
+#define FRAMES_PER_ROUND 8
+
+/**
+ * Number of events of a frame: both axes of the left stick and SYN_REPORT.
+ */
+#define EVENTS_PER_FRAME 3
+
+/**
+ * Count the events read by controller_read().
+ * See ControllerEventCallBack.
+ *
+ * \param event Unused.
+ * \param data A pointer to the number of events read.
+ */
+static void count_event(const struct input_event *event, void *data) {
+    (void)event;
+
+    ++*(uint64_t *)data;
+}
+
+/**
+ * Read the pending events one by one with libevdev, as controller_read() did
+ * before reading batches.
+ *
+ * \param dev The libevdev device to read.
+ * \param count A pointer to the number of events read.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool libevdev_read(struct libevdev *dev, uint64_t *count) {
+    struct input_event event;
+    int return_code;
+    while ((return_code = libevdev_next_event(dev, LIBEVDEV_READ_FLAG_NORMAL,
+                                              &event)) >= 0) {
+        ++*count;
+    }
+    if (return_code != -EAGAIN) {
+        log_errorf("failed to get next event: %s", strerror(-return_code));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Print the result of a reading method.
+ *
+ * \param method The name of the method.
+ * \param events The number of events read.
+ * \param duration The time spent reading in nanoseconds.
+ */
+static void print_result(const char *method, const uint64_t events,
+                         const uint64_t duration) {
+    printf("bench=read method=%s events=%lu ns_per_event=%.1f\n", method,
+           events, (double)duration / events);
+}
+
+/**
+ * Send frames from the virtual controller and read them with both methods.
+ *
+ * \param virtual_controller The virtual controller sending the events.
+ * \param frames The number of frames to send.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool run(VirtualController *virtual_controller, const uint64_t frames) {
+    Controller *controller = controller_from_device_path(
+        virtual_controller_get_path(virtual_controller)
+    );
+    if (!controller) return false;
+    // The controller is ungrabbed so the libevdev reader receives the events.
+    if (!controller_toggle_grabbed(controller)) {
+        controller_destroy(controller);
+        return false;
+    }
+
+    const int fd = open(virtual_controller_get_path(virtual_controller),
+                        O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        log_errorf("failed to open %s: %s",
+                   virtual_controller_get_path(virtual_controller),
+                   strerror(errno));
+        controller_destroy(controller);
+        return false;
+    }
+    struct libevdev *dev;
+    const int err = libevdev_new_from_fd(fd, &dev);
+    if (err < 0) {
+        log_errorf("failed to initialize libevdev device: %s", strerror(-err));
+        close(fd);
+        controller_destroy(controller);
+        return false;
+    }
+
+    // Drop the events sent before, such as the rumble.
+    uint64_t raw_events = 0, libevdev_events = 0;
+    bool success = (
+        controller_read(controller, count_event, &raw_events) &&
+        libevdev_read(dev, &libevdev_events)
+    );
+    raw_events = 0;
+    libevdev_events = 0;
+
+    struct input_event events[FRAMES_PER_ROUND * EVENTS_PER_FRAME];
+    memset(events, 0, sizeof(events));
+    uint64_t raw_duration = 0, libevdev_duration = 0;
+    for (uint64_t frame = 0; success && frame < frames;
+         frame += FRAMES_PER_ROUND) {
+        for (size_t i = 0; i < FRAMES_PER_ROUND; ++i) {
+            struct input_event *frame_events = &events[i * EVENTS_PER_FRAME];
+            const int value = (frame + i) % 65536 - 32768;
+            frame_events[0].type = EV_ABS;
+            frame_events[0].code = ABS_X;
+            frame_events[0].value = value;
+            frame_events[1].type = EV_ABS;
+            frame_events[1].code = ABS_Y;
+            frame_events[1].value = -value - 1;
+            frame_events[2].type = EV_SYN;
+            frame_events[2].code = SYN_REPORT;
+        }
+        if (!virtual_controller_write(virtual_controller, events,
+                                      sizeof(events) / sizeof(*events))) {
+            success = false;
+            break;
+        }
+
+        uint64_t start = get_time_ns();
+        success = controller_read(controller, count_event, &raw_events);
+        raw_duration += get_time_ns() - start;
+
+        start = get_time_ns();
+        success = success && libevdev_read(dev, &libevdev_events);
+        libevdev_duration += get_time_ns() - start;
+    }
+
+    if (success) {
+        print_result("raw", raw_events, raw_duration);
+        print_result("libevdev", libevdev_events, libevdev_duration);
+        if (raw_events != libevdev_events) {
+            log_errorf("methods read a different number of events: %lu != %lu",
+                       raw_events, libevdev_events);
+            success = false;
+        }
+    }
+
+    libevdev_free(dev);
+    close(fd);
+    controller_destroy(controller);
+
+    return success;
+}
+
+int main(const int argc, char *argv[]) {
+    if (!log_init("bench-read")) return EXIT_FAILURE;
+
+    uint64_t frames = DEFAULT_FRAMES;
+    if (argc > 1) frames = strtoull(argv[1], NULL, 10);
+    if (!frames) {
+        log_errorf("invalid number of frames: '%s'", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (access("/dev/uinput", R_OK | W_OK) < 0) {
+        printf("bench=read skipped=1\n");
+        log_quit();
+        return EXIT_SUCCESS;
+    }
+
+    if (!event_loop_init()) return EXIT_FAILURE;
+    VirtualController *virtual_controller = virtual_controller_create();
+    if (!virtual_controller) return EXIT_FAILURE;
+
+    const bool success = run(virtual_controller, frames);
+
+    virtual_controller_destroy(virtual_controller);
+    event_loop_quit();
+    log_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,15 @@
 complete --command desktop-controller --no-files --arguments "(desktop-controller --list | tr ':' '\t')"
 
-complete --command desktop-controller --short-option h --long-option help    --description 'Print help'
-complete --command desktop-controller --short-option v --long-option version --description 'Print version'
-complete --command desktop-controller --short-option l --long-option list    --description 'list all available controllers and exit'
+complete --command desktop-controller --short-option h --long-option help     --description 'Print help'
+complete --command desktop-controller --short-option v --long-option version  --description 'Print version'
+complete --command desktop-controller --short-option l --long-option list     --description 'list all available controllers and exit'
+complete --command desktop-controller --short-option t --long-option threaded --description 'read each controller in a dedicated input thread'
+complete --command desktop-controller --short-option s --long-option smooth   --description 'scroll smoothly with high-resolution mouse wheel events'
+complete --command desktop-controller --short-option L --long-option latency  --description 'measure the latency of the outputs, printed on SIGUSR1 and at exit'
+complete --command desktop-controller --short-option f --long-option fast     --description 'replay the trace as fast as possible'
+complete --command desktop-controller --short-option p --long-option realtime --description 'run with a real-time priority and locked memory'
+complete --command desktop-controller --short-option b --long-option backend  --require-parameter --no-files --arguments 'xdo uinput' --description 'the output backend to use'
+complete --command desktop-controller --short-option c --long-option config   --require-parameter --description 'the config file to use'
+complete --command desktop-controller --short-option r --long-option record   --require-parameter --description 'record the events of the controllers to a trace'
+complete --command desktop-controller --short-option R --long-option replay   --require-parameter --description 'replay a trace instead of reading the controllers'
+complete --command desktop-controller --short-option C --long-option cpu      --require-parameter --no-files --description 'pin the input and output work to a CPU'
@@ -1,12 +1,21 @@
 #pragma once
 
 /**
- * Config file of the application.
+ * Config file of the application. These are the defaults, which the runtime
+ * config file read by config_file.c can override.
  */
 
 #include "controller.h"
+#include "curve.h"
 #include "mouse_buttons.h"
 
+/**
+ * Output backend used when none is given on the command-line: "xdo" to send
+ * the events to the X server or "uinput" to send them through a virtual input
+ * device, which also works on Wayland.
+ */
+#define DEFAULT_OUTPUT_BACKEND "xdo"
+
 /**
  * Default mouse speed multiplier.
  */
@@ -17,6 +26,64 @@
  */
 #define PRECISION_MOUSE_SPEED 0.3f
 
+/**
+ * Part of the range of the sticks near their edges where they are considered
+ * fully pushed. The deadzone around their center is calibrated for each
+ * controller.
+ */
+#define STICK_SATURATION 0.01f
+
+/**
+ * Response curve of the left stick moving the mouse, in pixels per
+ * millisecond. See CurveConfig for the available curves, for example:
+ * {.type = CURVE_EXPONENTIAL, .exponent = 2.0f, ...} moves the mouse slower
+ * near the center, or {.type = CURVE_SPLINE, .points = (const float[]){0.0f,
+ * 0.2f, 1.0f}, .points_count = 3, ...} follows custom points.
+ */
+#define POINTER_CURVE                   \
+    {                                   \
+        .type = CURVE_LINEAR,           \
+        .gain = DEFAULT_MOUSE_SPEED,    \
+        .saturation = STICK_SATURATION, \
+    }
+
+/**
+ * Response curve of the left stick while the MOUSE_SPEED_BUTTON is pressed.
+ */
+#define PRECISION_POINTER_CURVE         \
+    {                                   \
+        .type = CURVE_LINEAR,           \
+        .gain = PRECISION_MOUSE_SPEED,  \
+        .saturation = STICK_SATURATION, \
+    }
+
+/**
+ * Response curve of the right stick scrolling, in mouse wheel notches per
+ * second. By default, the delay between two notches goes from
+ * SCROLL_MIN_SPEED to SCROLL_MAX_SPEED with get_scroll_speed() of
+ * config_file.c.
+ */
+#define SCROLL_CURVE                    \
+    {                                   \
+        .type = CURVE_FUNCTION,         \
+        .gain = 1.0f,                   \
+        .saturation = STICK_SATURATION, \
+        .function = get_scroll_speed,   \
+    }
+
+/**
+ * Number of times per second the mouse is moved while the left stick is not
+ * centered. Setting it to the refresh rate of the display gives one move per
+ * frame.
+ */
+#define POINTER_UPDATE_RATE 1000  // Hz
+
+/**
+ * Priority of the real-time scheduling of --realtime, between 1 and 99.
+ * RealtimeKit only grants up to 20 by default.
+ */
+#define REALTIME_PRIORITY 10
+
 /**
  * Delay in miliseconds between two mouse wheel presses to control the minimum
  * scroll speed.
@@ -0,0 +1,532 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "config.h"
+#include "config_file.h"
+#include "controller.h"
+#include "curve.h"
+#include "log.h"
+#include "mapping.h"
+#include "mouse_buttons.h"
+#include "utils.h"
+
+#define CONFIG_PATH_SIZE 4096
+#define CONFIG_LINE_SIZE 256
+#define CONFIG_SPLINE_POINTS_MAX 16
+#define CONFIG_BUTTON_PREFIX "button."
+
+/**
+ * Names of the controller buttons in the config file.
+ */
+static const char *const button_names[CONTROLLER_BUTTON_COUNT] = {
+    [CONTROLLER_BUTTON_B] = "B",
+    [CONTROLLER_BUTTON_A] = "A",
+    [CONTROLLER_BUTTON_Y] = "Y",
+    [CONTROLLER_BUTTON_X] = "X",
+    [CONTROLLER_BUTTON_L] = "L",
+    [CONTROLLER_BUTTON_R] = "R",
+    [CONTROLLER_BUTTON_MINUS] = "MINUS",
+    [CONTROLLER_BUTTON_PLUS] = "PLUS",
+    [CONTROLLER_BUTTON_HOME] = "HOME",
+    [CONTROLLER_BUTTON_LPAD] = "LPAD",
+    [CONTROLLER_BUTTON_RPAD] = "RPAD",
+    [CONTROLLER_BUTTON_UP] = "UP",
+    [CONTROLLER_BUTTON_DOWN] = "DOWN",
+    [CONTROLLER_BUTTON_LEFT] = "LEFT",
+    [CONTROLLER_BUTTON_RIGHT] = "RIGHT",
+    [CONTROLLER_BUTTON_ZL] = "ZL",
+    [CONTROLLER_BUTTON_ZR] = "ZR",
+};
+
+/**
+ * Delays between two mouse wheel notches of the default scroll curve.
+ */
+typedef struct {
+    float min_speed;  // ms
+    float max_speed;  // ms
+} ScrollSpeeds;
+
+/**
+ * A curve of the config file with the storage of its spline points.
+ */
+typedef struct {
+    CurveConfig config;
+    float points[CONFIG_SPLINE_POINTS_MAX];
+} ConfigCurve;
+
+/**
+ * The state of a config file being read. The curves are compiled and the
+ * profiles are completed once the whole file is read.
+ */
+typedef struct {
+    ConfigCurve pointer_curve;
+    ConfigCurve precision_pointer_curve;
+    ConfigCurve scroll_curve;
+    ScrollSpeeds scroll_speeds;
+
+    /**
+     * The profile of the current section, or NULL outside of the sections.
+     */
+    Profile *profile;
+
+    /**
+     * The buttons set by each profile, the others keep the default mapping.
+     */
+    bool buttons_set[CONFIG_PROFILES_MAX][CONTROLLER_BUTTON_COUNT];
+} ConfigParser;
+
+/**
+ * Determine the scroll speed based on the stick input value. This is the shape
+ * of the default SCROLL_CURVE.
+ *
+ * \param x The normalized position of the stick between 0.0 and 1.0.
+ * \param data A pointer to the ScrollSpeeds.
+ *
+ * \return The number of mouse wheel notches per second.
+ */
+static float get_scroll_speed(const float x, const void *data) {
+    const ScrollSpeeds *scroll_speeds = data;
+    return 1000.0f / (
+        scroll_speeds->min_speed * (x - 1.0f) * (x - 1.0f) +
+        scroll_speeds->max_speed
+    );
+}
+
+const char *config_get_default_path(void) {
+    static char path[CONFIG_PATH_SIZE];
+
+    const char *config_home = getenv("XDG_CONFIG_HOME");
+    int size;
+    if (config_home && *config_home) {
+        size = snprintf(path, sizeof(path), "%s/desktop-controller/config",
+                        config_home);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || !*home) return NULL;
+        size = snprintf(path, sizeof(path),
+                        "%s/.config/desktop-controller/config", home);
+    }
+    if (size < 0 || (size_t)size >= sizeof(path)) return NULL;
+
+    return path;
+}
+
+/**
+ * Remove the spaces at the start and at the end of a string.
+ *
+ * \param string The string to trim, modified in place.
+ *
+ * \returns the start of the trimmed string.
+ */
+static char *config_trim(char *string) {
+    while (isspace((unsigned char)*string)) ++string;
+    char *end = string + strlen(string);
+    while (end > string && isspace((unsigned char)end[-1])) --end;
+    *end = '\0';
+    return string;
+}
+
+/**
+ * Parse a float.
+ *
+ * \param string The string to parse.
+ * \param value A pointer to the float where the value will be stored.
+ *
+ * \returns true on success, or false if the string isn't a float.
+ */
+static bool config_parse_float(const char *string, float *value) {
+    char *end;
+    errno = 0;
+    *value = strtof(string, &end);
+    return end != string && !*end && !errno;
+}
+
+/**
+ * Parse a float greater than 0.0.
+ *
+ * \param string The string to parse.
+ * \param value A pointer to the float where the value will be stored.
+ *
+ * \returns true on success, or false if the string isn't a positive float.
+ */
+static bool config_parse_positive(const char *string, float *value) {
+    return config_parse_float(string, value) && *value > 0.0f;
+}
+
+/**
+ * Parse a curve: "linear", "exponential EXPONENT" or "spline POINTS...". The
+ * gain, the deadzone and the saturation of the curve are kept.
+ *
+ * \param string The string to parse, modified by the parsing.
+ * \param curve A pointer to the ConfigCurve where the curve will be stored.
+ *
+ * \returns true on success, or false if the curve is invalid.
+ */
+static bool config_parse_curve(char *string, ConfigCurve *curve) {
+    char *save_ptr;
+    const char *type = strtok_r(string, " \t", &save_ptr);
+    if (!type) return false;
+
+    if (streq(type, "linear")) {
+        curve->config.type = CURVE_LINEAR;
+    } else if (streq(type, "exponential")) {
+        const char *exponent = strtok_r(NULL, " \t", &save_ptr);
+        if (!exponent ||
+            !config_parse_positive(exponent, &curve->config.exponent)) {
+            return false;
+        }
+        curve->config.type = CURVE_EXPONENTIAL;
+    } else if (streq(type, "spline")) {
+        size_t count = 0;
+        for (const char *point; (point = strtok_r(NULL, " \t", &save_ptr));) {
+            if (count == CONFIG_SPLINE_POINTS_MAX ||
+                !config_parse_float(point, &curve->points[count])) {
+                return false;
+            }
+            ++count;
+        }
+        if (count < 2) return false;
+        curve->config.type = CURVE_SPLINE;
+        curve->config.points = curve->points;
+        curve->config.points_count = count;
+    } else {
+        return false;
+    }
+
+    return !strtok_r(NULL, " \t", &save_ptr);
+}
+
+/**
+ * Parse a mouse button without its MOUSE_ prefix, case insensitive.
+ *
+ * \param string The string to parse.
+ * \param button A pointer to the MouseButton where the button will be stored.
+ *
+ * \returns true on success, or false if the button is unknown.
+ */
+static bool config_parse_mouse_button(const char *string,
+                                      MouseButton *button) {
+#define MOUSE_BUTTON(name, value)                                \
+    if (strcasecmp(string, #name + sizeof("MOUSE_") - 1) == 0) { \
+        *button = name;                                          \
+        return true;                                             \
+    }
+    MOUSE_BUTTONS
+#undef MOUSE_BUTTON
+
+    return false;
+}
+
+/**
+ * Parse the action of a button: "none", "grab_toggle", "mouse_speed",
+ * "mouse BUTTON" or "keys SHORTCUT".
+ *
+ * \param string The string to parse, modified by the parsing.
+ * \param action A pointer to the Action where the action will be stored.
+ *
+ * \returns true on success, or false if the action is invalid.
+ */
+static bool config_parse_action(char *string, Action *action) {
+    char *argument = string + strcspn(string, " \t");
+    if (*argument) *argument++ = '\0';
+    argument = config_trim(argument);
+
+    Action parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    if (streq(string, "mouse")) {
+        if (!config_parse_mouse_button(argument, &parsed.mouse_button)) {
+            return false;
+        }
+        parsed.type = ACTION_MOUSE_BUTTON;
+    } else if (streq(string, "keys")) {
+        if (!*argument || !mapping_set_keys(&parsed, argument)) return false;
+    } else if (*argument) {
+        return false;
+    } else if (streq(string, "none")) {
+        parsed.type = ACTION_NONE;
+    } else if (streq(string, "grab_toggle")) {
+        parsed.type = ACTION_GRAB_TOGGLE;
+    } else if (streq(string, "mouse_speed")) {
+        parsed.type = ACTION_MOUSE_SPEED;
+    } else {
+        return false;
+    }
+
+    *action = parsed;
+    return true;
+}
+
+/**
+ * Parse the action of a button from the key and the value of a setting. The
+ * action is set in the profile of the current section, if any.
+ *
+ * \param name The name of the button after the "button." prefix.
+ * \param value The value of the setting, modified by the parsing.
+ * \param config A pointer to the config being loaded.
+ * \param parser A pointer to the state of the config file being read.
+ *
+ * \returns true on success, or false if the setting is invalid.
+ */
+static bool config_parse_button(const char *name, char *value, Config *config,
+                                ConfigParser *parser) {
+    Mapping *mapping = parser->profile
+        ? &parser->profile->mapping
+        : &config->mapping;
+    for (ControllerButton button = 0; button < CONTROLLER_BUTTON_COUNT;
+         ++button) {
+        if (strcasecmp(name, button_names[button]) != 0) continue;
+        if (!config_parse_action(value, &mapping->actions[button])) {
+            return false;
+        }
+        if (parser->profile) {
+            const size_t profile = parser->profile - config->profiles;
+            parser->buttons_set[profile][button] = true;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Start a section: "[window CLASS]" starts the profile of the windows of a
+ * class. A section already started for the same class is continued.
+ *
+ * \param section The line of the section, modified by the parsing.
+ * \param config A pointer to the config being loaded.
+ * \param parser A pointer to the state of the config file being read.
+ *
+ * \returns true on success, or false if the section is invalid.
+ */
+static bool config_parse_section(char *section, Config *config,
+                                 ConfigParser *parser) {
+    const size_t length = strlen(section);
+    if (section[length - 1] != ']') return false;
+    section[length - 1] = '\0';
+
+    char *type = config_trim(section + 1);
+    char *window_class = type + strcspn(type, " \t");
+    if (*window_class) *window_class++ = '\0';
+    window_class = config_trim(window_class);
+    if (!streq(type, "window") || !*window_class ||
+        strlen(window_class) >= CONFIG_WINDOW_CLASS_SIZE) {
+        return false;
+    }
+
+    for (size_t i = 0; i < config->profiles_count; ++i) {
+        if (strcasecmp(config->profiles[i].window_class, window_class) == 0) {
+            parser->profile = &config->profiles[i];
+            return true;
+        }
+    }
+
+    if (config->profiles_count == CONFIG_PROFILES_MAX) return false;
+    parser->profile = &config->profiles[config->profiles_count++];
+    strcpy(parser->profile->window_class, window_class);
+    return true;
+}
+
+/**
+ * Apply a setting of the config file.
+ *
+ * \param key The key of the setting.
+ * \param value The value of the setting, modified by the parsing.
+ * \param config A pointer to the config being loaded.
+ * \param parser A pointer to the state of the config file being read.
+ *
+ * \returns true on success, or false if the setting is invalid.
+ */
+static bool config_parse_setting(const char *key, char *value, Config *config,
+                                 ConfigParser *parser) {
+    if (!strncmp(key, CONFIG_BUTTON_PREFIX, strlen(CONFIG_BUTTON_PREFIX))) {
+        return config_parse_button(key + strlen(CONFIG_BUTTON_PREFIX), value,
+                                   config, parser);
+    }
+
+    // Only the buttons can be set in a profile.
+    if (parser->profile) return false;
+
+    if (streq(key, "mouse_speed")) {
+        return config_parse_positive(value, &parser->pointer_curve.config.gain);
+    }
+    if (streq(key, "precision_mouse_speed")) {
+        return config_parse_positive(
+            value,
+            &parser->precision_pointer_curve.config.gain
+        );
+    }
+    if (streq(key, "scroll_min_speed")) {
+        return config_parse_positive(value, &parser->scroll_speeds.min_speed);
+    }
+    if (streq(key, "scroll_max_speed")) {
+        return config_parse_positive(value, &parser->scroll_speeds.max_speed);
+    }
+    if (streq(key, "stick_saturation")) {
+        float saturation;
+        if (!config_parse_float(value, &saturation) || saturation < 0.0f ||
+            saturation >= 1.0f) {
+            return false;
+        }
+        parser->pointer_curve.config.saturation = saturation;
+        parser->precision_pointer_curve.config.saturation = saturation;
+        parser->scroll_curve.config.saturation = saturation;
+        return true;
+    }
+    if (streq(key, "pointer_curve")) {
+        return config_parse_curve(value, &parser->pointer_curve);
+    }
+    if (streq(key, "precision_pointer_curve")) {
+        return config_parse_curve(value, &parser->precision_pointer_curve);
+    }
+    if (streq(key, "scroll_curve")) {
+        return config_parse_curve(value, &parser->scroll_curve);
+    }
+
+    return false;
+}
+
+/**
+ * Read the settings of a config file.
+ *
+ * \param file The config file.
+ * \param path The path of the config file used in the errors.
+ * \param config A pointer to the config being loaded.
+ * \param parser A pointer to the state of the config file being read.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool config_read(FILE *file, const char *path, Config *config,
+                        ConfigParser *parser) {
+    char line[CONFIG_LINE_SIZE];
+    for (size_t line_number = 1; fgets(line, sizeof(line), file);
+         ++line_number) {
+        if (!strchr(line, '\n') && !feof(file)) {
+            log_errorf("%s:%zu: line too long", path, line_number);
+            return false;
+        }
+        line[strcspn(line, "#\n")] = '\0';
+
+        char *key = config_trim(line);
+        if (!*key) continue;
+
+        if (*key == '[') {
+            if (!config_parse_section(key, config, parser)) {
+                log_errorf("%s:%zu: invalid section", path, line_number);
+                return false;
+            }
+            continue;
+        }
+
+        char *separator = strchr(key, '=');
+        if (!separator) {
+            log_errorf("%s:%zu: expected 'key = value'", path, line_number);
+            return false;
+        }
+        *separator = '\0';
+        key = config_trim(key);
+        char *value = config_trim(separator + 1);
+
+        if (!config_parse_setting(key, value, config, parser)) {
+            log_errorf("%s:%zu: invalid setting '%s'", path, line_number,
+                       key);
+            return false;
+        }
+    }
+
+    if (ferror(file)) {
+        log_errorf("failed to read %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+Config *config_load(const char *path, const bool required) {
+    Config *config = malloc(sizeof(*config));
+    if (!config) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return NULL;
+    }
+    if (!mapping_init(&config->mapping)) {
+        free(config);
+        return NULL;
+    }
+    config->profiles_count = 0;
+
+    ConfigParser parser = {
+        .pointer_curve.config = POINTER_CURVE,
+        .precision_pointer_curve.config = PRECISION_POINTER_CURVE,
+        .scroll_curve.config = SCROLL_CURVE,
+        .scroll_speeds = {
+            .min_speed = SCROLL_MIN_SPEED,
+            .max_speed = SCROLL_MAX_SPEED,
+        },
+    };
+
+    FILE *file = path ? fopen(path, "r") : NULL;
+    if (file) {
+        const bool success = config_read(file, path, config, &parser);
+        fclose(file);
+        if (!success) {
+            free(config);
+            return NULL;
+        }
+        log_debugf("loaded config %s", path);
+    } else if (path && (required || errno != ENOENT)) {
+        log_errorf("failed to open %s: %s", path, strerror(errno));
+        free(config);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < config->profiles_count; ++i) {
+        for (ControllerButton button = 0; button < CONTROLLER_BUTTON_COUNT;
+             ++button) {
+            if (!parser.buttons_set[i][button]) {
+                config->profiles[i].mapping.actions[button] = (
+                    config->mapping.actions[button]
+                );
+            }
+        }
+    }
+
+    if (parser.scroll_curve.config.type != CURVE_FUNCTION) {
+        // The gain of the other curve types is the fastest scroll speed, in
+        // notches per second.
+        parser.scroll_curve.config.gain = (
+            1000.0f / parser.scroll_speeds.max_speed
+        );
+    }
+    parser.scroll_curve.config.function_data = &parser.scroll_speeds;
+
+    curve_init(&config->pointer_curve, &parser.pointer_curve.config);
+    curve_init(&config->precision_pointer_curve,
+               &parser.precision_pointer_curve.config);
+    curve_init(&config->scroll_curve, &parser.scroll_curve.config);
+
+    return config;
+}
+
+const Mapping *config_get_mapping(const Config *config,
+                                  const char *instance_name,
+                                  const char *class_name) {
+    for (size_t i = 0; i < config->profiles_count; ++i) {
+        const Profile *profile = &config->profiles[i];
+        if ((class_name &&
+             strcasecmp(profile->window_class, class_name) == 0) ||
+            (instance_name &&
+             strcasecmp(profile->window_class, instance_name) == 0)) {
+            return &profile->mapping;
+        }
+    }
+
+    return &config->mapping;
+}
+
+void config_free(Config *config) {
+    free(config);
+}
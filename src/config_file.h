@@ -0,0 +1,111 @@
+#pragma once
+
+/**
+ * Runtime configuration of the application, read from a config file on top of
+ * the defaults of config.h.
+ *
+ * The config file is compiled into the same tables used when handling the
+ * events, so a new config replaces the previous one by swapping a pointer and
+ * the events are never handled with a config being parsed.
+ *
+ * Each line of the config file is a `key = value` setting, and everything after
+ * a `#` is a comment:
+ *
+ *     mouse_speed = 1.7
+ *     precision_mouse_speed = 0.3
+ *     scroll_min_speed = 500
+ *     scroll_max_speed = 30
+ *     stick_saturation = 0.01
+ *     pointer_curve = exponential 2.0
+ *     precision_pointer_curve = linear
+ *     scroll_curve = spline 0.0 0.1 0.3 1.0
+ *     button.A = mouse left
+ *     button.B = keys Escape
+ *     button.L = mouse_speed
+ *     button.HOME = grab_toggle
+ *     button.X = none
+ *
+ * A `[window CLASS]` section starts the profile of the windows whose WM_CLASS
+ * class or instance name is CLASS, case insensitive. Only the buttons can be
+ * set in a profile, the other buttons keep the actions set outside of the
+ * sections:
+ *
+ *     [window mpv]
+ *     button.A = keys space
+ *     button.LEFT = keys Left
+ *     button.RIGHT = keys Right
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "curve.h"
+#include "mapping.h"
+
+#define CONFIG_PROFILES_MAX 32
+#define CONFIG_WINDOW_CLASS_SIZE 64
+
+/**
+ * The mapping used while a window of a given class is active.
+ */
+typedef struct {
+    char window_class[CONFIG_WINDOW_CLASS_SIZE];
+    Mapping mapping;
+} Profile;
+
+/**
+ * A config compiled into the tables used when handling the events.
+ */
+typedef struct {
+    Mapping mapping;  // Used by the windows without a profile.
+    Profile profiles[CONFIG_PROFILES_MAX];
+    size_t profiles_count;
+    Curve pointer_curve;
+    Curve precision_pointer_curve;
+    Curve scroll_curve;
+} Config;
+
+/**
+ * Get the path of the config file used when none is given on the
+ * command-line: $XDG_CONFIG_HOME/desktop-controller/config, or
+ * ~/.config/desktop-controller/config.
+ *
+ * \returns the path of the config file, or NULL if it can't be determined.
+ */
+const char *config_get_default_path(void);
+
+/**
+ * Load a config. The output must be initialized since the keyboard shortcuts
+ * are resolved with output_compile_keys().
+ *
+ * \param path The path of the config file, or NULL to only use the defaults of
+ *             config.h.
+ * \param required Whether a missing config file is an error. Otherwise, the
+ *                 defaults of config.h are used.
+ *
+ * \returns the config which need to be freed with config_free(), or NULL on
+ *          failure.
+ */
+Config *config_load(const char *path, const bool required);
+
+/**
+ * Get the mapping to use for a window.
+ *
+ * \param config The config.
+ * \param instance_name The instance name of the WM_CLASS of the window, or
+ *                      NULL.
+ * \param class_name The class name of the WM_CLASS of the window, or NULL.
+ *
+ * \returns the mapping of the first profile matching the window, or the
+ *          default mapping of the config.
+ */
+const Mapping *config_get_mapping(const Config *config,
+                                  const char *instance_name,
+                                  const char *class_name);
+
+/**
+ * Free a config loaded with config_load().
+ *
+ * \param config The config to free.
+ */
+void config_free(Config *config);
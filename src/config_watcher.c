@@ -0,0 +1,108 @@
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "config_watcher.h"
+#include "event_loop.h"
+#include "log.h"
+#include "utils.h"
+
+static int inotify_fd = -1;
+static ConfigWatcherCallBack on_change = NULL;
+
+/**
+ * The name of the config file in its directory.
+ */
+static char *file_name = NULL;
+
+/**
+ * Handle the inotify events of the directory of the config file.
+ * See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool config_watcher_handle_events(void *data) {
+    (void)data;
+
+    char buffer[sizeof(struct inotify_event) + NAME_MAX + 1]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    for (;;) {
+        const ssize_t size = read(inotify_fd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EAGAIN) break;
+            log_errorf("failed to read inotify events: %s", strerror(errno));
+            return false;
+        }
+
+        const struct inotify_event *event;
+        for (char *ptr = buffer; ptr < buffer + size;
+             ptr += sizeof(*event) + event->len) {
+            event = (const struct inotify_event *)ptr;
+            if (event->len && streq(event->name, file_name)) changed = true;
+        }
+    }
+
+    // The config is reloaded once for all the events read together.
+    if (!changed) return true;
+    log_debugf("config file changed");
+    return on_change();
+}
+
+bool config_watcher_init(const char *path,
+                         const ConfigWatcherCallBack new_on_change) {
+    on_change = new_on_change;
+
+    char *path_copy = strdup(path);
+    file_name = strdup(path);
+    if (!path_copy || !file_name) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        free(path_copy);
+        config_watcher_quit();
+        return false;
+    }
+    const char *directory = dirname(path_copy);
+    const char *base_name = basename(file_name);
+    memmove(file_name, base_name, strlen(base_name) + 1);
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        log_errorf("failed to initialize inotify: %s", strerror(errno));
+        free(path_copy);
+        config_watcher_quit();
+        return false;
+    }
+
+    if (inotify_add_watch(inotify_fd, directory,
+                          IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        // The config file is optional, so its directory may not exist.
+        log_debugf("failed to watch %s: %s", directory, strerror(errno));
+        free(path_copy);
+        config_watcher_quit();
+        return true;
+    }
+    free(path_copy);
+
+    if (!event_loop_add_fd(inotify_fd, config_watcher_handle_events, NULL)) {
+        config_watcher_quit();
+        return false;
+    }
+
+    return true;
+}
+
+void config_watcher_quit(void) {
+    free(file_name);
+    file_name = NULL;
+    if (inotify_fd < 0) return;
+    event_loop_remove_fd(inotify_fd);
+    close(inotify_fd);
+    inotify_fd = -1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/**
+ * Watcher of the config file, integrated with the event loop through inotify.
+ *
+ * The directory of the config file is watched rather than the file itself, so
+ * the config file is still watched when an editor replaces it, and when it is
+ * created after the start of the app.
+ */
+
+#include <stdbool.h>
+
+/**
+ * Callback function called when the config file was written or replaced.
+ *
+ * \returns true on success, or false on failure which stops the event loop.
+ */
+typedef bool (*ConfigWatcherCallBack)(void);
+
+/**
+ * Start watching the config file. The event loop must be initialized.
+ *
+ * \param path The path of the config file.
+ * \param on_change A callback function that is invoked when the config file
+ *                  changes.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool config_watcher_init(const char *path,
+                         const ConfigWatcherCallBack on_change);
+
+/**
+ * Stop watching the config file.
+ */
+void config_watcher_quit(void);
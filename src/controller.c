@@ -1,6 +1,10 @@
+#define _GNU_SOURCE  // versionsort()
+
 #include <assert.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -9,20 +13,41 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <libevdev/libevdev.h>
 
 #include "controller.h"
+#include "event_loop.h"
 #include "log.h"
 #include "utils.h"
 
-#define CONTROLLER_AXIS_MAX 32767
-#define CONTROLLER_AXIS_MIN -32768
-#define CONTROLLER_AXIS_ROUND 0.01f
+#define CONTROLLER_STICK_DEADZONE 0.05f  // minimum radius of the deadzone
+#define CONTROLLER_CENTER_TOLERANCE 0.25f  // maximum offset of a learned center
+#define CONTROLLER_CALIBRATION_CACHE_SIZE 8  // devices
 #define CONTROLLER_RUMBLE_DURATION 500  // ms
+#define CONTROLLER_READ_BUFFER_SIZE 64  // events
+
+#define INPUT_DIR "/dev/input"
+#define SYSFS_INPUT_DIR "/sys/class/input"
+#define SYSFS_CAPABILITY_SIZE 1024
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+#define BITS_TO_LONGS(count) (((count) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define TEST_BIT(bits, bit) \
+    (((bits)[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+#define SET_BIT(bits, bit) \
+    ((bits)[(bit) / BITS_PER_LONG] |= 1UL << ((bit) % BITS_PER_LONG))
+
+#define BUTTON_BIT(button) (UINT32_C(1) << (button))
 
-#define DEVICE_PATH_SIZE 27
+// Mapping the axes of the sticks to their code
+#define CONTROLLER_STICK_AXES              \
+    STICK_AXIS(STICK_AXIS_LEFT_X, ABS_X)   \
+    STICK_AXIS(STICK_AXIS_LEFT_Y, ABS_Y)   \
+    STICK_AXIS(STICK_AXIS_RIGHT_X, ABS_RX) \
+    STICK_AXIS(STICK_AXIS_RIGHT_Y, ABS_RY)
 
 // Mapping buttons to their code
 #define CONTROLLER_BUTTONS                      \
@@ -38,14 +63,141 @@
     BUTTON(CONTROLLER_BUTTON_LPAD, BTN_THUMBL)  \
     BUTTON(CONTROLLER_BUTTON_RPAD, BTN_THUMBR)
 
+// Mapping trigger buttons to the code of their axis
+#define CONTROLLER_TRIGGERS              \
+    TRIGGER(CONTROLLER_BUTTON_ZL, ABS_Z) \
+    TRIGGER(CONTROLLER_BUTTON_ZR, ABS_RZ)
+
+// Mapping hat buttons of the positive and negative directions to the code of
+// their axis
+#define CONTROLLER_HATS                                             \
+    HAT(CONTROLLER_BUTTON_RIGHT, CONTROLLER_BUTTON_LEFT, ABS_HAT0X) \
+    HAT(CONTROLLER_BUTTON_DOWN, CONTROLLER_BUTTON_UP, ABS_HAT0Y)
+
+/**
+ * The axes of the sticks, built from CONTROLLER_STICK_AXES.
+ */
+typedef enum {
+#define STICK_AXIS(stick_axis, axis_code) stick_axis,
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+    STICK_AXIS_COUNT,
+} StickAxis;
+
+/**
+ * Entry of the table mapping the code of an EV_KEY event to a button.
+ */
+typedef struct {
+    bool mapped;
+    uint8_t button;
+} KeyDispatch;
+
+/**
+ * Table mapping the code of an EV_KEY event to a button, built from
+ * CONTROLLER_BUTTONS.
+ */
+static const KeyDispatch key_dispatch[KEY_CNT] = {
+#define BUTTON(controller_button, button_code) \
+    [button_code] = {true, controller_button},
+    CONTROLLER_BUTTONS
+#undef BUTTON
+};
+
+/**
+ * How an EV_ABS event is handled.
+ */
+typedef enum {
+    AXIS_IGNORED = 0,
+    AXIS_STICK,
+    AXIS_TRIGGER,
+    AXIS_HAT,
+} AxisKind;
+
+/**
+ * Entry of the table mapping the code of an EV_ABS event to its buttons or its
+ * stick axis.
+ */
+typedef struct {
+    uint8_t kind;
+    uint8_t button_positive;
+    uint8_t button_negative;
+    uint8_t stick_axis;
+} AxisDispatch;
+
+/**
+ * Table mapping the code of an EV_ABS event to its buttons or its stick axis,
+ * built from CONTROLLER_STICK_AXES, CONTROLLER_TRIGGERS and CONTROLLER_HATS.
+ */
+static const AxisDispatch axis_dispatch[ABS_CNT] = {
+#define STICK_AXIS(stick_axis, axis_code) \
+    [axis_code] = {AXIS_STICK, 0, 0, stick_axis},
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+#define TRIGGER(controller_button, axis_code) \
+    [axis_code] = {AXIS_TRIGGER, controller_button, controller_button, 0},
+    CONTROLLER_TRIGGERS
+#undef TRIGGER
+#define HAT(button_positive, button_negative, axis_code) \
+    [axis_code] = {AXIS_HAT, button_positive, button_negative, 0},
+    CONTROLLER_HATS
+#undef HAT
+};
+
+/**
+ * Calibration of a stick axis, from its absinfo and the center learned when
+ * the controller is opened.
+ */
+typedef struct {
+    int32_t center;
+    float scale_negative;  // 1.0 / (center - minimum)
+    float scale_positive;  // 1.0 / (maximum - center)
+    float deadzone;  // radius of the deadzone of the stick between 0.0 and 1.0
+} AxisCalibration;
+
+/**
+ * Calibration of a device kept after it is disconnected, so it isn't learned
+ * again when the device reconnects.
+ */
+typedef struct {
+    bool used;
+    struct input_id id;
+    char uniq[64];
+    AxisCalibration axes[STICK_AXIS_COUNT];
+} CalibrationCacheEntry;
+
+static CalibrationCacheEntry calibration_cache[
+    CONTROLLER_CALIBRATION_CACHE_SIZE
+];
+
+/**
+ * The entry of calibration_cache replaced by the next new device.
+ */
+static size_t calibration_cache_next = 0;
+
 struct _Controller {
     int fd;
+    char *path;
     struct libevdev *dev;
-    float hat_state[4];
+    uint32_t buttons;  // the pressed buttons, one bit per ControllerButton
+    uint32_t buttons_mask;  // the buttons delivered by the kernel
+    int32_t stick_values[STICK_AXIS_COUNT];
+    AxisCalibration calibration[STICK_AXIS_COUNT];
     bool grabbed;
     bool is_rumbling;
     int16_t rumble_effect_id;
-    uint64_t rumble_start;
+    int rumble_timer;
+    struct timeval event_time;  // timestamp of the last event processed
+    ControllerEventCallBack on_event;  // recorder of the events processed
+    void *on_event_data;
+    ControllerFrameCallBack on_frame;  // end of each frame of events
+    void *on_frame_data;
+
+    /**
+     * State of controller_read(), which may be called from another thread, on
+     * its own cache lines.
+     */
+    _Alignas(64) bool dropping;  // events are dropped until the next frame
+    struct input_event read_buffer[CONTROLLER_READ_BUFFER_SIZE];
 };
 
 /**
@@ -135,14 +287,18 @@ static bool controller_init_libevdev(const int fd, struct libevdev **dev) {
 static bool is_controller(struct libevdev *dev) {
     return (
         libevdev_has_event_type(dev, EV_ABS) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_X) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_Y) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_Z) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_RX) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_RY) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_RZ) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_HAT0X) &&
-        libevdev_has_event_code(dev, EV_ABS, ABS_HAT0Y) &&
+#define STICK_AXIS(stick_axis, axis_code) \
+        libevdev_has_event_code(dev, EV_ABS, axis_code) &&
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+#define TRIGGER(controller_button, axis_code) \
+        libevdev_has_event_code(dev, EV_ABS, axis_code) &&
+    CONTROLLER_TRIGGERS
+#undef TRIGGER
+#define HAT(button_positive, button_negative, axis_code) \
+        libevdev_has_event_code(dev, EV_ABS, axis_code) &&
+    CONTROLLER_HATS
+#undef HAT
         libevdev_has_event_type(dev, EV_FF) &&
         libevdev_has_event_code(dev, EV_FF, FF_RUMBLE) &&
         libevdev_has_event_type(dev, EV_KEY)
@@ -153,6 +309,128 @@ static bool is_controller(struct libevdev *dev) {
     );
 }
 
+/**
+ * Read a capability bitmap of an input device from sysfs, without opening the
+ * device.
+ *
+ * \param event_name The name of the device (example: event20).
+ * \param capability The name of the capability (example: abs).
+ * \param bits The bitmap to fill.
+ * \param longs_count The number of longs of the bitmap.
+ *
+ * \returns true on success, or false if the bitmap can't be read.
+ */
+static bool controller_read_sysfs_capability(const char *event_name,
+                                             const char *capability,
+                                             unsigned long *bits,
+                                             const size_t longs_count) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), SYSFS_INPUT_DIR "/%s/device/capabilities/%s",
+             event_name, capability);
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    char buffer[SYSFS_CAPABILITY_SIZE];
+    const bool success = fgets(buffer, sizeof(buffer), file) != NULL;
+    fclose(file);
+    if (!success) return false;
+
+    // The bitmap is written as hexadecimal longs separated by spaces, starting
+    // with the most significant long and without the leading zero longs.
+    memset(bits, 0, longs_count * sizeof(*bits));
+    size_t count = 0;
+    for (char *cursor = buffer; count < longs_count; ++count) {
+        char *end;
+        bits[count] = strtoul(cursor, &end, 16);
+        if (end == cursor) break;
+        cursor = end;
+    }
+    for (size_t i = 0; i < count / 2; ++i) {
+        const unsigned long tmp = bits[i];
+        bits[i] = bits[count - 1 - i];
+        bits[count - 1 - i] = tmp;
+    }
+
+    return true;
+}
+
+/**
+ * Check if a device may be a controller from the capabilities exposed in sysfs,
+ * which is much cheaper than opening it and initializing libevdev.
+ *
+ * \param event_name The name of the device (example: event20).
+ *
+ * \returns false if the device is not a controller, or true if it may be one
+ *          or its capabilities can't be read.
+ */
+static bool controller_sysfs_may_be_controller(const char *event_name) {
+    unsigned long abs_bits[BITS_TO_LONGS(ABS_CNT)];
+    unsigned long key_bits[BITS_TO_LONGS(KEY_CNT)];
+    unsigned long ff_bits[BITS_TO_LONGS(FF_CNT)];
+    if (
+        !controller_read_sysfs_capability(event_name, "abs", abs_bits,
+                                          BITS_TO_LONGS(ABS_CNT)) ||
+        !controller_read_sysfs_capability(event_name, "key", key_bits,
+                                          BITS_TO_LONGS(KEY_CNT)) ||
+        !controller_read_sysfs_capability(event_name, "ff", ff_bits,
+                                          BITS_TO_LONGS(FF_CNT))
+    ) {
+        return true;  // let libevdev decide
+    }
+
+    return (
+#define STICK_AXIS(stick_axis, axis_code) TEST_BIT(abs_bits, axis_code) &&
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+#define TRIGGER(controller_button, axis_code) TEST_BIT(abs_bits, axis_code) &&
+    CONTROLLER_TRIGGERS
+#undef TRIGGER
+#define HAT(button_positive, button_negative, axis_code) \
+    TEST_BIT(abs_bits, axis_code) &&
+    CONTROLLER_HATS
+#undef HAT
+#define BUTTON(controller_button, button_code) \
+    TEST_BIT(key_bits, button_code) &&
+    CONTROLLER_BUTTONS
+#undef BUTTON
+        TEST_BIT(ff_bits, FF_RUMBLE)
+    );
+}
+
+/**
+ * Keep the event devices when scanning the input directory.
+ * See scandir().
+ */
+static int controller_filter_event_device(const struct dirent *entry) {
+    return strncmp(entry->d_name, "event", 5) == 0;
+}
+
+bool controller_discover(const ControllerDeviceCallBack on_device,
+                         void *data) {
+    struct dirent **entries;
+    const int entries_count = scandir(INPUT_DIR, &entries,
+                                      controller_filter_event_device,
+                                      versionsort);
+    if (entries_count < 0) {
+        log_errorf("failed to scan " INPUT_DIR ": %s", strerror(errno));
+        return false;
+    }
+
+    bool success = true;
+    for (int i = 0; i < entries_count; ++i) {
+        if (success && controller_sysfs_may_be_controller(entries[i]->d_name)) {
+            char device_path[PATH_MAX];
+            snprintf(device_path, sizeof(device_path), INPUT_DIR "/%s",
+                     entries[i]->d_name);
+            success = on_device(device_path, data);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+
+    return success;
+}
+
 #ifndef PROD
 #define controller_dump_info(controller) _controller_dump_info(controller)
 /**
@@ -173,6 +451,172 @@ static void _controller_dump_info(const Controller *controller) {
 #define controller_dump_info(controller)
 #endif
 
+/**
+ * Stop the rumble effect.
+ *
+ * \param controller A pointer to the controller object to stop the rumble
+ *                   effect.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool controller_stop_rumble(Controller *controller) {
+    struct input_event stop;
+    stop.type = EV_FF;
+    stop.code = controller->rumble_effect_id;
+    stop.value = 0;
+
+    if (write(controller->fd, &stop, sizeof(stop)) < 0) {
+        log_errorf("failed to send rumble stop event: %s", strerror(errno));
+        return false;
+    }
+
+    controller->is_rumbling = false;
+
+    return true;
+}
+
+/**
+ * Stop the rumble effect once its duration is elapsed.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the controller object.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool controller_handle_rumble_timer(void *data) {
+    Controller *controller = data;
+    if (!controller->is_rumbling) return true;
+    return controller_stop_rumble(controller);
+}
+
+/**
+ * Calibrate a stick axis from its absinfo. The current value of the axis is
+ * used as its center unless it is too far from the middle of the range, in
+ * which case the stick is probably being pushed.
+ *
+ * \param dev The libevdev object of the controller.
+ * \param code The code of the axis.
+ * \param calibration A pointer to the AxisCalibration to initialize.
+ */
+static void controller_calibrate_axis(const struct libevdev *dev,
+                                      const unsigned int code,
+                                      AxisCalibration *calibration) {
+    const struct input_absinfo *absinfo = libevdev_get_abs_info(dev, code);
+    if (!absinfo || absinfo->maximum <= absinfo->minimum) {
+        *calibration = (AxisCalibration){0};
+        return;
+    }
+
+    const float half_range = (
+        ((float)absinfo->maximum - absinfo->minimum) / 2.0f
+    );
+    const int32_t middle = absinfo->minimum + (int32_t)half_range;
+    calibration->center = absinfo->value;
+    if (fabsf((float)absinfo->value - middle) >
+        CONTROLLER_CENTER_TOLERANCE * half_range) {
+        calibration->center = middle;
+    }
+    if (calibration->center <= absinfo->minimum ||
+        calibration->center >= absinfo->maximum) {
+        calibration->center = middle;
+    }
+
+    calibration->scale_negative = (
+        1.0f / ((float)calibration->center - absinfo->minimum)
+    );
+    calibration->scale_positive = (
+        1.0f / ((float)absinfo->maximum - calibration->center)
+    );
+    calibration->deadzone = fmaxf(
+        (absinfo->flat + absinfo->fuzz) / half_range,
+        CONTROLLER_STICK_DEADZONE
+    );
+}
+
+/**
+ * Calibrate the sticks of a controller, or reuse the calibration of the device
+ * if it was already connected.
+ *
+ * \param controller A pointer to the controller object.
+ */
+static void controller_calibrate(Controller *controller) {
+    const struct input_id id = {
+        .bustype = libevdev_get_id_bustype(controller->dev),
+        .vendor = libevdev_get_id_vendor(controller->dev),
+        .product = libevdev_get_id_product(controller->dev),
+        .version = libevdev_get_id_version(controller->dev),
+    };
+    const char *uniq = libevdev_get_uniq(controller->dev);
+    if (!uniq) uniq = "";
+
+    for (size_t i = 0; i < CONTROLLER_CALIBRATION_CACHE_SIZE; ++i) {
+        const CalibrationCacheEntry *entry = &calibration_cache[i];
+        if (entry->used && !memcmp(&entry->id, &id, sizeof(id)) &&
+            !strncmp(entry->uniq, uniq, sizeof(entry->uniq))) {
+            memcpy(controller->calibration, entry->axes,
+                   sizeof(controller->calibration));
+            log_debugf("reuse calibration of the controller");
+            return;
+        }
+    }
+
+#define STICK_AXIS(stick_axis, axis_code)                 \
+    controller_calibrate_axis(controller->dev, axis_code, \
+                              &controller->calibration[stick_axis]);
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+
+    // The deadzone is radial, so both axes of a stick share the largest one.
+    for (StickAxis x_axis = STICK_AXIS_LEFT_X; x_axis < STICK_AXIS_COUNT;
+         x_axis += 2) {
+        AxisCalibration *calibration = &controller->calibration[x_axis];
+        const float deadzone = fmaxf(calibration[0].deadzone,
+                                     calibration[1].deadzone);
+        calibration[0].deadzone = deadzone;
+        calibration[1].deadzone = deadzone;
+    }
+
+    CalibrationCacheEntry *entry = &calibration_cache[calibration_cache_next];
+    calibration_cache_next = (
+        (calibration_cache_next + 1) % CONTROLLER_CALIBRATION_CACHE_SIZE
+    );
+    entry->used = true;
+    entry->id = id;
+    strncpy(entry->uniq, uniq, sizeof(entry->uniq) - 1);
+    entry->uniq[sizeof(entry->uniq) - 1] = '\0';
+    memcpy(entry->axes, controller->calibration, sizeof(entry->axes));
+
+#define STICK_AXIS(stick_axis, axis_code)                           \
+    log_debugf("calibrate " #axis_code ": center=%d deadzone=%.3f", \
+               controller->calibration[stick_axis].center,          \
+               controller->calibration[stick_axis].deadzone);
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+}
+
+/**
+ * Initialize the state of the buttons and the sticks of a new controller, and
+ * calibrate its sticks.
+ *
+ * \param controller A pointer to the controller object.
+ */
+static void controller_init_state(Controller *controller) {
+    controller->buttons = 0;
+    controller->buttons_mask = UINT32_MAX;
+    controller->event_time = (struct timeval){0};
+    controller->on_event = NULL;
+    controller->on_event_data = NULL;
+    controller->on_frame = NULL;
+    controller->on_frame_data = NULL;
+    controller->dropping = false;
+#define STICK_AXIS(stick_axis, axis_code)                            \
+    controller->stick_values[stick_axis] = libevdev_get_event_value( \
+        controller->dev, EV_ABS, axis_code);
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+    controller_calibrate(controller);
+}
+
 /**
  * Initialize a controller from it's fd and libevdev object. The controller need
  * to closed with controller_destroy().
@@ -182,12 +626,17 @@ static void _controller_dump_info(const Controller *controller) {
  *
  * \param fd The file descriptor of the controller device.
  * \param dev A pointer to the libevdev object associated with the controller.
+ * \param device_path The path of the controller device.
  *
  * \returns a pointer to the controller or NULL on failure.
  */
 static Controller *controller_from_fd_and_dev(const int fd,
-                                              struct libevdev *dev) {
-    Controller *controller = malloc(sizeof(*controller));
+                                              struct libevdev *dev,
+                                              const char *device_path) {
+    // The state of controller_read() is aligned on cache lines, which malloc()
+    // doesn't guarantee.
+    Controller *controller = aligned_alloc(_Alignof(Controller),
+                                           sizeof(*controller));
     if (!controller) {
         log_errorf("failed to allocate memory: %s", strerror(errno));
         return NULL;
@@ -195,6 +644,22 @@ static Controller *controller_from_fd_and_dev(const int fd,
 
     controller->fd = fd;
     controller->dev = dev;
+    controller->is_rumbling = false;
+    controller->rumble_timer = -1;
+    controller->path = strdup(device_path);
+    if (!controller->path) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        controller_destroy(controller);
+        return NULL;
+    }
+    controller->rumble_timer = event_loop_add_timer(
+        controller_handle_rumble_timer,
+        controller
+    );
+    if (controller->rumble_timer < 0) {
+        controller_destroy(controller);
+        return NULL;
+    }
 
     struct ff_effect effect;
     memset(&effect, 0, sizeof(effect));
@@ -208,20 +673,25 @@ static Controller *controller_from_fd_and_dev(const int fd,
         controller_destroy(controller);
         return NULL;
     }
-    controller->is_rumbling = false;
     controller->rumble_effect_id = effect.id;
-    controller->rumble_start = 0;
     log_debugf("uploaded rumble effect");
 
-    const int err = libevdev_grab(controller->dev, LIBEVDEV_GRAB);
-    if (err < 0) {
-        log_errorf("failed to grab controller: %s", strerror(-err));
+    if (ioctl(controller->fd, EVIOCGRAB, 1) < 0) {
+        log_errorf("failed to grab controller: %s", strerror(errno));
         controller_destroy(controller);
         return NULL;
     }
     controller->grabbed = true;
     log_debugf("grab controller");
 
+    // The events are timestamped with the clock of get_time_ns() to measure
+    // their latency.
+    const int clock_id = CLOCK_MONOTONIC;
+    if (ioctl(controller->fd, EVIOCSCLOCKID, &clock_id) < 0) {
+        log_debugf("failed to set the clock of the events: %s",
+                   strerror(errno));
+    }
+
     controller_dump_info(controller);
 
     if (!controller_rumble(controller)) {
@@ -229,7 +699,7 @@ static Controller *controller_from_fd_and_dev(const int fd,
         return NULL;
     }
 
-    memset(controller->hat_state, false, sizeof(controller->hat_state));
+    controller_init_state(controller);
 
     return controller;
 }
@@ -257,79 +727,160 @@ Controller *controller_from_device_path(const char *device_path) {
 
     log_debugf("connect to controller %s", device_path);
 
-    return controller_from_fd_and_dev(fd, dev);
+    return controller_from_fd_and_dev(fd, dev, device_path);
 }
 
-Controller *controller_from_first(void) {
-    char *device_path = malloc(DEVICE_PATH_SIZE);
-    if (!device_path) {
+Controller *controller_from_info(const ControllerInfo *info,
+                                 const char *path) {
+    struct libevdev *dev = libevdev_new();
+    if (!dev) {
         log_errorf("failed to allocate memory: %s", strerror(errno));
         return NULL;
     }
-    Controller *controller = NULL;
-    for (uint32_t i = 0;; ++i) {
-        snprintf(device_path, DEVICE_PATH_SIZE, "/dev/input/event%d", i);
-        const int fd = open(device_path, O_RDWR | O_NONBLOCK);
-        if (fd < 0) {
-            if (errno == ENOENT) {  // no more device
-                log_errorf("no controller found");
-                break;
-            }
-            if (errno == EACCES) continue;  // we can't access this device
-
-            log_errorf("failed to open %s: %s", device_path,
-                       strerror(errno));
-            break;
-        }
-        struct libevdev *dev;
-        if (!controller_init_libevdev(fd, &dev)) {
-            close(fd);
-            break;
+    libevdev_set_name(dev, info->name);
+    libevdev_set_id_bustype(dev, info->id.bustype);
+    libevdev_set_id_vendor(dev, info->id.vendor);
+    libevdev_set_id_product(dev, info->id.product);
+    libevdev_set_id_version(dev, info->id.version);
+    for (unsigned int code = 0; code < ABS_CNT; ++code) {
+        if (!(info->axes & (UINT64_C(1) << code))) continue;
+        if (libevdev_enable_event_code(dev, EV_ABS, code,
+                                       &info->absinfo[code]) < 0) {
+            log_errorf("failed to enable axis %u", code);
+            libevdev_free(dev);
+            return NULL;
         }
+    }
+
+    Controller *controller = aligned_alloc(_Alignof(Controller),
+                                           sizeof(*controller));
+    if (!controller) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        libevdev_free(dev);
+        return NULL;
+    }
+
+    controller->fd = -1;
+    controller->dev = dev;
+    controller->is_rumbling = false;
+    controller->rumble_timer = -1;
+    controller->grabbed = true;
+    controller->path = strdup(path);
+    if (!controller->path) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        controller_destroy(controller);
+        return NULL;
+    }
 
-        if (is_controller(dev)) {
-            log_debugf("connect to controller %s", device_path);
-            controller = controller_from_fd_and_dev(fd, dev);
-            break;
+    log_debugf("controller without device from %s", path);
+    controller_dump_info(controller);
+    controller_init_state(controller);
+
+    return controller;
+}
+
+Controller *controller_probe(const char *device_path) {
+    const int fd = open(device_path, O_RDWR | O_NONBLOCK);
+    if (fd < 0) {
+        // The device is gone or we can't access it (yet).
+        if (errno != ENOENT && errno != EACCES && errno != EPERM) {
+            log_errorf("failed to open %s: %s", device_path, strerror(errno));
         }
+        return NULL;
+    }
+
+    struct libevdev *dev;
+    if (!controller_init_libevdev(fd, &dev)) {
+        close(fd);
+        return NULL;
+    }
 
+    if (!is_controller(dev)) {
         libevdev_free(dev);
         close(fd);
+        return NULL;
     }
-    free(device_path);
-    return controller;
+
+    log_debugf("connect to controller %s", device_path);
+
+    return controller_from_fd_and_dev(fd, dev, device_path);
+}
+
+/**
+ * The parameters of controller_from_all() passed to controller_found().
+ */
+typedef struct {
+    ControllerFoundCallBack on_controller;
+} ControllerSearch;
+
+/**
+ * Initialize a controller from a device found by controller_from_all().
+ * See ControllerDeviceCallBack.
+ *
+ * \param device_path The path of the device.
+ * \param data A pointer to the ControllerSearch.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool controller_found(const char *device_path, void *data) {
+    ControllerSearch *search = data;
+    Controller *controller = controller_probe(device_path);
+    if (!controller) return true;
+
+    return search->on_controller(controller);
+}
+
+bool controller_from_all(const ControllerFoundCallBack on_controller) {
+    ControllerSearch search = {.on_controller = on_controller};
+    return controller_discover(controller_found, &search);
 }
 
 void controller_destroy(Controller *controller) {
+    if (controller->rumble_timer >= 0) {
+        event_loop_remove_timer(controller->rumble_timer);
+    }
     libevdev_free(controller->dev);
-    close(controller->fd);
+    if (controller->fd >= 0) close(controller->fd);
+    free(controller->path);
     free(controller);
 }
 
-bool controller_list(void) {
-    for (uint32_t i = 0;; ++i) {
-        char device_path[DEVICE_PATH_SIZE];
-        snprintf(device_path, DEVICE_PATH_SIZE, "/dev/input/event%d", i);
-        const int fd = open(device_path, O_RDONLY | O_NONBLOCK);
-        if (fd < 0) {
-            if (errno == ENOENT) return true;  // no more device
-            if (errno == EACCES) continue;  // we can't access this device
-
-            log_errorf("failed to open %s: %s", device_path,
-                       strerror(errno));
-            return false;
-        }
-        struct libevdev *dev;
-        if (!controller_init_libevdev(fd, &dev)) {
-            close(fd);
-            return false;
-        }
-        if (is_controller(dev)) {
-            printf("%s: '%s'\n", device_path, libevdev_get_name(dev));
-        }
-        libevdev_free(dev);
+/**
+ * Print a device found by controller_list() if it is a controller.
+ * See ControllerDeviceCallBack.
+ *
+ * \param device_path The path of the device.
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool controller_list_device(const char *device_path, void *data) {
+    (void)data;
+
+    const int fd = open(device_path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        if (errno == ENOENT) return true;  // the device is gone
+        if (errno == EACCES) return true;  // we can't access this device
+
+        log_errorf("failed to open %s: %s", device_path, strerror(errno));
+        return false;
+    }
+    struct libevdev *dev;
+    if (!controller_init_libevdev(fd, &dev)) {
         close(fd);
+        return false;
+    }
+    if (is_controller(dev)) {
+        printf("%s: '%s'\n", device_path, libevdev_get_name(dev));
     }
+    libevdev_free(dev);
+    close(fd);
+
+    return true;
+}
+
+bool controller_list(void) {
+    return controller_discover(controller_list_device, NULL);
 }
 
 #ifndef PROD
@@ -352,7 +903,37 @@ bool controller_list(void) {
 #define log_event(event)
 #endif
 
-#define HAT_INDEX(hat_button) ((hat_button) - CONTROLLER_BUTTON_UP)
+/**
+ * Update the state of a button and triggers the appropriate callback if it
+ * changed.
+ *
+ * \param controller A pointer to the Controller object that is receiving the
+ *                   event.
+ * \param button The button to update.
+ * \param pressed Whether the button is pressed.
+ * \param on_button_down A callback function that is invoked when a button
+ *                       is pressed down.
+ * \param on_button_up A callback function that is invoked when a button
+ *                     is released.
+ * \param data The user data passed to the callbacks.
+ */
+static inline void controller_set_button(
+    Controller *controller,
+    const ControllerButton button,
+    const bool pressed,
+    const ControllerButtonEventCallBack on_button_down,
+    const ControllerButtonEventCallBack on_button_up,
+    void *data
+) {
+    if (pressed == !!(controller->buttons & BUTTON_BIT(button))) return;
+
+    controller->buttons ^= BUTTON_BIT(button);
+    if (pressed) {
+        on_button_down(button, data);
+    } else {
+        on_button_up(button, data);
+    }
+}
 
 /**
  * This function processes input events from a hat switch (D-pad), updates
@@ -371,6 +952,7 @@ bool controller_list(void) {
  *                       is pressed down.
  * \param on_button_up A callback function that is invoked when a button
  *                     is released.
+ * \param data The user data passed to the callbacks.
  */
 static void controller_handle_hat_event(
     Controller *controller,
@@ -378,256 +960,341 @@ static void controller_handle_hat_event(
     const ControllerButton button_positive,
     const ControllerButton button_negative,
     const ControllerButtonEventCallBack on_button_down,
-    const ControllerButtonEventCallBack on_button_up
+    const ControllerButtonEventCallBack on_button_up,
+    void *data
 ) {
-    if (event->value == 1) {
-        if (controller->hat_state[HAT_INDEX(button_negative)]) {
-            controller->hat_state[HAT_INDEX(button_negative)] = false;
-            on_button_up(button_negative);
-        }
-        if (!controller->hat_state[HAT_INDEX(button_positive)]) {
-            controller->hat_state[HAT_INDEX(button_positive)] = true;
-            on_button_down(button_positive);
-        }
-    } else if (event->value == 0) {
-        if (controller->hat_state[HAT_INDEX(button_negative)]) {
-            controller->hat_state[HAT_INDEX(button_negative)] = false;
-            on_button_up(button_negative);
-        }
-        if (controller->hat_state[HAT_INDEX(button_positive)]) {
-            controller->hat_state[HAT_INDEX(button_positive)] = false;
-            on_button_up(button_positive);
-        }
-    } else if (event->value == -1) {
-        if (!controller->hat_state[HAT_INDEX(button_negative)]) {
-            controller->hat_state[HAT_INDEX(button_negative)] = true;
-            on_button_down(button_negative);
-        }
-        if (controller->hat_state[HAT_INDEX(button_positive)]) {
-            controller->hat_state[HAT_INDEX(button_positive)] = false;
-            on_button_up(button_positive);
-        }
+    // The opposite direction is released before the new one is pressed.
+    if (event->value < 0) {
+        controller_set_button(controller, button_positive, false,
+                              on_button_down, on_button_up, data);
+        controller_set_button(controller, button_negative, true,
+                              on_button_down, on_button_up, data);
+    } else {
+        controller_set_button(controller, button_negative, false,
+                              on_button_down, on_button_up, data);
+        controller_set_button(controller, button_positive, event->value > 0,
+                              on_button_down, on_button_up, data);
     }
 }
 
-/**
- * Handles input events for the controller and triggers the appropriate button
- * callbacks.
- *
- * \param controller A pointer to the Controller object that is receiving the
- *                   event.
- * \param event A pointer to the input event structure containing the event
- *              data.
- * \param on_button_down A callback function that is invoked when a button
- *                       is pressed down.
- * \param on_button_up A callback function that is invoked when a button
- *                     is released.
- */
-static void controller_handle_event(
+void controller_process_event(
     Controller *controller,
     const struct input_event *event,
     const ControllerButtonEventCallBack on_button_down,
-    const ControllerButtonEventCallBack on_button_up
+    const ControllerButtonEventCallBack on_button_up,
+    void *data
 ) {
-    if (event->type == EV_KEY) {
-#define BUTTON(controller_button, button_code) \
-    if (event->code == button_code) {          \
-        if (event->value) {                    \
-            on_button_down(controller_button); \
-        } else {                               \
-            on_button_up(controller_button);   \
-        }                                      \
-        return;                                \
+    controller->event_time = event->time;
+    if (controller->on_event) {
+        controller->on_event(event, controller->on_event_data);
     }
 
-    CONTROLLER_BUTTONS
+    if (event->type == EV_KEY) {
+        if (event->code >= KEY_CNT) return;
+        const KeyDispatch *dispatch = &key_dispatch[event->code];
+        if (!dispatch->mapped) return;
 
-#undef BUTTON
+        controller_set_button(controller, dispatch->button, event->value != 0,
+                              on_button_down, on_button_up, data);
     } else if (event->type == EV_ABS) {
-        if (event->code == ABS_Z) {
-            if (!event->value) {
-                on_button_up(CONTROLLER_BUTTON_ZL);
-            } else {
-                on_button_down(CONTROLLER_BUTTON_ZL);
-            }
-            return;
-        }
-        if (event->code == ABS_RZ) {
-            if (!event->value) {
-                on_button_up(CONTROLLER_BUTTON_ZR);
-            } else {
-                on_button_down(CONTROLLER_BUTTON_ZR);
-            }
-            return;
-        }
-
-        if (event->code == ABS_HAT0Y) {
+        if (event->code >= ABS_CNT) return;
+        const AxisDispatch *dispatch = &axis_dispatch[event->code];
+
+        if (dispatch->kind == AXIS_STICK) {
+            controller->stick_values[dispatch->stick_axis] = event->value;
+        } else if (dispatch->kind == AXIS_TRIGGER) {
+            controller_set_button(controller, dispatch->button_positive,
+                                  event->value != 0, on_button_down,
+                                  on_button_up, data);
+        } else if (dispatch->kind == AXIS_HAT) {
             controller_handle_hat_event(
                 controller,
                 event,
-                CONTROLLER_BUTTON_DOWN,
-                CONTROLLER_BUTTON_UP,
+                dispatch->button_positive,
+                dispatch->button_negative,
                 on_button_down,
-                on_button_up
+                on_button_up,
+                data
             );
-            return;
         }
-        if (event->code == ABS_HAT0X) {
-            controller_handle_hat_event(
-                controller,
-                event,
-                CONTROLLER_BUTTON_RIGHT,
-                CONTROLLER_BUTTON_LEFT,
-                on_button_down,
-                on_button_up
-            );
-            return;
+    } else if (event->type == EV_SYN && event->code == SYN_REPORT) {
+        if (controller->on_frame) {
+            controller->on_frame(controller->on_frame_data);
         }
     }
 }
 
+/**
+ * Report an event with the current state of the controller as if it was read
+ * from the device.
+ *
+ * \param time The timestamp of the event.
+ * \param type The type of the event.
+ * \param code The code of the event.
+ * \param value The value of the event.
+ * \param on_event A callback function that is invoked with the event.
+ * \param data The user data passed to the callback.
+ */
+static void controller_report_state(
+    const struct timeval time,
+    const uint16_t type,
+    const uint16_t code,
+    const int32_t value,
+    const ControllerEventCallBack on_event,
+    void *data
+) {
+    const struct input_event event = {
+        .time = time,
+        .type = type,
+        .code = code,
+        .value = value,
+    };
+    on_event(&event, data);
+}
+
 /**
  * Handles synchronization of dropped events after an input event overflow.
  *
+ * The state of all the keys is fetched with a single EVIOCGKEY and the state
+ * of the axes with EVIOCGABS, then the state of every button and stick is
+ * reported as a frame of events. Since controller_process_event() only
+ * triggers the callbacks of the buttons whose state differs from the last
+ * known state of the controller, only the buttons released or pressed while
+ * the events were dropped trigger a callback.
+ *
  * \param controller A pointer to the Controller object that is receiving the
  *                   event.
- * \param on_button_down A callback function that is invoked when a button
- *                       is pressed down.
- * \param on_button_up A callback function that is invoked when a button
- *                     is released.
+ * \param time The timestamp of the frame that ended the overflow.
+ * \param on_event A callback function that is invoked for each event of the
+ *                 synchronization.
+ * \param data The user data passed to the callback.
  *
  * \returns true on success, or false on failure.
  */
 static bool controller_handle_syn_dropped(
     Controller *controller,
-    const ControllerButtonEventCallBack on_button_down,
-    const ControllerButtonEventCallBack on_button_up
+    const struct timeval time,
+    const ControllerEventCallBack on_event,
+    void *data
 ) {
-    struct input_event event;
-    int return_code = LIBEVDEV_READ_STATUS_SYNC;
-    while (return_code == LIBEVDEV_READ_STATUS_SYNC) {
-        return_code = libevdev_next_event(controller->dev,
-                                          LIBEVDEV_READ_FLAG_SYNC,
-                                          &event);
-        if (return_code < 0) {
-            if (return_code != -EAGAIN) {
-                log_errorf("failed to get next event: %s",
-                           strerror(-return_code));
-                return false;
-            }
-        }
-
-        log_event(event)
-        controller_handle_event(controller, &event, on_button_down,
-                                on_button_up);
+    // The pending events are older than the state fetched below, so they are
+    // discarded to not undo it.
+    for (;;) {
+        const ssize_t size = read(controller->fd, controller->read_buffer,
+                                  sizeof(controller->read_buffer));
+        if (size > 0) continue;
+        if (size == 0 || errno == EAGAIN) break;
+        if (errno == EINTR) continue;
+        log_errorf("failed to read controller: %s", strerror(errno));
+        return false;
     }
 
-    return true;
-}
-
-/**
- * Stop the rumble effect.
- *
- * \param controller A pointer to the controller object to stop the rumble
- *                   effect.
- *
- * \returns true on success, or false on failure.
- */
-static bool controller_stop_rumble(Controller *controller) {
-    struct input_event stop;
-    stop.type = EV_FF;
-    stop.code = controller->rumble_effect_id;
-    stop.value = 0;
-
-    if (write(controller->fd, &stop, sizeof(stop)) < 0) {
-        log_errorf("failed to send rumble stop event: %s", strerror(errno));
+    unsigned long keys[BITS_TO_LONGS(KEY_CNT)];
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(controller->fd, EVIOCGKEY(sizeof(keys)), keys) < 0) {
+        log_errorf("failed to get keys state: %s", strerror(errno));
         return false;
     }
+#define BUTTON(controller_button, button_code)         \
+    controller_report_state(time, EV_KEY, button_code, \
+                            TEST_BIT(keys, button_code), on_event, data);
+    CONTROLLER_BUTTONS
+#undef BUTTON
 
-    controller->is_rumbling = false;
+    struct input_absinfo absinfo;
+#define AXIS(axis_code)                                              \
+    if (ioctl(controller->fd, EVIOCGABS(axis_code), &absinfo) < 0) { \
+        log_errorf("failed to get axis state: %s", strerror(errno)); \
+        return false;                                                \
+    }                                                                \
+    controller_report_state(time, EV_ABS, axis_code, absinfo.value,  \
+                            on_event, data);
+#define STICK_AXIS(stick_axis, axis_code) AXIS(axis_code)
+    CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+#define TRIGGER(controller_button, axis_code) AXIS(axis_code)
+    CONTROLLER_TRIGGERS
+#undef TRIGGER
+#define HAT(button_positive, button_negative, axis_code) AXIS(axis_code)
+    CONTROLLER_HATS
+#undef HAT
+#undef AXIS
+    controller_report_state(time, EV_SYN, SYN_REPORT, 0, on_event, data);
+
+    log_debugf("controller synchronized after dropped events");
 
     return true;
 }
 
-bool controller_update(Controller *controller,
-                       const ControllerButtonEventCallBack on_button_down,
-                       const ControllerButtonEventCallBack on_button_up) {
-    if (controller->is_rumbling &&
-        get_time_ms() - controller->rumble_start > CONTROLLER_RUMBLE_DURATION) {
-        if (!controller_stop_rumble(controller)) return false;
-    }
-
-    struct input_event event;
-    int return_code = LIBEVDEV_READ_STATUS_SUCCESS;
+bool controller_read(Controller *controller,
+                     const ControllerEventCallBack on_event, void *data) {
+    for (;;) {
+        // The events are read in batches to save a system call per event. The
+        // kernel only returns whole events.
+        const ssize_t size = read(controller->fd, controller->read_buffer,
+                                  sizeof(controller->read_buffer));
+        if (size < 0) {
+            if (errno == EAGAIN) return true;
+            if (errno == EINTR) continue;
+            log_errorf("failed to read controller: %s", strerror(errno));
+            return false;
+        }
 
-    while (return_code != -EAGAIN) {
-        return_code = libevdev_next_event(controller->dev,
-                                          LIBEVDEV_READ_FLAG_NORMAL,
-                                          &event);
-        if (return_code < 0) {
-            if (return_code != -EAGAIN) {
-                log_errorf("failed to get next event: %s",
-                           strerror(-return_code));
-                return false;
+        const size_t count = size / sizeof(*controller->read_buffer);
+        for (size_t i = 0; i < count; ++i) {
+            const struct input_event *event = &controller->read_buffer[i];
+            log_event((*event))
+
+            if (event->type == EV_SYN && event->code == SYN_DROPPED) {
+                controller->dropping = true;
+            } else if (!controller->dropping) {
+                on_event(event, data);
+            } else if (event->type == EV_SYN && event->code == SYN_REPORT) {
+                // The rest of the batch is older than the state fetched by
+                // the synchronization, so it is dropped as well.
+                controller->dropping = false;
+                return controller_handle_syn_dropped(controller, event->time,
+                                                     on_event, data);
             }
-        } else if (return_code == LIBEVDEV_READ_STATUS_SYNC) {
-            log_event(event)
-            if (!controller_handle_syn_dropped(
-                controller,
-                on_button_down,
-                on_button_up
-            )) return false;
-        } else if (return_code == LIBEVDEV_READ_STATUS_SUCCESS) {
-            log_event(event)
-            controller_handle_event(controller, &event, on_button_down,
-                                    on_button_up);
         }
+
+        // A partial batch means that there is no more pending events.
+        if (count < CONTROLLER_READ_BUFFER_SIZE) return true;
     }
+}
 
-    return true;
+bool controller_resync(Controller *controller,
+                       const ControllerEventCallBack on_event, void *data) {
+    // The device timestamps its events with the monotonic clock.
+    const uint64_t now = get_time_ns();
+    const struct timeval time = {
+        .tv_sec = now / NS_PER_S,
+        .tv_usec = now % NS_PER_S / NS_PER_US,
+    };
+
+    controller->dropping = false;
+    return controller_handle_syn_dropped(controller, time, on_event, data);
 }
 
-void controller_get_stick(const Controller *controller,
-                          const ControllerStick stick, float *x, float *y) {
-    int x_axis, y_axis;
+/**
+ * The parameters of controller_update() passed to controller_update_event().
+ */
+typedef struct {
+    Controller *controller;
+    ControllerButtonEventCallBack on_button_down;
+    ControllerButtonEventCallBack on_button_up;
+    void *data;
+} ControllerUpdate;
+
+/**
+ * Process an event read by controller_update().
+ * See ControllerEventCallBack.
+ *
+ * \param event The event read from the controller.
+ * \param data A pointer to the ControllerUpdate.
+ */
+static void controller_update_event(const struct input_event *event,
+                                    void *data) {
+    const ControllerUpdate *update = data;
+    controller_process_event(update->controller, event, update->on_button_down,
+                             update->on_button_up, update->data);
+}
+
+bool controller_update(Controller *controller,
+                       const ControllerButtonEventCallBack on_button_down,
+                       const ControllerButtonEventCallBack on_button_up,
+                       void *data) {
+    ControllerUpdate update = {
+        .controller = controller,
+        .on_button_down = on_button_down,
+        .on_button_up = on_button_up,
+        .data = data,
+    };
+    return controller_read(controller, controller_update_event, &update);
+}
+
+/**
+ * Get the axes of a stick.
+ *
+ * \param stick The stick.
+ * \param x_axis A pointer to the StickAxis where the X axis will be stored.
+ * \param y_axis A pointer to the StickAxis where the Y axis will be stored.
+ */
+static inline void controller_stick_axes(const ControllerStick stick,
+                                         StickAxis *x_axis,
+                                         StickAxis *y_axis) {
     if (stick == CONTROLLER_STICK_LEFT) {
-        x_axis = ABS_X;
-        y_axis = ABS_Y;
-    } else if (stick == CONTROLLER_STICK_RIGHT) {
-        x_axis = ABS_RX;
-        y_axis = ABS_RY;
+        *x_axis = STICK_AXIS_LEFT_X;
+        *y_axis = STICK_AXIS_LEFT_Y;
     } else {
-        assert(false && "unreachable");
-        return;
+        assert(stick == CONTROLLER_STICK_RIGHT && "unreachable");
+        *x_axis = STICK_AXIS_RIGHT_X;
+        *y_axis = STICK_AXIS_RIGHT_Y;
     }
+}
 
-    const int x_value = libevdev_get_event_value(controller->dev, EV_ABS,
-                                                 x_axis);
-    const int y_value = libevdev_get_event_value(controller->dev, EV_ABS,
-                                                     y_axis);
+/**
+ * Normalize a raw axis value with its calibration.
+ *
+ * \param calibration The calibration of the axis.
+ * \param value The raw axis value.
+ *
+ * \returns the position of the axis, between -1.0 and 1.0 within the range
+ *          reported by the device.
+ */
+static inline float controller_normalize_axis(
+    const AxisCalibration *calibration,
+    const int32_t value
+) {
+    const float offset = (float)value - calibration->center;
+    return offset * (offset < 0.0f ? calibration->scale_negative
+                                   : calibration->scale_positive);
+}
 
-    *x = 2.0f * (float)(x_value + CONTROLLER_AXIS_MAX) /
-        (CONTROLLER_AXIS_MAX - CONTROLLER_AXIS_MIN) - 1.0f;
-    *y = 2.0f * (float)(y_value + CONTROLLER_AXIS_MAX) /
-        (CONTROLLER_AXIS_MAX - CONTROLLER_AXIS_MIN) - 1.0f;
+void controller_get_stick_values(const Controller *controller,
+                                 const ControllerStick stick, int16_t *x,
+                                 int16_t *y) {
+    StickAxis x_axis, y_axis;
+    controller_stick_axes(stick, &x_axis, &y_axis);
 
-    if (fabsf(*x) < CONTROLLER_AXIS_ROUND) {
-        *x = 0.0f;
-    } else if (*x > 1.0f - CONTROLLER_AXIS_ROUND) {
-        *x = 1.0f;
-    } else if (*x < -1.0f + CONTROLLER_AXIS_ROUND) {
-        *x = -1.0f;
-    }
-    if (fabsf(*y) < CONTROLLER_AXIS_ROUND) {
-        *y = 0.0f;
-    } else if (*y > 1.0f - CONTROLLER_AXIS_ROUND) {
-        *y = 1.0f;
-    } else if (*y < -1.0f + CONTROLLER_AXIS_ROUND) {
-        *y = -1.0f;
+    const float x_position = controller_normalize_axis(
+        &controller->calibration[x_axis],
+        controller->stick_values[x_axis]
+    );
+    const float y_position = controller_normalize_axis(
+        &controller->calibration[y_axis],
+        controller->stick_values[y_axis]
+    );
+
+    // Radial deadzone, the remaining range is rescaled so the position grows
+    // from 0.0 at the edge of the deadzone.
+    const float magnitude = sqrtf(
+        x_position * x_position + y_position * y_position
+    );
+    const float deadzone = controller->calibration[x_axis].deadzone;
+    if (magnitude <= deadzone) {
+        *x = 0;
+        *y = 0;
+        return;
     }
+    const float scale = (
+        (fminf(magnitude, 1.0f) - deadzone) / (1.0f - deadzone) / magnitude
+    );
+    *x = lrintf(x_position * scale * INT16_MAX);
+    *y = lrintf(y_position * scale * INT16_MAX);
+}
+
+void controller_get_stick(const Controller *controller,
+                          const ControllerStick stick, float *x, float *y) {
+    int16_t x_value, y_value;
+    controller_get_stick_values(controller, stick, &x_value, &y_value);
+    *x = (float)x_value / INT16_MAX;
+    *y = (float)y_value / INT16_MAX;
 }
 
 bool controller_rumble(Controller *controller) {
+    // A controller without device has nothing to rumble.
+    if (controller->fd < 0) return true;
     log_debugf("controller rumble");
 
     if (controller->is_rumbling) {
@@ -645,22 +1312,73 @@ bool controller_rumble(Controller *controller) {
     }
 
     controller->is_rumbling = true;
-    controller->rumble_start = get_time_ms();
+    if (!event_loop_set_timer(controller->rumble_timer,
+                              CONTROLLER_RUMBLE_DURATION * NS_PER_MS, 0)) {
+        return false;
+    }
 
     return true;
 }
 
+int controller_get_fd(const Controller *controller) {
+    return controller->fd;
+}
+
+const char *controller_get_path(const Controller *controller) {
+    return controller->path;
+}
+
+uint64_t controller_get_event_time(const Controller *controller) {
+    return controller->event_time.tv_sec * NS_PER_S +
+        controller->event_time.tv_usec * NS_PER_US;
+}
+
+void controller_get_info(const Controller *controller, ControllerInfo *info) {
+    _Static_assert(ABS_CNT <= 64, "the axes don't fit in ControllerInfo");
+
+    memset(info, 0, sizeof(*info));
+    const char *name = libevdev_get_name(controller->dev);
+    snprintf(info->name, sizeof(info->name), "%s", name ? name : "");
+    info->id.bustype = libevdev_get_id_bustype(controller->dev);
+    info->id.vendor = libevdev_get_id_vendor(controller->dev);
+    info->id.product = libevdev_get_id_product(controller->dev);
+    info->id.version = libevdev_get_id_version(controller->dev);
+    for (unsigned int code = 0; code < ABS_CNT; ++code) {
+        const struct input_absinfo *absinfo = libevdev_get_abs_info(
+            controller->dev,
+            code
+        );
+        if (!absinfo) continue;
+        info->axes |= UINT64_C(1) << code;
+        info->absinfo[code] = *absinfo;
+    }
+}
+
+void controller_set_recorder(Controller *controller,
+                             const ControllerEventCallBack on_event,
+                             void *data) {
+    controller->on_event = on_event;
+    controller->on_event_data = data;
+}
+
+void controller_set_frame_handler(Controller *controller,
+                                  const ControllerFrameCallBack on_frame,
+                                  void *data) {
+    controller->on_frame = on_frame;
+    controller->on_frame_data = data;
+}
+
 bool controller_get_grabbed(const Controller *controller) {
     return controller->grabbed;
 }
 
 bool controller_toggle_grabbed(Controller *controller) {
-    const int err = libevdev_grab(
-        controller->dev,
-        controller->grabbed ? LIBEVDEV_UNGRAB : LIBEVDEV_GRAB
-    );
-    if (err < 0) {
-        log_errorf("failed to grab/ungrab controller: %s", strerror(-err));
+    // The ioctl is used instead of libevdev_grab() since the reader thread of
+    // --threaded uses the same fd: the events are read with read() and
+    // resynced with EVIOCGKEY and EVIOCGABS, without the state of libevdev.
+    if (controller->fd >= 0 &&
+        ioctl(controller->fd, EVIOCGRAB, controller->grabbed ? 0 : 1) < 0) {
+        log_errorf("failed to grab/ungrab controller: %s", strerror(errno));
         return false;
     }
 
@@ -676,3 +1394,112 @@ bool controller_toggle_grabbed(Controller *controller) {
 
     return true;
 }
+
+/**
+ * Install the event mask of a type on a controller.
+ *
+ * \param controller A pointer to the controller object.
+ * \param type The type of the events to filter, or EV_SYN to filter the types.
+ * \param codes The bitmap of the codes to deliver.
+ * \param codes_size The size of the bitmap in bytes.
+ *
+ * \returns 0 on success, or an errno value on failure.
+ */
+static int controller_set_type_mask(Controller *controller,
+                                    const unsigned int type,
+                                    const unsigned long *codes,
+                                    const size_t codes_size) {
+    const struct input_mask mask = {
+        .type = type,
+        .codes_size = codes_size,
+        .codes_ptr = (uintptr_t)codes,
+    };
+    if (ioctl(controller->fd, EVIOCSMASK, &mask) < 0) return errno;
+
+    return 0;
+}
+
+bool controller_set_event_mask(Controller *controller,
+                               const bool buttons[CONTROLLER_BUTTON_COUNT],
+                               const bool sticks) {
+    // The events of a controller without device aren't filtered.
+    if (controller->fd < 0) return true;
+
+    unsigned long types[BITS_TO_LONGS(EV_CNT)] = {0};
+    unsigned long keys[BITS_TO_LONGS(KEY_CNT)] = {0};
+    unsigned long axes[BITS_TO_LONGS(ABS_CNT)] = {0};
+
+    uint32_t buttons_mask = 0;
+
+    SET_BIT(types, EV_KEY);
+    SET_BIT(types, EV_ABS);
+#define BUTTON(controller_button, button_code)         \
+    if (buttons[controller_button]) {                  \
+        SET_BIT(keys, button_code);                    \
+        buttons_mask |= BUTTON_BIT(controller_button); \
+    }
+    CONTROLLER_BUTTONS
+#undef BUTTON
+#define TRIGGER(controller_button, axis_code)          \
+    if (buttons[controller_button]) {                  \
+        SET_BIT(axes, axis_code);                      \
+        buttons_mask |= BUTTON_BIT(controller_button); \
+    }
+    CONTROLLER_TRIGGERS
+#undef TRIGGER
+#define HAT(button_positive, button_negative, axis_code)        \
+    if (buttons[button_positive] || buttons[button_negative]) { \
+        SET_BIT(axes, axis_code);                               \
+        buttons_mask |= BUTTON_BIT(button_positive) |           \
+            BUTTON_BIT(button_negative);                        \
+    }
+    CONTROLLER_HATS
+#undef HAT
+    if (sticks) {
+#define STICK_AXIS(stick_axis, axis_code) SET_BIT(axes, axis_code);
+        CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+    }
+
+    // The mask of EV_SYN filters the event types, while the EV_SYN events
+    // themselves are always delivered.
+    int err = controller_set_type_mask(controller, EV_KEY, keys, sizeof(keys));
+    if (!err) {
+        err = controller_set_type_mask(controller, EV_ABS, axes, sizeof(axes));
+    }
+    if (!err) {
+        err = controller_set_type_mask(controller, EV_SYN, types,
+                                       sizeof(types));
+    }
+    if (err == ENOTTY || err == EINVAL) {
+        log_debugf("event masks aren't supported by the kernel");
+        return true;
+    }
+    if (err) {
+        log_errorf("failed to set event mask: %s", strerror(err));
+        return false;
+    }
+
+    // The state of the buttons that were not delivered is unknown, so they are
+    // considered released until their next event.
+    controller->buttons &= controller->buttons_mask & buttons_mask;
+    controller->buttons_mask = buttons_mask;
+
+    // The events of the sticks may have been filtered until now, so their
+    // position is stale.
+    if (sticks) {
+        struct input_absinfo absinfo;
+#define STICK_AXIS(stick_axis, axis_code)                                \
+        if (ioctl(controller->fd, EVIOCGABS(axis_code), &absinfo) < 0) { \
+            log_errorf("failed to get axis state: %s", strerror(errno)); \
+            return false;                                                \
+        }                                                                \
+        controller->stick_values[stick_axis] = absinfo.value;
+        CONTROLLER_STICK_AXES
+#undef STICK_AXIS
+    }
+
+    log_debugf("event mask updated");
+
+    return true;
+}
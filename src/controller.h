@@ -6,6 +6,11 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#include <linux/input.h>
+
+#define CONTROLLER_NAME_SIZE 128
 
 /**
  * Represents a controller device.
@@ -38,6 +43,9 @@ typedef enum {
     // Trigger buttns
     CONTROLLER_BUTTON_ZL    = 15,
     CONTROLLER_BUTTON_ZR    = 16,
+
+    // Number of buttons
+    CONTROLLER_BUTTON_COUNT = 17,
 } ControllerButton;
 
 /**
@@ -49,14 +57,40 @@ typedef enum {
 } ControllerStick;
 
 /**
- * Callback function called when the state of a button changes.
+ * Callback function called when the state of a button changes with the user
+ * data given with the callback.
+ */
+typedef void (*ControllerButtonEventCallBack)(const ControllerButton, void *);
+
+/**
+ * Callback function called for each event read from a controller.
  */
-typedef void (*ControllerButtonEventCallBack)(const ControllerButton);
+typedef void (*ControllerEventCallBack)(const struct input_event *, void *);
+
+/**
+ * Callback function called at the end of each frame of events processed, with
+ * the user data given with the callback.
+ */
+typedef void (*ControllerFrameCallBack)(void *);
+
+/**
+ * Description of a controller device, enough to process its events without
+ * the device.
+ */
+typedef struct {
+    char name[CONTROLLER_NAME_SIZE];
+    struct input_id id;
+    uint64_t axes;  // bitmap of the EV_ABS codes of the device
+    struct input_absinfo absinfo[ABS_CNT];
+} ControllerInfo;
 
 /**
  * Initialize a controller from a device path. The controller need to closed
  * with controller_destroy().
  *
+ * The event loop must be initialized since it is used to stop the rumble
+ * effects.
+ *
  * \param device_path The path to the device path (example: /dev/input/event20).
  *
  * \returns a pointer to the controller or NULL on failure.
@@ -64,17 +98,86 @@ typedef void (*ControllerButtonEventCallBack)(const ControllerButton);
 Controller *controller_from_device_path(const char *device_path);
 
 /**
- * Initialize a controller from the first device that match the requirement. The
+ * Initialize a controller from a device path if the device is a controller.
+ * Unlike controller_from_device_path(), no error is logged when the device
+ * isn't a controller or can't be accessed. The controller need to closed with
+ * controller_destroy().
+ *
+ * The event loop must be initialized since it is used to stop the rumble
+ * effects.
+ *
+ * \param device_path The path to the device path (example: /dev/input/event20).
+ *
+ * \returns a pointer to the controller or NULL if the device isn't an
+ *          accessible controller or on failure.
+ */
+Controller *controller_probe(const char *device_path);
+
+/**
+ * Initialize a controller without device from the description of a device, to
+ * process events recorded from it with controller_process_event(). The
  * controller need to closed with controller_destroy().
  *
- * \returns a pointer to the controller or NULL if no controller is found or on
+ * The controller has no file descriptor and doesn't rumble. Its grab state
+ * isn't applied to any device, and its event mask is ignored.
+ *
+ * \param info The description of the device.
+ * \param path The path used in place of the path of the device.
+ *
+ * \returns a pointer to the controller or NULL on failure.
+ */
+Controller *controller_from_info(const ControllerInfo *info, const char *path);
+
+/**
+ * Callback function called with the path of a device found by
+ * controller_discover() and the user data given with the callback.
+ *
+ * \returns true on success, or false on failure which stops the discovery.
+ */
+typedef bool (*ControllerDeviceCallBack)(const char *, void *);
+
+/**
+ * Find the devices that may be controllers without opening them.
+ *
+ * The capabilities of the devices are read from sysfs to skip the devices that
+ * can't be a controller, so the devices found still need to be checked by
+ * opening them, for example with controller_probe(). When the capabilities of
+ * a device aren't available, the device is reported.
+ *
+ * \param on_device A callback function that is invoked with the path of each
+ *                  device found, in the order of their number.
+ * \param data The user data passed to the callback.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool controller_discover(const ControllerDeviceCallBack on_device, void *data);
+
+/**
+ * Callback function called with a controller found by controller_from_all().
+ * The callback owns the controller and need to destroy it with
+ * controller_destroy().
+ *
+ * \returns true on success, or false on failure which stops the search.
+ */
+typedef bool (*ControllerFoundCallBack)(Controller *);
+
+/**
+ * Initialize a controller from every device that match the requirement.
+ *
+ * The event loop must be initialized since it is used to stop the rumble
+ * effects.
+ *
+ * \param on_controller A callback function that is invoked with each
+ *                      controller found.
+ *
+ * \returns true on success, even if no controller is found, or false on
  *          failure.
  */
-Controller *controller_from_first(void);
+bool controller_from_all(const ControllerFoundCallBack on_controller);
 
 /**
- * Destroy a controller created by controller_from_device_path() and
- * controller_from_first().
+ * Destroy a controller created by controller_from_device_path(),
+ * controller_probe(), controller_from_info() or controller_from_all().
  *
  * \param controller The pointer of the controller object to destroy.
  */
@@ -87,21 +190,139 @@ void controller_destroy(Controller *controller);
  */
 bool controller_list(void);
 
+/**
+ * Get the file descriptor of the controller device. The file descriptor is
+ * non-blocking and becomes readable when controller_update() has events to
+ * handle.
+ *
+ * \param controller A pointer to the controller object.
+ *
+ * \returns the file descriptor of the controller, or -1 if the controller was
+ *          created by controller_from_info().
+ */
+int controller_get_fd(const Controller *controller);
+
+/**
+ * Get the path of the controller device.
+ *
+ * \param controller A pointer to the controller object.
+ *
+ * \returns the path of the controller device (example: /dev/input/event20).
+ */
+const char *controller_get_path(const Controller *controller);
+
+/**
+ * Get the description of the controller device, to create a controller
+ * processing the same events with controller_from_info().
+ *
+ * \param controller A pointer to the controller object.
+ * \param info A pointer where the description will be stored.
+ */
+void controller_get_info(const Controller *controller, ControllerInfo *info);
+
+/**
+ * Set a callback function invoked with each event before it is processed by
+ * controller_process_event(), for example to record the events.
+ *
+ * \param controller A pointer to the controller object.
+ * \param on_event The callback function, or NULL to remove it.
+ * \param data The user data passed to the callback.
+ */
+void controller_set_recorder(Controller *controller,
+                             const ControllerEventCallBack on_event,
+                             void *data);
+
+/**
+ * Set a callback function invoked by controller_process_event() after the
+ * SYN_REPORT ending each frame of events, once the buttons of the frame were
+ * handled.
+ *
+ * \param controller A pointer to the controller object.
+ * \param on_frame The callback function, or NULL to remove it.
+ * \param data The user data passed to the callback.
+ */
+void controller_set_frame_handler(Controller *controller,
+                                  const ControllerFrameCallBack on_frame,
+                                  void *data);
+
 /**
  * Update the state of a controller and triggers the appropriate callback when
  * the state of any buttons changes.
  *
+ * All the pending events are handled, so this function should be called when
+ * the file descriptor returned by controller_get_fd() becomes readable.
+ *
  * \param controller The pointer to the controller object to update.
  * \param on_button_down A callback function that is invoked when a button
  *                       is pressed down.
  * \param on_button_up A callback function that is invoked when a button
  *                     is released.
+ * \param data The user data passed to the callbacks.
  *
  * \returns true on success, false on failure.
  */
 bool controller_update(Controller *controller,
                        const ControllerButtonEventCallBack on_button_down,
-                       const ControllerButtonEventCallBack on_button_up);
+                       const ControllerButtonEventCallBack on_button_up,
+                       void *data);
+
+/**
+ * Read the pending events of a controller without processing them.
+ *
+ * The events are read in batches with read(). When the kernel dropped events,
+ * the events are replaced by the current state of the buttons and the sticks.
+ *
+ * The read buffer of the controller is only used by this function, so it can
+ * be called from an input thread while the events are processed by
+ * controller_process_event() in another thread.
+ *
+ * \param controller The pointer to the controller object to read.
+ * \param on_event A callback function that is invoked for each event read.
+ * \param data The user data passed to the callback.
+ *
+ * \returns true on success, false on failure.
+ */
+bool controller_read(Controller *controller,
+                     const ControllerEventCallBack on_event, void *data);
+
+/**
+ * Read the current state of the buttons and the sticks of a controller, and
+ * report it as a frame of events like when the kernel dropped events. The
+ * pending events are discarded since they are older than that state.
+ *
+ * Like controller_read(), it can be called from an input thread, for example
+ * after events were dropped between the input thread and the event loop.
+ *
+ * \param controller The pointer to the controller object to read.
+ * \param on_event A callback function that is invoked for each event of the
+ *                 state.
+ * \param data The user data passed to the callback.
+ *
+ * \returns true on success, false on failure.
+ */
+bool controller_resync(Controller *controller,
+                       const ControllerEventCallBack on_event, void *data);
+
+/**
+ * Update the state of a controller with an event read by controller_read() and
+ * triggers the appropriate callback when the state of any buttons changes. An
+ * event that doesn't change the state of a button triggers no callback.
+ *
+ * \param controller The pointer to the controller object to update.
+ * \param event The event to process.
+ * \param on_button_down A callback function that is invoked when a button
+ *                       is pressed down.
+ * \param on_button_up A callback function that is invoked when a button
+ *                     is released.
+ * \param data The user data passed to the callbacks.
+ */
+void controller_process_event(
+    Controller *controller,
+    const struct input_event *event,
+    const ControllerButtonEventCallBack on_button_down,
+    const ControllerButtonEventCallBack on_button_up,
+    void *data
+);
 
 /**
  * Retrieves the current position of the specified analog stick (left or right)
@@ -109,7 +330,8 @@ bool controller_update(Controller *controller,
  *
  * The function normalizes the raw axis values of the stick to a floating-point
  * range between -1.0 and 1.0, where -1.0 represents the minimum position, 1.0
- * represents the maximum position, and 0.0 represents the center.
+ * represents the maximum position, and 0.0 represents the center. See
+ * controller_get_stick_values() for the calibration.
  *
  * \param controller A pointer to the controller object from which to retrieve
  *                   the stick position.
@@ -123,6 +345,24 @@ bool controller_update(Controller *controller,
 void controller_get_stick(const Controller *controller,
                           const ControllerStick stick, float *x, float *y);
 
+/**
+ * Retrieves the position of the specified analog stick, to be given to a Curve.
+ *
+ * The axes are calibrated with the range reported by the device and the center
+ * learned when it was opened. A radial deadzone is removed and the rest of the
+ * range is rescaled, so the position is 0 in the deadzone and grows from its
+ * edge. The calibration is kept for each device, so it isn't learned again
+ * when the device reconnects.
+ *
+ * \param controller A pointer to the controller object.
+ * \param stick The stick to retrieve the position for.
+ * \param x A pointer to an int16_t where the X-axis value will be stored.
+ * \param y A pointer to an int16_t where the Y-axis value will be stored.
+ */
+void controller_get_stick_values(const Controller *controller,
+                                 const ControllerStick stick, int16_t *x,
+                                 int16_t *y);
+
 /**
  * Start a rumble effect on the controller.
  *
@@ -133,6 +373,17 @@ void controller_get_stick(const Controller *controller,
  */
 bool controller_rumble(Controller *controller);
 
+/**
+ * Get the timestamp given by the kernel to the last event processed, so the
+ * callbacks can measure the latency of the event.
+ *
+ * \param controller A pointer to the controller object.
+ *
+ * \returns the timestamp in nanoseconds on the monotonic clock, or 0 if no
+ *          event was processed.
+ */
+uint64_t controller_get_event_time(const Controller *controller);
+
 /**
  * Checks if the controller is currently grabbed.
  *
@@ -156,3 +407,20 @@ bool controller_get_grabbed(const Controller *controller);
  * \returns true on success, false on failure.
  */
 bool controller_toggle_grabbed(Controller *controller);
+
+/**
+ * Ask the kernel to only deliver the events used by the given buttons and
+ * optionally the sticks, so the other events don't wake the process up. The
+ * position of the sticks is refreshed when they are delivered again.
+ *
+ * The events are not filtered if the kernel doesn't support event masks.
+ *
+ * \param controller A pointer to the controller object.
+ * \param buttons Whether each button is used, indexed by ControllerButton.
+ * \param sticks Whether the sticks are used.
+ *
+ * \returns true on success, false on failure.
+ */
+bool controller_set_event_mask(Controller *controller,
+                               const bool buttons[CONTROLLER_BUTTON_COUNT],
+                               const bool sticks);
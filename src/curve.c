@@ -0,0 +1,90 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "curve.h"
+
+/**
+ * Evaluate the Catmull-Rom spline going through evenly spaced points.
+ *
+ * \param points The points of the spline, from x = 0.0 to x = 1.0.
+ * \param points_count The number of points.
+ * \param x The position between 0.0 and 1.0.
+ *
+ * \returns the value of the spline.
+ */
+static float curve_spline(const float *points, const size_t points_count,
+                          const float x) {
+    const float position = x * (points_count - 1);
+    size_t segment = (size_t)position;
+    if (segment >= points_count - 1) segment = points_count - 2;
+    const float t = position - segment;
+
+    // The tangents at the ends use the first and the last points twice.
+    const float p0 = points[segment > 0 ? segment - 1 : 0];
+    const float p1 = points[segment];
+    const float p2 = points[segment + 1];
+    const float p3 = points[
+        segment + 2 < points_count ? segment + 2 : points_count - 1
+    ];
+
+    return p1 + 0.5f * t * (
+        (p2 - p0) +
+        t * ((2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) +
+             t * (3.0f * (p1 - p2) + p3 - p0))
+    );
+}
+
+/**
+ * Evaluate the shape of a curve.
+ *
+ * \param config The description of the curve.
+ * \param x The normalized position of the stick between 0.0 and 1.0.
+ *
+ * \returns the value of the shape, usually between 0.0 and 1.0.
+ */
+static float curve_shape(const CurveConfig *config, const float x) {
+    switch (config->type) {
+        case CURVE_LINEAR:
+            return x;
+
+        case CURVE_EXPONENTIAL:
+            return powf(x, config->exponent);
+
+        case CURVE_SPLINE:
+            assert(config->points_count >= 2 && "not enough spline points");
+            return curve_spline(config->points, config->points_count, x);
+
+        case CURVE_FUNCTION:
+            return config->function(x, config->function_data);
+    }
+
+    assert(false && "unreachable");
+    return 0.0f;
+}
+
+void curve_init(Curve *curve, const CurveConfig *config) {
+    assert(config->deadzone + config->saturation < 1.0f &&
+           "the deadzone and the saturation cover the whole range");
+
+    for (size_t entry = 0; entry < CURVE_LUT_SIZE; ++entry) {
+        const int32_t value = (int32_t)(entry << CURVE_LUT_SHIFT) + INT16_MIN;
+        const float position = fminf(
+            fabsf((float)value) / INT16_MAX,
+            1.0f
+        );
+
+        float output = 0.0f;
+        if (position > config->deadzone) {
+            const float x = fminf(
+                (position - config->deadzone) /
+                    (1.0f - config->deadzone - config->saturation),
+                1.0f
+            );
+            output = config->gain * curve_shape(config, x);
+        }
+        curve->lut[entry] = value < 0 ? -output : output;
+    }
+}
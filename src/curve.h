@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+ * Response curves of the sticks.
+ *
+ * A curve is baked once into a lookup table indexed by the high bits of the raw
+ * axis value, and the low bits interpolate between two entries. Evaluating a
+ * curve is the same whatever its type, so changing the curves costs nothing
+ * when the sticks are moved.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CURVE_LUT_BITS 10
+#define CURVE_LUT_SHIFT (16 - CURVE_LUT_BITS)
+
+/**
+ * Number of entries of the lookup table. The last entry is past the maximum
+ * axis value so the interpolation never reads out of the table.
+ */
+#define CURVE_LUT_SIZE ((1 << CURVE_LUT_BITS) + 1)
+
+/**
+ * Enum representing the shapes of curve.
+ */
+typedef enum {
+    CURVE_LINEAR,  // Proportional to the position of the stick.
+    CURVE_EXPONENTIAL,  // Position of the stick raised to exponent.
+    CURVE_SPLINE,  // Catmull-Rom spline through points.
+    CURVE_FUNCTION,  // Given by function.
+} CurveType;
+
+/**
+ * Description of a curve. The position of the stick is normalized between 0.0
+ * and 1.0 after removing the deadzone and the saturation, given to the shape of
+ * the curve, then multiplied by the gain. The sign of the position is kept.
+ */
+typedef struct {
+    CurveType type;
+    float gain;  // Output when the stick is fully pushed.
+    float deadzone;  // Part of the range around the center that outputs 0.0.
+    float saturation;  // Part of the range near the edges that outputs gain.
+    float exponent;  // for CURVE_EXPONENTIAL
+    const float *points;  // for CURVE_SPLINE, evenly spaced from 0.0 to 1.0
+    size_t points_count;  // for CURVE_SPLINE, at least 2
+    float (*function)(const float x, const void *data);  // for CURVE_FUNCTION
+    const void *function_data;  // for CURVE_FUNCTION
+} CurveConfig;
+
+/**
+ * A curve baked into a lookup table.
+ */
+typedef struct {
+    float lut[CURVE_LUT_SIZE];
+} Curve;
+
+/**
+ * Bake a curve into its lookup table.
+ *
+ * \param curve A pointer to the curve to initialize.
+ * \param config The description of the curve.
+ */
+void curve_init(Curve *curve, const CurveConfig *config);
+
+/**
+ * Evaluate a curve for a raw axis value.
+ *
+ * \param curve The curve to evaluate.
+ * \param value The raw axis value between INT16_MIN and INT16_MAX.
+ *
+ * \returns the output of the curve.
+ */
+static inline float curve_eval(const Curve *curve, const int16_t value) {
+    const uint32_t index = (uint32_t)(value - INT16_MIN);
+    const uint32_t entry = index >> CURVE_LUT_SHIFT;
+    const float t = (float)(index & ((1u << CURVE_LUT_SHIFT) - 1)) /
+        (1u << CURVE_LUT_SHIFT);
+    return curve->lut[entry] + (curve->lut[entry + 1] - curve->lut[entry]) * t;
+}
@@ -0,0 +1,90 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "device_watcher.h"
+#include "event_loop.h"
+#include "log.h"
+
+#define INPUT_DIRECTORY "/dev/input"
+#define DEVICE_PREFIX "event"
+#define DEVICE_PATH_SIZE 27
+
+static int inotify_fd = -1;
+static DeviceWatcherCallBack on_device = NULL;
+
+/**
+ * Handle the inotify events of the input directory.
+ * See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool device_watcher_handle_events(void *data) {
+    (void)data;
+
+    char buffer[sizeof(struct inotify_event) + NAME_MAX + 1]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        const ssize_t size = read(inotify_fd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EAGAIN) return true;
+            log_errorf("failed to read inotify events: %s", strerror(errno));
+            return false;
+        }
+
+        const struct inotify_event *event;
+        for (char *ptr = buffer; ptr < buffer + size;
+             ptr += sizeof(*event) + event->len) {
+            event = (const struct inotify_event *)ptr;
+            if (!event->len || strncmp(event->name, DEVICE_PREFIX,
+                                       strlen(DEVICE_PREFIX)) != 0) {
+                continue;
+            }
+
+            char device_path[DEVICE_PATH_SIZE];
+            snprintf(device_path, DEVICE_PATH_SIZE, INPUT_DIRECTORY "/%s",
+                     event->name);
+            log_debugf("input device changed: %s", device_path);
+            if (!on_device(device_path)) return false;
+        }
+    }
+}
+
+bool device_watcher_init(const DeviceWatcherCallBack new_on_device) {
+    on_device = new_on_device;
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        log_errorf("failed to initialize inotify: %s", strerror(errno));
+        return false;
+    }
+
+    // The permissions of a new device are often set by udev after its
+    // creation, so the device may only become accessible on IN_ATTRIB.
+    if (inotify_add_watch(inotify_fd, INPUT_DIRECTORY,
+                          IN_CREATE | IN_ATTRIB) < 0) {
+        log_errorf("failed to watch " INPUT_DIRECTORY ": %s", strerror(errno));
+        device_watcher_quit();
+        return false;
+    }
+
+    if (!event_loop_add_fd(inotify_fd, device_watcher_handle_events, NULL)) {
+        device_watcher_quit();
+        return false;
+    }
+
+    return true;
+}
+
+void device_watcher_quit(void) {
+    if (inotify_fd < 0) return;
+    event_loop_remove_fd(inotify_fd);
+    close(inotify_fd);
+    inotify_fd = -1;
+}
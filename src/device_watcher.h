@@ -0,0 +1,33 @@
+#pragma once
+
+/**
+ * Watcher of the input devices appearing in /dev/input, integrated with the
+ * event loop through inotify.
+ */
+
+#include <stdbool.h>
+
+/**
+ * Callback function called when an input device appears or its permissions
+ * change.
+ *
+ * \param device_path The path of the device (example: /dev/input/event20).
+ *
+ * \returns true on success, or false on failure which stops the event loop.
+ */
+typedef bool (*DeviceWatcherCallBack)(const char *device_path);
+
+/**
+ * Start watching the input devices. The event loop must be initialized.
+ *
+ * \param on_device A callback function that is invoked when an input device
+ *                  appears or becomes accessible.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool device_watcher_init(const DeviceWatcherCallBack on_device);
+
+/**
+ * Stop watching the input devices.
+ */
+void device_watcher_quit(void);
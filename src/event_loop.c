@@ -0,0 +1,464 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "log.h"
+#include "utils.h"
+
+#define EVENT_LOOP_MAX_EVENTS 16
+
+/**
+ * Number of timers allocated when the timers array is full.
+ */
+#define EVENT_LOOP_TIMERS_GROWTH 16
+
+/**
+ * A file descriptor watched by the event loop.
+ */
+typedef struct _EventSource EventSource;
+struct _EventSource {
+    int fd;
+    bool removed;
+    EventLoopCallback callback;
+    void *data;
+    EventSource *next;
+};
+
+/**
+ * A timer of the event loop. All the timers share a single timerfd armed for
+ * the earliest deadline.
+ */
+typedef struct {
+    bool used;
+    uint64_t deadline;  // ns, or 0 when disarmed.
+    uint64_t interval;  // ns
+    size_t heap_index;  // Index in the heap while armed.
+    EventLoopCallback callback;
+    void *data;
+} EventLoopTimer;
+
+static int epoll_fd = -1;
+static bool running = false;
+
+/**
+ * The timerfd expiring at the earliest deadline of the armed timers.
+ */
+static int timer_fd = -1;
+
+/**
+ * The timers indexed by their identifier.
+ */
+static EventLoopTimer *timers = NULL;
+static size_t timers_size = 0;
+
+/**
+ * Min-heap of the identifiers of the armed timers ordered by deadline.
+ */
+static int *timers_heap = NULL;
+static size_t timers_heap_size = 0;
+
+/**
+ * The deadline the timerfd is armed for, or 0 if it is disarmed.
+ */
+static uint64_t timer_fd_deadline = 0;
+
+/**
+ * The sources watched by the event loop.
+ */
+static EventSource *sources = NULL;
+
+/**
+ * Sources removed while dispatching events. They are freed once all the events
+ * returned by epoll_wait() are handled, so a pending event never refers to
+ * freed memory.
+ */
+static EventSource *removed_sources = NULL;
+
+static bool event_loop_add_source(const int fd,
+                                  const EventLoopCallback callback,
+                                  void *data);
+static bool event_loop_handle_timers(void *data);
+
+bool event_loop_init(void) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        log_errorf("failed to create epoll instance: %s", strerror(errno));
+        return false;
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        log_errorf("failed to create timer: %s", strerror(errno));
+        event_loop_quit();
+        return false;
+    }
+    if (!event_loop_add_source(timer_fd, event_loop_handle_timers, NULL)) {
+        event_loop_quit();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Free a list of sources.
+ *
+ * \param source The head of the list.
+ */
+static void event_loop_free_sources(EventSource *source) {
+    while (source) {
+        EventSource *next = source->next;
+        free(source);
+        source = next;
+    }
+}
+
+void event_loop_quit(void) {
+    event_loop_free_sources(sources);
+    sources = NULL;
+    event_loop_free_sources(removed_sources);
+    removed_sources = NULL;
+    free(timers);
+    timers = NULL;
+    timers_size = 0;
+    free(timers_heap);
+    timers_heap = NULL;
+    timers_heap_size = 0;
+    timer_fd_deadline = 0;
+    if (timer_fd >= 0) close(timer_fd);
+    timer_fd = -1;
+    if (epoll_fd >= 0) close(epoll_fd);
+    epoll_fd = -1;
+}
+
+/**
+ * Register a new source in the event loop.
+ *
+ * \param fd The file descriptor to watch.
+ * \param callback The function to call when the file descriptor is readable.
+ * \param data The user data passed to the callback.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool event_loop_add_source(const int fd,
+                                  const EventLoopCallback callback,
+                                  void *data) {
+    assert(epoll_fd >= 0 && "event loop hasn't been initialized");
+
+    EventSource *source = malloc(sizeof(*source));
+    if (!source) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return false;
+    }
+    source->fd = fd;
+    source->removed = false;
+    source->callback = callback;
+    source->data = data;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        log_errorf("failed to watch fd %d: %s", fd, strerror(errno));
+        free(source);
+        return false;
+    }
+
+    source->next = sources;
+    sources = source;
+
+    return true;
+}
+
+/**
+ * Unregister a source from the event loop.
+ *
+ * \param fd The file descriptor of the source.
+ *
+ * \returns true if a source was removed.
+ */
+static bool event_loop_remove_source(const int fd) {
+    for (EventSource **source = &sources; *source; source = &(*source)->next) {
+        if ((*source)->fd != fd) continue;
+
+        EventSource *removed = *source;
+        *source = removed->next;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+            log_errorf("failed to unwatch fd %d: %s", fd, strerror(errno));
+        }
+        removed->removed = true;
+        removed->next = removed_sources;
+        removed_sources = removed;
+        return true;
+    }
+
+    return false;
+}
+
+bool event_loop_add_fd(const int fd, const EventLoopCallback callback,
+                       void *data) {
+    return event_loop_add_source(fd, callback, data);
+}
+
+void event_loop_remove_fd(const int fd) {
+    event_loop_remove_source(fd);
+    if (!running) {
+        event_loop_free_sources(removed_sources);
+        removed_sources = NULL;
+    }
+}
+
+/**
+ * Swap two entries of the heap of timers.
+ *
+ * \param i The index of the first entry.
+ * \param j The index of the second entry.
+ */
+static void event_loop_heap_swap(const size_t i, const size_t j) {
+    const int timer = timers_heap[i];
+    timers_heap[i] = timers_heap[j];
+    timers_heap[j] = timer;
+    timers[timers_heap[i]].heap_index = i;
+    timers[timers_heap[j]].heap_index = j;
+}
+
+/**
+ * Whether the timer at an index of the heap expires before the one at another
+ * index.
+ */
+static inline bool event_loop_heap_less(const size_t i, const size_t j) {
+    return timers[timers_heap[i]].deadline < timers[timers_heap[j]].deadline;
+}
+
+/**
+ * Restore the order of the heap after the deadline of an entry changed.
+ *
+ * \param index The index of the entry in the heap.
+ */
+static void event_loop_heap_fix(size_t index) {
+    while (index > 0 && event_loop_heap_less(index, (index - 1) / 2)) {
+        event_loop_heap_swap(index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    for (;;) {
+        const size_t left = 2 * index + 1, right = left + 1;
+        size_t smallest = index;
+        if (left < timers_heap_size && event_loop_heap_less(left, smallest)) {
+            smallest = left;
+        }
+        if (right < timers_heap_size && event_loop_heap_less(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == index) break;
+        event_loop_heap_swap(index, smallest);
+        index = smallest;
+    }
+}
+
+/**
+ * Remove an armed timer from the heap.
+ *
+ * \param timer The identifier of the timer.
+ */
+static void event_loop_heap_remove(const int timer) {
+    const size_t index = timers[timer].heap_index;
+    --timers_heap_size;
+    if (index == timers_heap_size) return;
+
+    event_loop_heap_swap(index, timers_heap_size);
+    event_loop_heap_fix(index);
+}
+
+/**
+ * Arm the timerfd for the earliest deadline of the heap, or disarm it if no
+ * timer is armed.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool event_loop_arm_timer_fd(void) {
+    const uint64_t deadline = timers_heap_size
+        ? timers[timers_heap[0]].deadline
+        : 0;
+    if (deadline == timer_fd_deadline) return true;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline / NS_PER_S;
+    spec.it_value.tv_nsec = deadline % NS_PER_S;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        log_errorf("failed to set timer: %s", strerror(errno));
+        return false;
+    }
+    timer_fd_deadline = deadline;
+
+    return true;
+}
+
+int event_loop_add_timer(const EventLoopCallback callback, void *data) {
+    assert(timer_fd >= 0 && "event loop hasn't been initialized");
+
+    int timer = 0;
+    while ((size_t)timer < timers_size && timers[timer].used) ++timer;
+    if ((size_t)timer == timers_size) {
+        const size_t size = timers_size + EVENT_LOOP_TIMERS_GROWTH;
+        EventLoopTimer *new_timers = realloc(timers, size * sizeof(*timers));
+        if (!new_timers) {
+            log_errorf("failed to allocate memory: %s", strerror(errno));
+            return -1;
+        }
+        timers = new_timers;
+        int *new_heap = realloc(timers_heap, size * sizeof(*timers_heap));
+        if (!new_heap) {
+            log_errorf("failed to allocate memory: %s", strerror(errno));
+            return -1;
+        }
+        timers_heap = new_heap;
+        for (size_t i = timers_size; i < size; ++i) timers[i].used = false;
+        timers_size = size;
+    }
+
+    timers[timer] = (EventLoopTimer){
+        .used = true,
+        .deadline = 0,
+        .interval = 0,
+        .callback = callback,
+        .data = data,
+    };
+
+    return timer;
+}
+
+bool event_loop_set_timer(const int timer, const uint64_t delay,
+                          const uint64_t interval) {
+    assert(timer >= 0 && (size_t)timer < timers_size && timers[timer].used &&
+           "invalid timer");
+
+    EventLoopTimer *event_loop_timer = &timers[timer];
+    const bool armed = event_loop_timer->deadline != 0;
+    event_loop_timer->interval = interval;
+    if (!delay) {
+        if (!armed) return true;
+        event_loop_heap_remove(timer);
+        event_loop_timer->deadline = 0;
+        return event_loop_arm_timer_fd();
+    }
+
+    event_loop_timer->deadline = get_time_ns() + delay;
+    if (!armed) {
+        event_loop_timer->heap_index = timers_heap_size;
+        timers_heap[timers_heap_size++] = timer;
+    }
+    event_loop_heap_fix(event_loop_timer->heap_index);
+
+    return event_loop_arm_timer_fd();
+}
+
+void event_loop_remove_timer(const int timer) {
+    if (timers[timer].deadline) event_loop_heap_remove(timer);
+    timers[timer].used = false;
+    timers[timer].deadline = 0;
+    event_loop_arm_timer_fd();
+}
+
+/**
+ * Call the callbacks of the expired timers, then arm the timerfd for the next
+ * deadline.
+ * See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool event_loop_handle_timers(void *data) {
+    (void)data;
+
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0 &&
+        errno != EAGAIN) {
+        log_errorf("failed to read timer: %s", strerror(errno));
+        return false;
+    }
+    // The timerfd is disarmed once it expired.
+    timer_fd_deadline = 0;
+
+    const uint64_t now = get_time_ns();
+    while (timers_heap_size && timers[timers_heap[0]].deadline <= now) {
+        const int timer = timers_heap[0];
+        EventLoopTimer *event_loop_timer = &timers[timer];
+        if (event_loop_timer->interval) {
+            // The missed expirations are skipped like with a timerfd.
+            const uint64_t missed = (
+                (now - event_loop_timer->deadline) / event_loop_timer->interval
+            );
+            event_loop_timer->deadline += (
+                (missed + 1) * event_loop_timer->interval
+            );
+            event_loop_heap_fix(0);
+        } else {
+            event_loop_heap_remove(timer);
+            event_loop_timer->deadline = 0;
+        }
+
+        // The callback may set or remove any timer, including this one.
+        if (!event_loop_timer->callback(event_loop_timer->data)) return false;
+    }
+
+    return event_loop_arm_timer_fd();
+}
+
+/**
+ * Handle an event returned by epoll_wait().
+ *
+ * \param source The source that is ready.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool event_loop_dispatch(EventSource *source) {
+    if (source->removed) return true;
+
+    return source->callback(source->data);
+}
+
+bool event_loop_run(void) {
+    assert(epoll_fd >= 0 && "event loop hasn't been initialized");
+
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    bool success = true;
+    running = true;
+    while (running) {
+        const int events_count = epoll_wait(epoll_fd, events,
+                                            EVENT_LOOP_MAX_EVENTS, -1);
+        if (events_count < 0) {
+            if (errno == EINTR) continue;
+            log_errorf("failed to wait for events: %s", strerror(errno));
+            success = false;
+            break;
+        }
+
+        for (int i = 0; i < events_count && running; ++i) {
+            if (!event_loop_dispatch(events[i].data.ptr)) {
+                success = false;
+                running = false;
+            }
+        }
+
+        event_loop_free_sources(removed_sources);
+        removed_sources = NULL;
+    }
+    running = false;
+
+    return success;
+}
+
+void event_loop_stop(void) {
+    running = false;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+/**
+ * Event loop of the application built on top of epoll.
+ *
+ * File descriptors and timers are registered with a callback that is invoked
+ * when they become ready. Between events, the process sleeps in epoll_wait().
+ * The timers are kept in a min-heap sharing a single timerfd, armed for the
+ * earliest deadline, so the loop only wakes up when a timer is due.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Callback function called when a file descriptor registered in the event loop
+ * is ready to be read, or when a timer expires.
+ *
+ * \param data The user data given when the callback was registered.
+ *
+ * \returns true on success, or false on failure which stops the event loop.
+ */
+typedef bool (*EventLoopCallback)(void *data);
+
+/**
+ * Initialize the event loop.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool event_loop_init(void);
+
+/**
+ * Free the resources used by the event loop, including the timers created with
+ * event_loop_add_timer().
+ */
+void event_loop_quit(void);
+
+/**
+ * Watch a file descriptor for input.
+ *
+ * \param fd The file descriptor to watch.
+ * \param callback The function to call when the file descriptor is readable.
+ * \param data The user data passed to the callback.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool event_loop_add_fd(const int fd, const EventLoopCallback callback,
+                       void *data);
+
+/**
+ * Stop watching a file descriptor. The file descriptor is not closed.
+ *
+ * It is safe to call this function from a callback, even for the file
+ * descriptor being handled.
+ *
+ * \param fd The file descriptor to stop watching.
+ */
+void event_loop_remove_fd(const int fd);
+
+/**
+ * Create a disarmed timer watched by the event loop. The timer need to be
+ * destroyed with event_loop_remove_timer().
+ *
+ * \param callback The function to call when the timer expires.
+ * \param data The user data passed to the callback.
+ *
+ * \returns the identifier of the timer, or -1 on failure.
+ */
+int event_loop_add_timer(const EventLoopCallback callback, void *data);
+
+/**
+ * Arm or disarm a timer created with event_loop_add_timer(). The expirations
+ * missed by a periodic timer are skipped.
+ *
+ * It is safe to call this function from a callback, even for the timer being
+ * handled.
+ *
+ * \param timer The identifier of the timer.
+ * \param delay The delay in nanoseconds before the first expiration, or 0 to
+ *              disarm the timer.
+ * \param interval The period in nanoseconds of the following expirations, or
+ *                 0 for a one-shot timer.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool event_loop_set_timer(const int timer, const uint64_t delay,
+                          const uint64_t interval);
+
+/**
+ * Destroy a timer. It is safe to call this function from a callback, even for
+ * the timer being handled.
+ *
+ * \param timer The identifier of the timer.
+ */
+void event_loop_remove_timer(const int timer);
+
+/**
+ * Run the event loop until event_loop_stop() is called or a callback fails.
+ *
+ * \returns true if the loop was stopped, or false on failure.
+ */
+bool event_loop_run(void);
+
+/**
+ * Make event_loop_run() return after the current events are handled.
+ */
+void event_loop_stop(void);
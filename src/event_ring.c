@@ -0,0 +1,61 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "event_ring.h"
+
+_Static_assert((EVENT_RING_CAPACITY & (EVENT_RING_CAPACITY - 1)) == 0,
+               "EVENT_RING_CAPACITY must be a power of two");
+
+void event_ring_init(EventRing *ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->max_occupancy, 0);
+    atomic_init(&ring->overruns, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+bool event_ring_push(EventRing *ring, const struct input_event *event) {
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const size_t occupancy = head - tail;
+    if (occupancy == EVENT_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->events[head & (EVENT_RING_CAPACITY - 1)] = *event;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (occupancy + 1 > atomic_load_explicit(&ring->max_occupancy,
+                                             memory_order_relaxed)) {
+        atomic_store_explicit(&ring->max_occupancy, occupancy + 1,
+                              memory_order_relaxed);
+    }
+
+    return true;
+}
+
+bool event_ring_pop(EventRing *ring, struct input_event *event) {
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) return false;
+
+    *event = ring->events[tail & (EVENT_RING_CAPACITY - 1)];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+void event_ring_get_stats(EventRing *ring, EventRingStats *stats) {
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    // The head may have moved since the tail was loaded.
+    stats->occupancy = head - tail;
+    if (stats->occupancy > EVENT_RING_CAPACITY) {
+        stats->occupancy = EVENT_RING_CAPACITY;
+    }
+    stats->max_occupancy = atomic_load_explicit(&ring->max_occupancy,
+                                                memory_order_relaxed);
+    stats->overruns = atomic_load_explicit(&ring->overruns,
+                                           memory_order_relaxed);
+}
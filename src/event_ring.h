@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * Lock-free single-producer/single-consumer ring of input events.
+ *
+ * One thread pushes the events and another one pops them, without any lock.
+ * The events keep the timestamp given by the kernel.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/input.h>
+
+/**
+ * Number of events the ring can hold. It must be a power of two.
+ */
+#define EVENT_RING_CAPACITY 4096
+
+/**
+ * A ring of input events. The head is only written by the producer and the
+ * tail by the consumer, each one on its own cache line.
+ */
+typedef struct {
+    _Alignas(64) atomic_size_t head;
+    atomic_size_t max_occupancy;
+    atomic_uint_fast64_t overruns;
+    _Alignas(64) atomic_size_t tail;
+    _Alignas(64) struct input_event events[EVENT_RING_CAPACITY];
+} EventRing;
+
+/**
+ * Statistics of an EventRing.
+ */
+typedef struct {
+    size_t occupancy;
+    size_t max_occupancy;
+    uint64_t overruns;
+} EventRingStats;
+
+/**
+ * Initialize an empty ring.
+ *
+ * \param ring A pointer to the ring to initialize.
+ */
+void event_ring_init(EventRing *ring);
+
+/**
+ * Push an event to the ring. Must only be called by the producer thread.
+ *
+ * \param ring A pointer to the ring.
+ * \param event The event to push.
+ *
+ * \returns true on success, or false if the ring is full. In that case the
+ *          event is dropped and counted as an overrun.
+ */
+bool event_ring_push(EventRing *ring, const struct input_event *event);
+
+/**
+ * Pop the oldest event of the ring. Must only be called by the consumer thread.
+ *
+ * \param ring A pointer to the ring.
+ * \param event A pointer where the event will be stored.
+ *
+ * \returns true on success, or false if the ring is empty.
+ */
+bool event_ring_pop(EventRing *ring, struct input_event *event);
+
+/**
+ * Get the statistics of a ring. Can be called from any thread.
+ *
+ * \param ring A pointer to the ring.
+ * \param stats A pointer where the statistics will be stored.
+ */
+void event_ring_get_stats(EventRing *ring, EventRingStats *stats);
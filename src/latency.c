@@ -0,0 +1,215 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "latency.h"
+#include "utils.h"
+
+/**
+ * Each power of two is split in 2^LATENCY_SUB_BUCKET_BITS buckets, which gives
+ * a relative precision of 1.6%.
+ */
+#define LATENCY_SUB_BUCKET_BITS 6
+#define LATENCY_SUB_BUCKETS (1ull << LATENCY_SUB_BUCKET_BITS)
+
+/**
+ * The latencies are recorded up to 2^LATENCY_MAX_BITS ns, about 68 s, and the
+ * longer ones are recorded as the maximum.
+ */
+#define LATENCY_MAX_BITS 36
+#define LATENCY_MAX ((1ull << LATENCY_MAX_BITS) - 1)
+#define LATENCY_BUCKETS \
+    ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+/**
+ * Number of outputs whose latency can wait for latency_flush().
+ */
+#define LATENCY_PENDING_MAX 64
+
+/**
+ * Macro that defines the percentiles printed by latency_dump().
+ * Each percentile contains:
+ *  - The name of the percentile in the dump.
+ *  - The percentile between 0.0 and 100.0.
+ */
+#define LATENCY_PERCENTILES       \
+    LATENCY_PERCENTILE(p50, 50.0) \
+    LATENCY_PERCENTILE(p90, 90.0) \
+    LATENCY_PERCENTILE(p99, 99.0) \
+    LATENCY_PERCENTILE(p999, 99.9)
+
+/**
+ * A histogram of latencies.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;  // ns
+    uint64_t min;  // ns
+    uint64_t max;  // ns
+    uint64_t buckets[LATENCY_BUCKETS];
+} Histogram;
+
+/**
+ * An output not sent yet by the backend.
+ */
+typedef struct {
+    LatencyKind kind;
+    uint64_t event_time;
+} PendingLatency;
+
+static bool enabled = false;
+static Histogram histograms[LATENCY_KIND_COUNT];
+static PendingLatency pending[LATENCY_PENDING_MAX];
+static size_t pending_count = 0;
+
+static const char *const kind_names[LATENCY_KIND_COUNT] = {
+#define LATENCY_KIND(name, string) [name] = string,
+    LATENCY_KINDS
+#undef LATENCY_KIND
+};
+
+/**
+ * Get the bucket of a latency. The latencies below LATENCY_SUB_BUCKETS have
+ * their own bucket, then the buckets are LATENCY_SUB_BUCKETS per power of two.
+ *
+ * \param value The latency in nanoseconds.
+ *
+ * \returns the index of the bucket.
+ */
+static size_t latency_bucket(uint64_t value) {
+    if (value > LATENCY_MAX) value = LATENCY_MAX;
+    if (value < LATENCY_SUB_BUCKETS) return value;
+
+    const unsigned int shift = (
+        63 - __builtin_clzll(value) - LATENCY_SUB_BUCKET_BITS
+    );
+    return ((size_t)(shift + 1) << LATENCY_SUB_BUCKET_BITS) +
+        (value >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+/**
+ * Get the highest latency recorded into a bucket.
+ *
+ * \param bucket The index of the bucket.
+ *
+ * \returns the latency in nanoseconds.
+ */
+static uint64_t latency_bucket_max(const size_t bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+
+    const unsigned int shift = (bucket >> LATENCY_SUB_BUCKET_BITS) - 1;
+    const uint64_t mantissa = (
+        (bucket & (LATENCY_SUB_BUCKETS - 1)) + LATENCY_SUB_BUCKETS
+    );
+    return (mantissa << shift) + (1ull << shift) - 1;
+}
+
+/**
+ * Get a percentile of a histogram.
+ *
+ * \param histogram The histogram, which isn't empty.
+ * \param percentile The percentile between 0.0 and 100.0.
+ *
+ * \returns the highest latency of the bucket containing the percentile, in
+ *          nanoseconds.
+ */
+static uint64_t latency_percentile(const Histogram *histogram,
+                                   const double percentile) {
+    uint64_t rank = (uint64_t)(percentile / 100.0 * histogram->count + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        count += histogram->buckets[bucket];
+        if (count >= rank) {
+            const uint64_t value = latency_bucket_max(bucket);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/**
+ * Convert a latency to microseconds.
+ *
+ * \param value The latency in nanoseconds.
+ *
+ * \returns the latency in microseconds.
+ */
+static double latency_to_us(const uint64_t value) {
+    return (double)value / NS_PER_US;
+}
+
+void latency_enable(void) {
+    enabled = true;
+}
+
+/**
+ * Add a latency to the histogram of its kind.
+ *
+ * \param kind The kind of output.
+ * \param event_time The timestamp of the event in nanoseconds.
+ * \param now The time the output was sent in nanoseconds.
+ */
+static void latency_add(const LatencyKind kind, const uint64_t event_time,
+                        const uint64_t now) {
+    // A timestamp in the future is on another clock, when the kernel didn't
+    // timestamp the events with the monotonic clock.
+    if (event_time > now) return;
+    const uint64_t value = now - event_time;
+
+    Histogram *histogram = &histograms[kind];
+    if (!histogram->count || value < histogram->min) histogram->min = value;
+    if (value > histogram->max) histogram->max = value;
+    ++histogram->count;
+    histogram->sum += value;
+    ++histogram->buckets[latency_bucket(value)];
+}
+
+void latency_record(const LatencyKind kind, const uint64_t event_time) {
+    if (!enabled || !event_time) return;
+
+    // The outputs of a very long frame are measured when they're called.
+    if (pending_count == LATENCY_PENDING_MAX) {
+        latency_add(kind, event_time, get_time_ns());
+        return;
+    }
+    pending[pending_count++] = (PendingLatency){
+        .kind = kind,
+        .event_time = event_time,
+    };
+}
+
+void latency_flush(void) {
+    if (!pending_count) return;
+
+    const uint64_t now = get_time_ns();
+    for (size_t i = 0; i < pending_count; ++i) {
+        latency_add(pending[i].kind, pending[i].event_time, now);
+    }
+    pending_count = 0;
+}
+
+void latency_dump(void) {
+    if (!enabled) return;
+
+    for (LatencyKind kind = 0; kind < LATENCY_KIND_COUNT; ++kind) {
+        const Histogram *histogram = &histograms[kind];
+        printf("latency=%s count=%llu", kind_names[kind],
+               (unsigned long long)histogram->count);
+        if (histogram->count) {
+            printf(" min_us=%.1f mean_us=%.1f", latency_to_us(histogram->min),
+                   latency_to_us(histogram->sum / histogram->count));
+#define LATENCY_PERCENTILE(name, percentile) \
+    printf(" " #name "_us=%.1f",             \
+           latency_to_us(latency_percentile(histogram, percentile)));
+            LATENCY_PERCENTILES
+#undef LATENCY_PERCENTILE
+            printf(" max_us=%.1f", latency_to_us(histogram->max));
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+ * Measurement of the latency from the kernel timestamp of a controller event to
+ * the output it triggers, once the output backend sent it.
+ *
+ * The latencies are recorded into histograms whose buckets are powers of two
+ * split linearly, like HdrHistogram, so recording a latency is a few integer
+ * operations and the percentiles keep the same relative precision from
+ * microseconds to seconds.
+ */
+
+#include <stdint.h>
+
+/**
+ * Macro that defines the kinds of latency measured.
+ * Each kind contains:
+ *  - The name of the kind in LatencyKind.
+ *  - The name of the kind in the dump as a string.
+ */
+#define LATENCY_KINDS                        \
+    LATENCY_KIND(LATENCY_BUTTON, "button")   \
+    LATENCY_KIND(LATENCY_POINTER, "pointer") \
+    LATENCY_KIND(LATENCY_SCROLL, "scroll")
+
+/**
+ * Enum representing the kinds of latency measured.
+ */
+typedef enum {
+#define LATENCY_KIND(name, string) name,
+    LATENCY_KINDS
+#undef LATENCY_KIND
+    LATENCY_KIND_COUNT,
+} LatencyKind;
+
+/**
+ * Start recording the latencies. Nothing is recorded until this is called.
+ */
+void latency_enable(void);
+
+/**
+ * Record the latency of an output call, from the event that triggered it to
+ * the next latency_flush(), since the output may be buffered until
+ * output_flush().
+ *
+ * \param kind The kind of output.
+ * \param event_time The timestamp of the event on the monotonic clock in
+ *                   nanoseconds, or 0 if the output wasn't triggered by an
+ *                   event, in which case nothing is recorded.
+ */
+void latency_record(const LatencyKind kind, const uint64_t event_time);
+
+/**
+ * End the latencies recorded since the last call, when their outputs are sent
+ * by the output backend. Called by output_flush().
+ */
+void latency_flush(void);
+
+/**
+ * Print the percentiles of the latencies recorded since the start on the
+ * standard output, one line of key=value pairs per kind. Nothing is printed
+ * unless the measure is enabled.
+ */
+void latency_dump(void);
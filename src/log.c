@@ -5,10 +5,642 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef PROD
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#endif
+
 #include "log.h"
 
 static char *program_name = NULL;
 
+#ifndef PROD
+/**
+ * Number of records of the ring of a thread. It must be a power of two.
+ */
+#define LOG_RING_CAPACITY 1024
+
+/**
+ * Size of a record, including the arguments of the message.
+ */
+#define LOG_RECORD_SIZE 256
+
+/**
+ * Maximum size of a conversion specification, such as "%-8.3f".
+ */
+#define LOG_SPEC_SIZE 32
+
+/**
+ * Delay between two flushes of the records while there is nothing to print.
+ */
+#define LOG_FLUSH_INTERVAL 10000000  // ns
+
+/**
+ * Delay between two checks of a flush requested by log_wait_flush(), and the
+ * maximum time to wait for it.
+ */
+#define LOG_FLUSH_WAIT_INTERVAL 100000  // ns
+#define LOG_FLUSH_WAIT_TIMEOUT 1000000000  // ns
+
+/**
+ * Enum representing the types of argument of a conversion specification.
+ */
+typedef enum {
+    LOG_ARG_NONE,  // "%%"
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_CHAR,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER,
+    LOG_ARG_UNSUPPORTED,  // The message is formatted by the caller.
+} LogArgType;
+
+/**
+ * Enum representing the length modifiers of the integer conversions.
+ */
+typedef enum {
+    LOG_LENGTH_NONE,
+    LOG_LENGTH_HH,
+    LOG_LENGTH_H,
+    LOG_LENGTH_L,
+    LOG_LENGTH_LL,
+    LOG_LENGTH_Z,
+    LOG_LENGTH_J,
+    LOG_LENGTH_T,
+    LOG_LENGTH_LONG_DOUBLE,
+} LogLength;
+
+/**
+ * A conversion specification parsed from a format.
+ */
+typedef struct {
+    LogArgType type;
+    LogLength length;
+    size_t size;  // Length of the specification in the format.
+    size_t prefix;  // Length before the length modifier.
+    char conversion;
+} LogSpec;
+
+/**
+ * A debug message. The arguments are copied in binary, and formatted with the
+ * format by the flush thread.
+ */
+typedef struct {
+    uint64_t sequence;  // Best-effort order of the message among the threads.
+    const char *file;
+    size_t line;
+    const char *format;  // NULL if data contains the formatted message.
+    unsigned char data[LOG_RECORD_SIZE - 4 * sizeof(uint64_t)];
+} LogRecord;
+
+_Static_assert(sizeof(LogRecord) == LOG_RECORD_SIZE,
+               "LogRecord must take LOG_RECORD_SIZE bytes");
+_Static_assert((LOG_RING_CAPACITY & (LOG_RING_CAPACITY - 1)) == 0,
+               "LOG_RING_CAPACITY must be a power of two");
+
+/**
+ * Single-producer/single-consumer ring of the records of a thread. A ring is
+ * reused by another thread once its thread exits.
+ */
+typedef struct _LogRing {
+    _Alignas(64) atomic_size_t head;
+    atomic_uint_fast64_t dropped;
+    _Alignas(64) atomic_size_t tail;
+    uint64_t dropped_reported;  // Only used by the flush thread.
+    _Alignas(64) atomic_bool used;  // Whether a thread writes to the ring.
+    struct _LogRing *next;
+    _Alignas(64) LogRecord records[LOG_RING_CAPACITY];
+} LogRing;
+
+/**
+ * The rings of all the threads, which are only added at the head.
+ */
+static _Atomic(LogRing *) rings = NULL;
+
+static _Thread_local LogRing *thread_ring = NULL;
+static pthread_key_t thread_ring_key;
+static atomic_uint_fast64_t sequence = 0;
+
+static pthread_t flush_thread;
+static atomic_bool flush_thread_running = false;
+static atomic_bool flush_thread_stopping = false;
+
+/**
+ * The flushes requested by log_wait_flush(), the last one done by the flush
+ * thread, and the semaphore waking the flush thread up for a request.
+ */
+static atomic_uint_fast64_t flush_requests = 0;
+static atomic_uint_fast64_t flush_done = 0;
+static sem_t flush_wake;
+
+/**
+ * Signals of an abort or a crash, after which the pending records are printed
+ * before the program is terminated.
+ */
+static const int crash_signals[] = {SIGABRT, SIGBUS, SIGFPE, SIGILL, SIGSEGV};
+
+/**
+ * Parse the conversion specification at the start of a string.
+ *
+ * \param string The specification, starting with '%'.
+ * \param spec A pointer where the specification will be stored.
+ */
+static void log_parse_spec(const char *string, LogSpec *spec) {
+    const char *cursor = string + 1;
+    cursor += strspn(cursor, "-+ #0");
+    cursor += strspn(cursor, "0123456789");
+    if (*cursor == '.') {
+        ++cursor;
+        cursor += strspn(cursor, "0123456789");
+    }
+    spec->prefix = cursor - string;
+
+    spec->length = LOG_LENGTH_NONE;
+    if (cursor[0] == 'h' && cursor[1] == 'h') {
+        spec->length = LOG_LENGTH_HH;
+        cursor += 2;
+    } else if (cursor[0] == 'l' && cursor[1] == 'l') {
+        spec->length = LOG_LENGTH_LL;
+        cursor += 2;
+    } else if (*cursor == 'h') {
+        spec->length = LOG_LENGTH_H;
+        ++cursor;
+    } else if (*cursor == 'l') {
+        spec->length = LOG_LENGTH_L;
+        ++cursor;
+    } else if (*cursor == 'z') {
+        spec->length = LOG_LENGTH_Z;
+        ++cursor;
+    } else if (*cursor == 'j') {
+        spec->length = LOG_LENGTH_J;
+        ++cursor;
+    } else if (*cursor == 't') {
+        spec->length = LOG_LENGTH_T;
+        ++cursor;
+    } else if (*cursor == 'L') {
+        spec->length = LOG_LENGTH_LONG_DOUBLE;
+        ++cursor;
+    }
+
+    spec->conversion = *cursor;
+    spec->size = cursor - string + (*cursor != '\0');
+    // The specification is copied with "ll" instead of its length modifier.
+    if (spec->prefix + 4 > LOG_SPEC_SIZE) {
+        spec->type = LOG_ARG_UNSUPPORTED;
+        return;
+    }
+
+    switch (spec->conversion) {
+        case '%':
+            spec->type = LOG_ARG_NONE;
+            break;
+        case 'd':
+        case 'i':
+            spec->type = LOG_ARG_INT;
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec->type = LOG_ARG_UINT;
+            break;
+        case 'c':
+            spec->type = LOG_ARG_CHAR;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->type = LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = LOG_ARG_STRING;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_POINTER;
+            break;
+        default:
+            // '*', "%n" and the wide characters.
+            spec->type = LOG_ARG_UNSUPPORTED;
+            break;
+    }
+
+    // The length modifiers are only supported by the integers and "%lf".
+    const bool integer = (
+        spec->type == LOG_ARG_INT || spec->type == LOG_ARG_UINT
+    );
+    if (integer ? spec->length == LOG_LENGTH_LONG_DOUBLE
+                : spec->length != LOG_LENGTH_NONE &&
+                  !(spec->type == LOG_ARG_DOUBLE &&
+                    spec->length == LOG_LENGTH_L)) {
+        spec->type = LOG_ARG_UNSUPPORTED;
+    }
+}
+
+/**
+ * Read a signed integer argument.
+ *
+ * \param length The length modifier of the argument.
+ * \param args The arguments.
+ *
+ * \returns the value of the argument.
+ */
+static int64_t log_read_int(const LogLength length, va_list *args) {
+    switch (length) {
+        case LOG_LENGTH_HH:
+            return (signed char)va_arg(*args, int);
+
+        case LOG_LENGTH_H:
+            return (short)va_arg(*args, int);
+
+        case LOG_LENGTH_L:
+            return va_arg(*args, long);
+
+        case LOG_LENGTH_LL:
+            return va_arg(*args, long long);
+
+        case LOG_LENGTH_Z:
+            return va_arg(*args, ssize_t);
+
+        case LOG_LENGTH_J:
+            return va_arg(*args, intmax_t);
+
+        case LOG_LENGTH_T:
+            return va_arg(*args, ptrdiff_t);
+
+        default:
+            return va_arg(*args, int);
+    }
+}
+
+/**
+ * Read an unsigned integer argument.
+ *
+ * \param length The length modifier of the argument.
+ * \param args The arguments.
+ *
+ * \returns the value of the argument.
+ */
+static uint64_t log_read_uint(const LogLength length, va_list *args) {
+    switch (length) {
+        case LOG_LENGTH_HH:
+            return (unsigned char)va_arg(*args, unsigned int);
+
+        case LOG_LENGTH_H:
+            return (unsigned short)va_arg(*args, unsigned int);
+
+        case LOG_LENGTH_L:
+            return va_arg(*args, unsigned long);
+
+        case LOG_LENGTH_LL:
+            return va_arg(*args, unsigned long long);
+
+        case LOG_LENGTH_Z:
+            return va_arg(*args, size_t);
+
+        case LOG_LENGTH_J:
+            return va_arg(*args, uintmax_t);
+
+        case LOG_LENGTH_T:
+            return (uint64_t)va_arg(*args, ptrdiff_t);
+
+        default:
+            return va_arg(*args, unsigned int);
+    }
+}
+
+/**
+ * Copy the arguments of a message into a record, without formatting them.
+ *
+ * \param record The record.
+ * \param format The format of the message.
+ * \param args The arguments of the message.
+ *
+ * \returns true on success, or false if the arguments don't fit in the record
+ *          or can't be formatted later.
+ */
+static bool log_copy_args(LogRecord *record, const char *format,
+                          va_list *args) {
+    unsigned char *data = record->data;
+    const unsigned char *data_end = record->data + sizeof(record->data);
+    for (const char *cursor = strchr(format, '%'); cursor;
+         cursor = strchr(cursor, '%')) {
+        LogSpec spec;
+        log_parse_spec(cursor, &spec);
+        cursor += spec.size;
+
+        union {
+            int64_t int_value;
+            uint64_t uint_value;
+            double double_value;
+            const void *pointer_value;
+        } value;
+        switch (spec.type) {
+            case LOG_ARG_NONE:
+                continue;
+            case LOG_ARG_INT:
+                value.int_value = log_read_int(spec.length, args);
+                break;
+            case LOG_ARG_UINT:
+                value.uint_value = log_read_uint(spec.length, args);
+                break;
+            case LOG_ARG_CHAR:
+                value.int_value = va_arg(*args, int);
+                break;
+            case LOG_ARG_DOUBLE:
+                value.double_value = va_arg(*args, double);
+                break;
+            case LOG_ARG_POINTER:
+                value.pointer_value = va_arg(*args, void *);
+                break;
+            case LOG_ARG_STRING: {
+                const char *string = va_arg(*args, const char *);
+                if (!string) string = "(null)";
+                const size_t size = strlen(string) + 1;
+                if (size > (size_t)(data_end - data)) return false;
+                memcpy(data, string, size);
+                data += size;
+                continue;
+            }
+            default:
+                return false;
+        }
+
+        if (sizeof(value) > (size_t)(data_end - data)) return false;
+        memcpy(data, &value, sizeof(value));
+        data += sizeof(value);
+    }
+
+    return true;
+}
+
+/**
+ * Print a record, formatting its arguments.
+ *
+ * \param record The record.
+ */
+static void log_print_record(const LogRecord *record) {
+    // The lines printed by the other threads aren't interleaved.
+    flockfile(stdout);
+    printf("%s:%lu: %s: debug: ", record->file, record->line, program_name);
+    if (!record->format) {
+        puts((const char *)record->data);
+        funlockfile(stdout);
+        return;
+    }
+
+    const unsigned char *data = record->data;
+    const char *cursor = record->format;
+    for (const char *percent = strchr(cursor, '%'); percent;
+         percent = strchr(cursor, '%')) {
+        fwrite(cursor, 1, percent - cursor, stdout);
+        LogSpec spec;
+        log_parse_spec(percent, &spec);
+        cursor = percent + spec.size;
+
+        char format[LOG_SPEC_SIZE];
+        memcpy(format, percent, spec.prefix);
+        char *format_end = format + spec.prefix;
+        if (spec.type == LOG_ARG_INT || spec.type == LOG_ARG_UINT) {
+            *format_end++ = 'l';
+            *format_end++ = 'l';
+        }
+        *format_end++ = spec.conversion;
+        *format_end = '\0';
+
+        union {
+            int64_t int_value;
+            uint64_t uint_value;
+            double double_value;
+            const void *pointer_value;
+        } value;
+        if (spec.type == LOG_ARG_NONE) {
+            putchar('%');
+            continue;
+        } else if (spec.type == LOG_ARG_STRING) {
+            printf(format, (const char *)data);
+            data += strlen((const char *)data) + 1;
+            continue;
+        }
+
+        memcpy(&value, data, sizeof(value));
+        data += sizeof(value);
+        if (spec.type == LOG_ARG_INT) {
+            printf(format, (long long)value.int_value);
+        } else if (spec.type == LOG_ARG_UINT) {
+            printf(format, (unsigned long long)value.uint_value);
+        } else if (spec.type == LOG_ARG_CHAR) {
+            printf(format, (int)value.int_value);
+        } else if (spec.type == LOG_ARG_DOUBLE) {
+            printf(format, value.double_value);
+        } else if (spec.type == LOG_ARG_POINTER) {
+            printf(format, value.pointer_value);
+        }
+    }
+    puts(cursor);
+    funlockfile(stdout);
+}
+
+/**
+ * Print the records of all the rings ordered by their sequence, and the number
+ * of records dropped since the last flush.
+ *
+ * The order between the threads is best effort: a record is only seen once it
+ * is published, after it got its sequence, so a record published late may be
+ * printed after the records that followed it in the other threads.
+ *
+ * \returns the number of records printed.
+ */
+static size_t log_flush(void) {
+    size_t printed = 0;
+    for (;;) {
+        // The oldest record is at the tail of one of the rings.
+        LogRing *oldest = NULL;
+        uint64_t oldest_sequence = 0;
+        for (LogRing *ring = atomic_load(&rings); ring; ring = ring->next) {
+            const size_t tail = atomic_load_explicit(&ring->tail,
+                                                     memory_order_relaxed);
+            const size_t head = atomic_load_explicit(&ring->head,
+                                                     memory_order_acquire);
+            if (head == tail) continue;
+            const LogRecord *record = &ring->records[
+                tail & (LOG_RING_CAPACITY - 1)
+            ];
+            if (!oldest || record->sequence < oldest_sequence) {
+                oldest = ring;
+                oldest_sequence = record->sequence;
+            }
+        }
+        if (!oldest) break;
+
+        const size_t tail = atomic_load_explicit(&oldest->tail,
+                                                 memory_order_relaxed);
+        log_print_record(&oldest->records[tail & (LOG_RING_CAPACITY - 1)]);
+        atomic_store_explicit(&oldest->tail, tail + 1, memory_order_release);
+        ++printed;
+    }
+
+    for (LogRing *ring = atomic_load(&rings); ring; ring = ring->next) {
+        const uint64_t dropped = atomic_load_explicit(&ring->dropped,
+                                                      memory_order_relaxed);
+        if (dropped == ring->dropped_reported) continue;
+        printf("%s: debug: %lu messages dropped, the log ring was full\n",
+               program_name, dropped - ring->dropped_reported);
+        ring->dropped_reported = dropped;
+        ++printed;
+    }
+
+    if (printed) fflush(stdout);
+    return printed;
+}
+
+/**
+ * Main function of the flush thread.
+ *
+ * \param data Unused.
+ *
+ * \returns NULL.
+ */
+static void *log_flush_thread(void *data) {
+    (void)data;
+
+    // The signals are handled by the main thread.
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    for (;;) {
+        const bool stopping = atomic_load(&flush_thread_stopping);
+        const uint64_t requests = atomic_load(&flush_requests);
+        // The records written before the stop or a request are flushed.
+        const size_t printed = log_flush();
+        atomic_store(&flush_done, requests);
+        if (printed) continue;
+        if (stopping) return NULL;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_nsec -= 1000000000;
+            ++deadline.tv_sec;
+        }
+        sem_timedwait(&flush_wake, &deadline);
+    }
+}
+
+/**
+ * Make the flush thread print the records written so far, and wait until they
+ * are printed. It only uses async-signal-safe functions, so it can be called
+ * from a signal handler.
+ *
+ * The wait is bounded, in case the flush thread can't make progress.
+ */
+static void log_wait_flush(void) {
+    if (!atomic_load(&flush_thread_running) ||
+        pthread_equal(pthread_self(), flush_thread)) {
+        return;
+    }
+
+    const uint64_t request = atomic_fetch_add(&flush_requests, 1) + 1;
+    sem_post(&flush_wake);
+    const struct timespec interval = {.tv_nsec = LOG_FLUSH_WAIT_INTERVAL};
+    for (uint64_t waited = 0;
+         atomic_load(&flush_done) < request &&
+         atomic_load(&flush_thread_running) &&
+         waited < LOG_FLUSH_WAIT_TIMEOUT;
+         waited += LOG_FLUSH_WAIT_INTERVAL) {
+        nanosleep(&interval, NULL);
+    }
+}
+
+/**
+ * Print the pending records when the program aborts or crashes. The default
+ * action of the signal is restored, so the program terminates once the
+ * handler returns.
+ *
+ * \param signal Unused.
+ */
+static void log_handle_crash(const int signal) {
+    (void)signal;
+
+    log_wait_flush();
+}
+
+/**
+ * Release the ring of a thread which exits, so another thread can reuse it.
+ *
+ * \param data A pointer to the ring.
+ */
+static void log_release_ring(void *data) {
+    LogRing *ring = data;
+    atomic_store_explicit(&ring->used, false, memory_order_release);
+}
+
+/**
+ * Get the ring of the calling thread, reusing the ring of a thread which
+ * exited or creating one.
+ *
+ * \returns a pointer to the ring, or NULL on failure.
+ */
+static LogRing *log_get_ring(void) {
+    if (thread_ring) return thread_ring;
+
+    LogRing *ring;
+    for (ring = atomic_load(&rings); ring; ring = ring->next) {
+        bool used = false;
+        if (atomic_compare_exchange_strong(&ring->used, &used, true)) break;
+    }
+
+    if (!ring) {
+        ring = aligned_alloc(_Alignof(LogRing), sizeof(*ring));
+        if (!ring) return NULL;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->dropped, 0);
+        atomic_init(&ring->tail, 0);
+        ring->dropped_reported = 0;
+        atomic_init(&ring->used, true);
+        ring->next = atomic_load(&rings);
+        while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)) {}
+    }
+
+    pthread_setspecific(thread_ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+/**
+ * Stop the flush thread after it printed the pending records. The messages are
+ * then printed directly.
+ */
+static void log_stop_flush_thread(void) {
+    if (!atomic_load(&flush_thread_running)) return;
+    atomic_store(&flush_thread_stopping, true);
+    sem_post(&flush_wake);
+    pthread_join(flush_thread, NULL);
+    atomic_store(&flush_thread_running, false);
+
+    struct sigaction action = {.sa_handler = SIG_DFL};
+    for (size_t i = 0; i < sizeof(crash_signals) / sizeof(*crash_signals);
+         ++i) {
+        sigaction(crash_signals[i], &action, NULL);
+    }
+    sem_destroy(&flush_wake);
+}
+#endif
+
 bool log_init(const char *new_program_name) {
     const size_t program_name_size = strlen(new_program_name) + 1;
     program_name = malloc(program_name_size);
@@ -19,16 +651,51 @@ bool log_init(const char *new_program_name) {
     }
     memcpy(program_name, new_program_name, program_name_size);
 
+#ifndef PROD
+    // Without the flush thread, the messages are printed directly.
+    int err = pthread_key_create(&thread_ring_key, log_release_ring);
+    if (!err && sem_init(&flush_wake, 0, 0) < 0) err = errno;
+    if (!err) {
+        atomic_store(&flush_thread_stopping, false);
+        err = pthread_create(&flush_thread, NULL, log_flush_thread, NULL);
+        if (err) sem_destroy(&flush_wake);
+    }
+    if (err) {
+        fprintf(stderr, "%s: error: failed to start the log thread: %s\n",
+                program_name, strerror(err));
+    } else {
+        atomic_store(&flush_thread_running, true);
+        // The pending messages are printed when exit() is called early, and
+        // when the program aborts or crashes.
+        atexit(log_stop_flush_thread);
+        struct sigaction action = {
+            .sa_handler = log_handle_crash,
+            .sa_flags = SA_RESETHAND,
+        };
+        sigemptyset(&action.sa_mask);
+        for (size_t i = 0;
+             i < sizeof(crash_signals) / sizeof(*crash_signals); ++i) {
+            sigaction(crash_signals[i], &action, NULL);
+        }
+    }
+#endif
+
     return true;
 }
 
 void log_quit(void) {
+#ifndef PROD
+    log_stop_flush_thread();
+#endif
     free(program_name);
+    program_name = NULL;
 }
 
 void _log_errorf(file_and_line_param const char *format, ...) {
     assert(program_name && "log module hasn't been initialized");
 #ifndef PROD
+    // The debug messages logged before are printed first.
+    log_wait_flush();
     fprintf(stderr, "%s:%lu: ", file, line);
 #endif
     fprintf(stderr, "%s: error: ", program_name);
@@ -41,11 +708,48 @@ void _log_errorf(file_and_line_param const char *format, ...) {
 
 #ifndef PROD
 void _log_debugf(const char *file, const size_t line, const char *format, ...) {
-    printf("%s:%lu: %s: debug: ", file, line, program_name);
+    LogRing *ring = (
+        atomic_load_explicit(&flush_thread_running, memory_order_relaxed)
+        ? log_get_ring()
+        : NULL
+    );
+    if (!ring) {
+        printf("%s:%lu: %s: debug: ", file, line, program_name);
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        fputc('\n', stdout);
+        return;
+    }
+
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == LOG_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    // The sequence orders the records of the threads in log_flush(), as long
+    // as they are published before a later record is flushed.
+    LogRecord *record = &ring->records[head & (LOG_RING_CAPACITY - 1)];
+    record->sequence = atomic_fetch_add_explicit(&sequence, 1,
+                                                 memory_order_relaxed);
+    record->file = file;
+    record->line = line;
+    record->format = format;
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    va_list copy;
+    va_copy(copy, args);
+    if (!log_copy_args(record, format, &copy)) {
+        // Formatted now, truncated to the size of the record.
+        record->format = NULL;
+        vsnprintf((char *)record->data, sizeof(record->data), format, args);
+    }
+    va_end(copy);
     va_end(args);
-    fputc('\n', stdout);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
 }
 #endif
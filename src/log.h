@@ -34,6 +34,17 @@ void log_quit(void);
  * Log a debug message with the given format prefixed by the file and the line
  * from where the message was printed.
  *
+ * The arguments are copied to a lock-free ring of the calling thread, and a
+ * background thread formats and prints the messages, so logging doesn't wait
+ * for the output. The messages are dropped and counted while the ring is full.
+ * The format must be a string literal since it is read later. The messages of
+ * a thread are printed in order, but the messages of different threads logged
+ * at the same time may be printed in a different order than they were logged.
+ *
+ * The pending messages are printed before an error, and when the program
+ * aborts or crashes. They are lost if the program is killed by another
+ * signal.
+ *
  * Use the log_debugf() so the file and line parameters are filled automatically.
  * In production build, the debug call will be removed.
  *
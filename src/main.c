@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <libgen.h>
+#include <limits.h>
 #include <math.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -8,20 +9,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/signalfd.h>
 #include <unistd.h>
 
-#include <xdo.h>
-
 #include "config.h"
+#include "config_file.h"
+#include "config_watcher.h"
 #include "controller.h"
+#include "curve.h"
+#include "device_watcher.h"
+#include "event_loop.h"
+#include "latency.h"
 #include "log.h"
+#include "mapping.h"
+#include "motion.h"
 #include "mouse_buttons.h"
+#include "output.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "realtime.h"
+#include "trace.h"
 #include "utils.h"
 
 #ifndef VERSION
 #define VERSION "0.0.0"
 #endif
 
+#define REPLAY_CONTROLLERS_MAX 16
+#define REPLAY_CHUNK_SIZE 4096  // events replayed at once in fast mode
+
+/**
+ * The slowest scroll speed in notches per second. A slower speed stops the
+ * scrolling, so the delay between two scrolls stays far from overflowing.
+ */
+#define SCROLL_SPEED_MIN 1e-3f
+
 /**
  * Macro that defines the command-line flags.
  * Each flag contains:
@@ -30,10 +52,42 @@
  * - A short name for the flag which must be a single character.
  * - A description of the flag as a string.
  */
-#define ARGS_FLAGS                                             \
-    FLAG(help, h, "show this help message and exit")           \
-    FLAG(version, v, "show program's version number and exit") \
-    FLAG(list, l, "list all available controllers and exit")
+#define ARGS_FLAGS                                                        \
+    FLAG(help, h, "show this help message and exit")                      \
+    FLAG(version, v, "show program's version number and exit")            \
+    FLAG(list, l, "list all available controllers and exit")              \
+    FLAG(threaded, t, "read each controller in a dedicated input thread") \
+    FLAG(smooth, s,                                                       \
+         "scroll smoothly with high-resolution mouse wheel events")       \
+    FLAG(latency, L,                                                      \
+         "measure the latency of the outputs, printed on SIGUSR1 and at " \
+         "exit")                                                          \
+    FLAG(fast, f, "replay the trace as fast as possible")                 \
+    FLAG(realtime, p, "run with a real-time priority and locked memory")
+
+/**
+ * Macro that defines the command-line options taking a value.
+ * Each option contains:
+ * - A name used as a string property when arguments are parsed and for the
+ *   long version of the option.
+ * - A short name for the option which must be a single character.
+ * - A name in capital case for the value used in the help of the program as a
+ *   string.
+ * - A description of the option as a string.
+ */
+#define ARGS_OPTIONS                                             \
+    OPTION(backend, b, "NAME",                                   \
+           "the output backend to use: xdo or uinput (default: " \
+           DEFAULT_OUTPUT_BACKEND ")")                           \
+    OPTION(config, c, "FILE",                                    \
+           "the config file to use (default: "                   \
+           "~/.config/desktop-controller/config)")               \
+    OPTION(record, r, "FILE",                                    \
+           "record the events of the controllers to a trace")    \
+    OPTION(replay, R, "FILE",                                    \
+           "replay a trace instead of reading the controllers")  \
+    OPTION(cpu, C, "CPU",                                        \
+           "pin the input and output work to a CPU")
 
 /**
  * Macro that defines the command-line parameters.
@@ -48,33 +102,162 @@
 
 /**
  * Structure containing the parsed arguments with the flags stored as boolean
- * and the parameters stored as string.
+ * and the options and the parameters stored as string.
  */
 typedef struct {
 #define FLAG(name, short_name, description) bool name;
     ARGS_FLAGS
 #undef FLAG
+#define OPTION(name, short_name, value_name, description) char *name;
+    ARGS_OPTIONS
+#undef OPTION
 #define PARAM(name, param_name, description) char *name;
     ARGS_PARAMS
 #undef PARAM
 } Args;
 
 /**
- * Should the main loop stop and the application quit.
+ * State of the scrolling along one axis of the right stick.
+ */
+typedef struct {
+    int timer;
+    bool timer_armed;
+    uint64_t last_scroll;
+    float speed;  // Mouse wheel notches per second.
+    uint64_t event_time;  // The event starting to scroll, until it scrolls.
+    MouseButton button_negative;
+    MouseButton button_positive;
+} ScrollAxis;
+
+/**
+ * A controller used by the app with its own state, so several controllers can
+ * be used at the same time.
+ */
+typedef struct _Pad Pad;
+struct _Pad {
+    Controller *controller;
+
+    /**
+     * The pipeline reading the controller in threaded mode, or NULL.
+     */
+    Pipeline *pipeline;
+
+    /**
+     * Whether the left stick uses the precision curve, while the
+     * MOUSE_SPEED_BUTTON is pressed.
+     */
+    bool precision;
+
+    /**
+     * The actions of the buttons currently pressed, or NULL, so they are
+     * released even if the controller is ungrabbed or disconnected, or the
+     * active window changes in the meantime.
+     */
+    const Action *pressed_actions[CONTROLLER_BUTTON_COUNT];
+
+    /**
+     * Periodic timer moving the mouse while the left stick is not centered.
+     */
+    int pointer_timer;
+    bool pointer_timer_armed;
+    Motion pointer_motion;
+
+    /**
+     * The velocity of the mouse in pixels per millisecond, updated on each
+     * frame of the controller.
+     */
+    float pointer_velocity_x;
+    float pointer_velocity_y;
+
+    /**
+     * The timestamps of the events which changed the velocities, until the
+     * mouse is moved or scrolled with them, to measure their latency. 0 when
+     * there is no such event.
+     */
+    uint64_t pointer_event_time;
+    uint64_t scroll_event_time;
+
+    /**
+     * Integration of the right stick into high-resolution scrolling, moved by
+     * the pointer timer in smooth scroll mode.
+     */
+    Motion scroll_motion;
+    float scroll_velocity_x;  // Units of OUTPUT_SCROLL_NOTCH per millisecond.
+    float scroll_velocity_y;
+
+    ScrollAxis scroll_x;
+    ScrollAxis scroll_y;
+
+    /**
+     * The index of the controller in the trace being recorded.
+     */
+    unsigned int trace_controller;
+
+    Pad *next;
+};
+
+/**
+ * The controllers used by the app.
+ */
+static Pad *pads = NULL;
+
+/**
+ * The path of the controller given on the command-line, or NULL to use all the
+ * controllers found.
+ */
+static const char *controller_path = NULL;
+
+/**
+ * Whether the controllers are read by input threads.
+ */
+static bool threaded = false;
+
+/**
+ * Whether the right stick scrolls continuously with high-resolution events
+ * instead of mouse wheel clicks.
+ */
+static bool smooth_scroll = false;
+
+/**
+ * The config used to handle the events. It is replaced at once when the config
+ * file is reloaded.
+ */
+static Config *config = NULL;
+
+/**
+ * The mapping of the active window, in the config.
  */
-static bool app_quit = false;
+static const Mapping *mapping = NULL;
 
 /**
- * The mouse speed multiplier.
+ * The path of the config file, and whether it was given on the command-line
+ * and so must exist.
  */
-static float mouse_speed = DEFAULT_MOUSE_SPEED;
+static const char *config_path = NULL;
+static bool config_required = false;
 
 /**
- * The controller used by the app.
+ * The trace where the events of the controllers are recorded, or NULL.
  */
-static Controller *controller = NULL;
+static Trace *record_trace = NULL;
+static unsigned int record_controllers = 0;
 
-static xdo_t *xdo = NULL;
+/**
+ * State of the replay of a trace, which replaces the controllers.
+ */
+typedef struct {
+    Trace *trace;
+    const char *path;
+    bool fast;  // Replay as fast as possible instead of at the original speed.
+    int timer;
+    uint64_t start;  // ns
+    TraceRecordType type;  // The type of the next record, not replayed yet.
+    TraceRecord record;
+    Pad *pads[REPLAY_CONTROLLERS_MAX];  // The pads by index in the trace.
+    uint64_t events;
+} Replay;
+
+static Replay replay = {.trace = NULL, .timer = -1};
 
 /**
  * Print the usage of the program.
@@ -90,6 +273,10 @@ static void print_usage(const char *program_name, FILE *stream) {
 #define FLAG(name, short_name, description) "[-" #short_name "] "
     ARGS_FLAGS
 #undef FLAG
+#define OPTION(name, short_name, value_name, description) \
+    "[-" #short_name " " value_name "] "
+    ARGS_OPTIONS
+#undef OPTION
 #define PARAM(name, param_name, description) "[" param_name "] "
     ARGS_PARAMS
 #undef PARAM
@@ -120,6 +307,18 @@ static bool args_parse(Args *args, char *argv[], const char *program_name) {
     }
     ARGS_FLAGS
 #undef FLAG
+#define OPTION(name, short_name, value_name, description)              \
+    if (streq(*argv, "--" #name)) {                                    \
+        if (!argv[1]) {                                                \
+            print_usage(program_name, stderr);                         \
+            log_errorf("argument --" #name ": expected one argument"); \
+            return false;                                              \
+        }                                                              \
+        args->name = *++argv;                                          \
+        continue;                                                      \
+    }
+    ARGS_OPTIONS
+#undef OPTION
             } else {
                 for (size_t i = 1; (*argv)[i]; ++i) {
 #define FLAG(name, short_name, description) \
@@ -129,6 +328,22 @@ static bool args_parse(Args *args, char *argv[], const char *program_name) {
     }
     ARGS_FLAGS
 #undef FLAG
+#define OPTION(name, short_name, value_name, description) \
+    if ((*argv)[i] == CHAR(short_name)) {                 \
+        if ((*argv)[i + 1]) {                             \
+            args->name = *argv + i + 1;                   \
+        } else if (argv[1]) {                             \
+            args->name = *++argv;                         \
+        } else {                                          \
+            print_usage(program_name, stderr);            \
+            log_errorf("argument -" #short_name           \
+                       ": expected one argument");        \
+            return false;                                 \
+        }                                                 \
+        break;                                            \
+    }
+    ARGS_OPTIONS
+#undef OPTION
 
                     print_usage(program_name, stderr);
                     log_errorf("unrecognized arguments: '-%c'", (*argv)[i]);
@@ -175,137 +390,837 @@ static void print_help(const char *program_name) {
     "    -" #short_name ", --%-15s " description "\n"
     ARGS_FLAGS
 #undef FLAG
+#define OPTION(name, short_name, value_name, description) \
+    "    -" #short_name ", --%-15s " description "\n"
+    ARGS_OPTIONS
+#undef OPTION
 #define PARAM(name, param_name, description) , param_name
     ARGS_PARAMS
 #undef PARAM
 #define FLAG(name, short_name, description) , #name
     ARGS_FLAGS
 #undef FLAG
+#define OPTION(name, short_name, value_name, description) \
+    , #name " " value_name
+    ARGS_OPTIONS
+#undef OPTION
     );
 }
 
+/**
+ * Handle the release of a button on the controller.
+ * See ControllerButtonEventCallBack.
+ *
+ * \param button The button that was released.
+ * \param data A pointer to the Pad of the controller.
+ */
+static void handle_button_up(const ControllerButton button, void *data) {
+    Pad *pad = data;
+    const Action *action = pad->pressed_actions[button];
+    if (!action) return;
+    pad->pressed_actions[button] = NULL;
+
+    switch (action->type) {
+        case ACTION_MOUSE_SPEED:
+            pad->precision = false;
+            log_debugf("set mouse speed to default");
+            break;
+
+        case ACTION_MOUSE_BUTTON:
+            if (!output_mouse_up(action->mouse_button)) exit(EXIT_FAILURE);
+            log_debugf("mouse button %s up",
+                       mouse_button_to_string(action->mouse_button));
+            break;
+
+        case ACTION_KEYS:
+            if (!output_keys_up(&action->keys)) exit(EXIT_FAILURE);
+            log_debugf("keys up: '%s'", action->keys_name);
+            break;
+
+        case ACTION_NONE:
+        case ACTION_GRAB_TOGGLE:
+            break;
+    }
+}
+
+/**
+ * Release the buttons of a controller whose action is pressed.
+ *
+ * \param pad The pad of the controller.
+ */
+static void release_buttons(Pad *pad) {
+    for (ControllerButton button = 0; button < CONTROLLER_BUTTON_COUNT;
+         ++button) {
+        handle_button_up(button, pad);
+    }
+}
+
+/**
+ * Only receive the events of a controller used by its mapping. While the
+ * controller is ungrabbed, only the event of the grab toggle is received.
+ *
+ * This need to be called when the mapping or the grab state changes.
+ *
+ * \param pad The pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool update_event_mask(Pad *pad) {
+    const bool grabbed = controller_get_grabbed(pad->controller);
+    bool buttons[CONTROLLER_BUTTON_COUNT];
+    for (ControllerButton button = 0; button < CONTROLLER_BUTTON_COUNT;
+         ++button) {
+        const ActionType type = mapping->actions[button].type;
+        // The release of the buttons pressed with another mapping is still
+        // needed.
+        buttons[button] = (
+            type == ACTION_GRAB_TOGGLE ||
+            (grabbed && type != ACTION_NONE) ||
+            pad->pressed_actions[button]
+        );
+    }
+
+    return controller_set_event_mask(pad->controller, buttons, grabbed);
+}
+
 /**
  * Handles the press of a buttons on the controller.
+ * See ControllerButtonEventCallBack.
  *
  * \param button The button that was pressed.
+ * \param data A pointer to the Pad of the controller.
  */
-static void handle_button_down(const ControllerButton button) {
-    assert(xdo && "xdo isn't initialized");
+static void handle_button_down(const ControllerButton button, void *data) {
+    Pad *pad = data;
+    const Action *action = &mapping->actions[button];
 
-    if (button == GRAB_TOGGLE_BUTTON) {
-        assert(controller && "controller isn't initialized");
-        if (!controller_toggle_grabbed(controller)) {
+    if (action->type == ACTION_GRAB_TOGGLE) {
+        if (!controller_toggle_grabbed(pad->controller)) {
             exit(EXIT_FAILURE);
         }
-        if (!controller_rumble(controller)) {
+        // The release of the buttons won't be received while ungrabbed.
+        if (!controller_get_grabbed(pad->controller)) release_buttons(pad);
+        if (!update_event_mask(pad)) exit(EXIT_FAILURE);
+        if (!controller_rumble(pad->controller)) {
             exit(EXIT_FAILURE);
         }
+        return;
     }
 
-    if (!controller_get_grabbed(controller)) return;
+    if (!controller_get_grabbed(pad->controller)) return;
+    if (action->type != ACTION_NONE) pad->pressed_actions[button] = action;
 
-    if (button == MOUSE_SPEED_BUTTON) {
-        mouse_speed = PRECISION_MOUSE_SPEED;
-        log_debugf("set mouse speed to precision");
-        return;
+    switch (action->type) {
+        case ACTION_MOUSE_SPEED:
+            pad->precision = true;
+            log_debugf("set mouse speed to precision");
+            break;
+
+        case ACTION_MOUSE_BUTTON:
+            if (!output_mouse_down(action->mouse_button)) exit(EXIT_FAILURE);
+            latency_record(LATENCY_BUTTON,
+                           controller_get_event_time(pad->controller));
+            log_debugf("mouse button %s down",
+                       mouse_button_to_string(action->mouse_button));
+            break;
+
+        case ACTION_KEYS:
+            if (!output_keys_down(&action->keys)) exit(EXIT_FAILURE);
+            latency_record(LATENCY_BUTTON,
+                           controller_get_event_time(pad->controller));
+            log_debugf("keys down: '%s'", action->keys_name);
+            break;
+
+        case ACTION_NONE:
+        case ACTION_GRAB_TOGGLE:
+            break;
     }
+}
 
-#define MAP(controller_button, mouse_button)                    \
-    if (button == controller_button) {                          \
-        if (xdo_mouse_down(xdo, CURRENTWINDOW, mouse_button)) { \
-            log_errorf("failed to set mouse button %s down",    \
-                       mouse_button_to_string(mouse_button));   \
-            exit(EXIT_FAILURE);                                 \
-        };                                                      \
-        log_debugf("mouse button %s down",                      \
-                   mouse_button_to_string(mouse_button));       \
-        return;                                                 \
+/**
+ * Move the mouse and scroll according to the velocities of the pad and the
+ * ticks elapsed since the last move. The moves of a frame are coalesced by the
+ * output.
+ *
+ * \param pad The pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool pointer_move(Pad *pad) {
+    const uint64_t now = get_time_ns();
+    int dx, dy;
+    if (motion_update(&pad->pointer_motion, now, pad->pointer_velocity_x,
+                      pad->pointer_velocity_y, &dx, &dy)) {
+        log_debugf("move mouse: dx=%d dy=%d", dx, dy);
+        if (!output_move_mouse(dx, dy)) return false;
+        latency_record(LATENCY_POINTER, pad->pointer_event_time);
+        pad->pointer_event_time = 0;
+    }
+
+    if (motion_update(&pad->scroll_motion, now, pad->scroll_velocity_x,
+                      pad->scroll_velocity_y, &dx, &dy)) {
+        log_debugf("scroll: dx=%d dy=%d", dx, dy);
+        if (!output_scroll(dx, dy)) return false;
+        latency_record(LATENCY_SCROLL, pad->scroll_event_time);
+        pad->scroll_event_time = 0;
     }
 
-    MAP_BUTTON_TO_MOUSE
+    return true;
+}
 
-#undef MAP
+/**
+ * Move the mouse on each tick while the left stick, or the right stick in
+ * smooth scroll mode, is not centered.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the Pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_pointer_timer(void *data) {
+    return pointer_move(data) && output_flush();
+}
 
-#define MAP(controller_button, keys)                                         \
-    if (button == controller_button) {                                       \
-        if (xdo_send_keysequence_window_down(xdo, CURRENTWINDOW, keys, 0)) { \
-            log_errorf("failed to set keys down: '" keys "'");               \
-            exit(EXIT_FAILURE);                                              \
-        }                                                                    \
-        log_debugf("keys down: '" keys "'");                                 \
-        return;                                                              \
+/**
+ * Keep the timestamp of the event which changed a velocity until an output
+ * uses the new velocity. The oldest event is kept when the velocity changes
+ * several times before that.
+ *
+ * \param event_time A pointer to the timestamp kept, or 0.
+ * \param changed Whether the velocity changed.
+ * \param active Whether the new velocity moves the mouse or scrolls.
+ * \param time The timestamp of the event.
+ */
+static void track_event_time(uint64_t *event_time, const bool changed,
+                             const bool active, const uint64_t time) {
+    if (!active) {
+        *event_time = 0;
+    } else if (changed && !*event_time) {
+        *event_time = time;
     }
+}
+
+/**
+ * Update the velocities of the mouse and of the smooth scrolling after a frame
+ * of the controller, and start or stop the pointer timer depending on them.
+ *
+ * \param pad The pad of the controller.
+ * \param vx The velocity of the mouse on the X axis in pixels per millisecond.
+ * \param vy The velocity of the mouse on the Y axis in pixels per millisecond.
+ * \param scroll_x The scroll speed on the X axis in notches per second, or 0.0
+ *                 if the right stick doesn't scroll smoothly.
+ * \param scroll_y The scroll speed on the Y axis in notches per second, or 0.0
+ *                 if the right stick doesn't scroll smoothly.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool pointer_update(Pad *pad, const float vx, const float vy,
+                           const float scroll_x, const float scroll_y) {
+    // The ticks elapsed during the frame are integrated with the velocity the
+    // sticks had before it.
+    if (pad->pointer_timer_armed && !pointer_move(pad)) return false;
+
+    const float scroll_vx = scroll_x * OUTPUT_SCROLL_NOTCH / 1000.0f;
+    const float scroll_vy = scroll_y * OUTPUT_SCROLL_NOTCH / 1000.0f;
+    const uint64_t event_time = controller_get_event_time(pad->controller);
+    track_event_time(
+        &pad->pointer_event_time,
+        vx != pad->pointer_velocity_x || vy != pad->pointer_velocity_y,
+        vx != 0.0f || vy != 0.0f,
+        event_time
+    );
+    track_event_time(
+        &pad->scroll_event_time,
+        scroll_vx != pad->scroll_velocity_x ||
+            scroll_vy != pad->scroll_velocity_y,
+        scroll_vx != 0.0f || scroll_vy != 0.0f,
+        event_time
+    );
+    pad->pointer_velocity_x = vx;
+    pad->pointer_velocity_y = vy;
+    pad->scroll_velocity_x = scroll_vx;
+    pad->scroll_velocity_y = scroll_vy;
 
-    MAP_BUTTON_TO_KEYS
+    const bool active = (
+        vx != 0.0f || vy != 0.0f || scroll_x != 0.0f || scroll_y != 0.0f
+    );
+    if (active == pad->pointer_timer_armed) return true;
+
+    if (active) {
+        const uint64_t now = get_time_ns();
+        motion_start(&pad->pointer_motion, now);
+        motion_start(&pad->scroll_motion, now);
+        if (!event_loop_set_timer(pad->pointer_timer,
+                                  pad->pointer_motion.tick_duration,
+                                  pad->pointer_motion.tick_duration)) {
+            return false;
+        }
+    } else if (!event_loop_set_timer(pad->pointer_timer, 0, 0)) {
+        return false;
+    }
+    pad->pointer_timer_armed = active;
 
-#undef MAP
+    return true;
 }
 
 /**
- * Handle the release of a button on the controller.
+ * Scroll along an axis when the scroll delay is elapsed, then schedule the next
+ * scroll according to the scroll speed.
  *
- * \param button The button that was released.
+ * \param axis The axis to scroll.
+ * \param speed The scroll speed along the axis in notches per second.
+ * \param event_time The timestamp of the event which set the speed, or 0.
+ *
+ * \returns true on success, or false on failure.
  */
-static void handle_button_up(const ControllerButton button) {
-    assert(xdo && "xdo isn't initialized");
+static bool scroll_update(ScrollAxis *axis, const float speed,
+                          const uint64_t event_time) {
+    // Only the start of the scrolling is measured, the next scrolls are
+    // delayed by the scroll speed on purpose.
+    if (axis->speed == 0.0f) axis->event_time = event_time;
+    axis->speed = fabsf(speed) < SCROLL_SPEED_MIN ? 0.0f : speed;
+    if (axis->speed == 0.0f) {
+        axis->event_time = 0;
+        if (!axis->timer_armed) return true;
+        axis->timer_armed = false;
+        return event_loop_set_timer(axis->timer, 0, 0);
+    }
 
-    if (!controller_get_grabbed(controller)) return;
+    const uint64_t scroll_speed = NS_PER_S / fabsf(speed);
+    const uint64_t now = get_time_ns();
+    if (now - axis->last_scroll > scroll_speed) {
+        const MouseButton button = speed < 0.0f ? axis->button_negative
+                                                : axis->button_positive;
+        if (!output_mouse_click(button)) return false;
+        latency_record(LATENCY_SCROLL, axis->event_time);
+        axis->event_time = 0;
+        log_debugf("scroll: %s", mouse_button_to_string(button));
+        axis->last_scroll = now;
+    }
 
-    if (button == MOUSE_SPEED_BUTTON) {
-        mouse_speed = DEFAULT_MOUSE_SPEED;
-        log_debugf("set mouse speed to default");
-        return;
+    axis->timer_armed = true;
+    return event_loop_set_timer(axis->timer,
+                                axis->last_scroll + scroll_speed + 1 - now, 0);
+}
+
+/**
+ * Scroll when the scroll delay of an axis is elapsed.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the ScrollAxis to scroll.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_scroll_timer(void *data) {
+    ScrollAxis *axis = data;
+    axis->timer_armed = false;
+    return scroll_update(axis, axis->speed, 0) && output_flush();
+}
+
+/**
+ * Update the timers moving the mouse and scrolling after the state of a
+ * controller changed.
+ *
+ * \param pad The pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool update_sticks(Pad *pad) {
+    int16_t lx = 0, ly = 0, rx = 0, ry = 0;
+    if (controller_get_grabbed(pad->controller)) {
+        controller_get_stick_values(pad->controller, CONTROLLER_STICK_LEFT,
+                                    &lx, &ly);
+        controller_get_stick_values(pad->controller, CONTROLLER_STICK_RIGHT,
+                                    &rx, &ry);
+    }
+
+    const Curve *pointer_curve = pad->precision
+        ? &config->precision_pointer_curve
+        : &config->pointer_curve;
+    const float vx = curve_eval(pointer_curve, lx);
+    const float vy = curve_eval(pointer_curve, ly);
+    const float scroll_x = curve_eval(&config->scroll_curve, rx);
+    const float scroll_y = curve_eval(&config->scroll_curve, ry);
+    if (smooth_scroll) return pointer_update(pad, vx, vy, scroll_x, scroll_y);
+
+    const uint64_t event_time = controller_get_event_time(pad->controller);
+    return (
+        pointer_update(pad, vx, vy, 0.0f, 0.0f) &&
+        scroll_update(&pad->scroll_x, scroll_x, event_time) &&
+        scroll_update(&pad->scroll_y, scroll_y, event_time)
+    );
+}
+
+/**
+ * Update the output after a batch of controller events was processed.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the Pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_controller_processed(void *data) {
+    return update_sticks(data) && output_flush();
+}
+
+/**
+ * Destroy the timers and the controller of a pad and free it. The pad must not
+ * be read anymore.
+ *
+ * \param pad The pad to free.
+ */
+static void pad_free(Pad *pad) {
+    if (pad->pointer_timer >= 0) {
+        event_loop_remove_timer(pad->pointer_timer);
+    }
+    if (pad->scroll_x.timer >= 0) {
+        event_loop_remove_timer(pad->scroll_x.timer);
+    }
+    if (pad->scroll_y.timer >= 0) {
+        event_loop_remove_timer(pad->scroll_y.timer);
+    }
+    controller_destroy(pad->controller);
+    free(pad);
+}
+
+/**
+ * Release the buttons of a controller, stop reading it and destroy its pad.
+ *
+ * \param pad The pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool detach_pad(Pad *pad) {
+    release_buttons(pad);
+
+    if (pad->pipeline) {
+        pipeline_stop(pad->pipeline);
+    } else if (controller_get_fd(pad->controller) >= 0) {
+        event_loop_remove_fd(controller_get_fd(pad->controller));
+    }
+
+    for (Pad **it = &pads; *it; it = &(*it)->next) {
+        if (*it == pad) {
+            *it = pad->next;
+            break;
+        }
+    }
+    pad_free(pad);
+
+    return output_flush();
+}
+
+/**
+ * Handle the failure of reading a controller, usually because it was
+ * disconnected, and wait for it to come back.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the Pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_controller_failed(void *data) {
+    Pad *pad = data;
+
+    log_errorf("lost the controller %s, waiting for it to reconnect",
+               controller_get_path(pad->controller));
+    return detach_pad(pad);
+}
+
+/**
+ * Handle the pending events of a controller.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the Pad of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_controller_events(void *data) {
+    Pad *pad = data;
+    if (!controller_update(pad->controller, handle_button_down,
+                           handle_button_up, pad)) {
+        return handle_controller_failed(pad);
+    }
+
+    return handle_controller_processed(pad);
+}
+
+/**
+ * Record an event of a controller before it is processed.
+ * See ControllerEventCallBack.
+ *
+ * \param event The event read from the controller.
+ * \param data A pointer to the Pad of the controller.
+ */
+static void record_event(const struct input_event *event, void *data) {
+    const Pad *pad = data;
+    if (!trace_write_event(record_trace, pad->trace_controller, event)) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Send the outputs of the buttons of a frame of events before the next frame
+ * is processed, so a press and a release in two frames of a batch aren't
+ * merged into a single frame of the output. See ControllerFrameCallBack.
+ *
+ * \param data Unused.
+ */
+static void handle_controller_frame(void *data) {
+    (void)data;
+
+    if (!output_flush()) exit(EXIT_FAILURE);
+}
+
+/**
+ * Create the pad of a new controller and start reading it.
+ * See ControllerFoundCallBack.
+ *
+ * \param controller The controller to use.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool attach_controller(Controller *controller) {
+    Pad *pad = malloc(sizeof(*pad));
+    if (!pad) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        controller_destroy(controller);
+        return false;
+    }
+    *pad = (Pad){
+        .controller = controller,
+        .pipeline = NULL,
+        .precision = false,
+        .pointer_timer = -1,
+        .scroll_x = {
+            .timer = -1,
+            .button_negative = MOUSE_WHEEL_LEFT,
+            .button_positive = MOUSE_WHEEL_RIGHT,
+        },
+        .scroll_y = {
+            .timer = -1,
+            .button_negative = MOUSE_WHEEL_UP,
+            .button_positive = MOUSE_WHEEL_DOWN,
+        },
+    };
+
+    motion_init(&pad->pointer_motion, POINTER_UPDATE_RATE);
+    motion_init(&pad->scroll_motion, POINTER_UPDATE_RATE);
+    pad->pointer_timer = event_loop_add_timer(handle_pointer_timer, pad);
+    pad->scroll_x.timer = event_loop_add_timer(handle_scroll_timer,
+                                                  &pad->scroll_x);
+    pad->scroll_y.timer = event_loop_add_timer(handle_scroll_timer,
+                                                  &pad->scroll_y);
+    if (
+        pad->pointer_timer < 0 ||
+        pad->scroll_x.timer < 0 ||
+        pad->scroll_y.timer < 0 ||
+        !update_event_mask(pad)
+    ) {
+        pad_free(pad);
+        return false;
+    }
+
+    if (record_trace) {
+        ControllerInfo info;
+        controller_get_info(controller, &info);
+        pad->trace_controller = record_controllers++;
+        if (!trace_write_controller(record_trace, pad->trace_controller,
+                                    &info)) {
+            pad_free(pad);
+            return false;
+        }
+        controller_set_recorder(controller, record_event, pad);
     }
+    controller_set_frame_handler(controller, handle_controller_frame, NULL);
 
-#define MAP(controller_button, mouse_button)                  \
-    if (button == controller_button) {                        \
-        if (xdo_mouse_up(xdo, CURRENTWINDOW, mouse_button)) { \
-            log_errorf("failed to set mouse button %s up",    \
-                       mouse_button_to_string(mouse_button)); \
-            exit(EXIT_FAILURE);                               \
-        }                                                     \
-        log_debugf("mouse button %s up",                      \
-                   mouse_button_to_string(mouse_button));     \
-        return;                                               \
+    if (controller_get_fd(controller) < 0) {
+        // The events of a controller without device are fed by the replay.
+    } else if (threaded) {
+        pad->pipeline = pipeline_start(controller, handle_button_down,
+                                       handle_button_up,
+                                       handle_controller_processed,
+                                       handle_controller_failed, pad);
+        if (!pad->pipeline) {
+            pad_free(pad);
+            return false;
+        }
+    } else if (!event_loop_add_fd(controller_get_fd(controller),
+                                  handle_controller_events, pad)) {
+        pad_free(pad);
+        return false;
+    }
+
+    pad->next = pads;
+    pads = pad;
+
+    return true;
+}
+
+/**
+ * Attach a device that appeared in /dev/input if it is a controller that isn't
+ * used yet. If a controller was given on the command-line, only this
+ * controller is attached.
+ * See DeviceWatcherCallBack.
+ *
+ * \param device_path The path of the device.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_device(const char *device_path) {
+    if (controller_path && !streq(device_path, controller_path)) return true;
+    for (const Pad *pad = pads; pad; pad = pad->next) {
+        if (streq(controller_get_path(pad->controller), device_path)) {
+            return true;
+        }
     }
 
-    MAP_BUTTON_TO_MOUSE
+    Controller *controller = controller_probe(device_path);
+    if (!controller) return true;
+
+    return attach_controller(controller);
+}
+
+/**
+ * Use the mapping of the active window to handle the buttons. The buttons
+ * already pressed are released with the action they were pressed with.
+ * See ProfileCallBack.
+ *
+ * \param new_mapping The mapping of the active window.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool set_mapping(const Mapping *new_mapping) {
+    mapping = new_mapping;
+    for (Pad *pad = pads; pad; pad = pad->next) {
+        if (!update_event_mask(pad)) return false;
+    }
 
-#undef MAP
+    return true;
+}
 
-#define MAP(controller_button, keys)                                       \
-    if (button == controller_button) {                                     \
-        if (xdo_send_keysequence_window_up(xdo, CURRENTWINDOW, keys, 0)) { \
-            log_errorf("faield to set keys up: '" keys "'");               \
-            exit(EXIT_FAILURE);                                            \
-        }                                                                  \
-        log_debugf("keys down: '" keys "'");                               \
-        return;                                                            \
+/**
+ * Create the pad of a controller described by the trace being replayed.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool replay_controller(void) {
+    const unsigned int index = replay.record.controller;
+    if (index >= REPLAY_CONTROLLERS_MAX || replay.pads[index]) {
+        log_errorf("%s: invalid controller %u", replay.path, index);
+        return false;
     }
 
-    MAP_BUTTON_TO_KEYS
+    Controller *controller = controller_from_info(&replay.record.info,
+                                                  replay.path);
+    if (!controller || !attach_controller(controller)) return false;
+    // The new pad is the first one.
+    replay.pads[index] = pads;
 
-#undef MAP
+    return true;
 }
 
 /**
- * Determine the scroll speed based on the stick input value.
+ * Process an event of the trace being replayed like an event read from a
+ * controller.
  *
- * \param v The input value from the controller's stick between -1.0 and 1.0.
- * \return The scroll speed corresponding to the input value.
+ * \param time The time of the event on the monotonic clock in nanoseconds.
+ *
+ * \returns true on success, or false on failure.
  */
-static float get_scroll_speed(const float v) {
-    return SCROLL_MIN_SPEED * (fabs(v) - 1.0f) * (fabs(v) - 1.0f) +
-        SCROLL_MAX_SPEED;
+static bool replay_event(const uint64_t time) {
+    const unsigned int index = replay.record.controller;
+    Pad *pad = index < REPLAY_CONTROLLERS_MAX ? replay.pads[index] : NULL;
+    if (!pad) {
+        log_errorf("%s: event of an unknown controller %u", replay.path,
+                   index);
+        return false;
+    }
+
+    struct input_event event = replay.record.event;
+    event.time.tv_sec = time / NS_PER_S;
+    event.time.tv_usec = time % NS_PER_S / NS_PER_US;
+    controller_process_event(pad->controller, &event, handle_button_down,
+                             handle_button_up, pad);
+    ++replay.events;
+
+    // The frames are handled like the batches of events read from a device.
+    if (event.type == EV_SYN && event.code == SYN_REPORT) {
+        return handle_controller_processed(pad);
+    }
+
+    return true;
 }
 
 /**
- * Handle the SIGINT signal (Ctrl+C) and set the application to quit.
+ * Replay the records of the trace which are due, then wait for the next one.
+ * In fast mode, the records are replayed by chunks so the event loop still
+ * handles the other events.
+ * See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
  */
-static void hanlde_sigint(const int _) {
-    (void)_;
-    app_quit = true;
+static bool handle_replay_timer(void *data) {
+    (void)data;
+
+    const uint64_t now = get_time_ns();
+    for (size_t count = 0;; ++count) {
+        if (replay.type == TRACE_RECORD_END) {
+            const uint64_t duration = get_time_ns() - replay.start;
+            printf("replay=%s events=%llu duration_ms=%.1f "
+                   "ns_per_event=%.1f\n", replay.path,
+                   (unsigned long long)replay.events,
+                   (double)duration / NS_PER_MS,
+                   replay.events ? (double)duration / replay.events : 0.0);
+            fflush(stdout);
+            log_debugf("replay finished");
+            event_loop_stop();
+            return true;
+        }
+
+        if (replay.type == TRACE_RECORD_INVALID) return false;
+
+        if (replay.type == TRACE_RECORD_CONTROLLER) {
+            if (!replay_controller()) return false;
+        } else if (replay.fast) {
+            if (count == REPLAY_CHUNK_SIZE) {
+                return event_loop_set_timer(replay.timer, 1, 0);
+            }
+            if (!replay_event(get_time_ns())) return false;
+        } else {
+            const uint64_t time = replay.start + (
+                replay.record.time > 0 ? replay.record.time * NS_PER_US : 0
+            );
+            if (time > now) {
+                return event_loop_set_timer(replay.timer, time - now, 0);
+            }
+            if (!replay_event(time)) return false;
+        }
+
+        replay.type = trace_read(replay.trace, &replay.record);
+    }
+}
+
+/**
+ * Start replaying a trace in place of the controllers.
+ *
+ * \param path The path of the trace.
+ * \param fast Whether to replay the trace as fast as possible instead of at
+ *             its original speed.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool replay_start(const char *path, const bool fast) {
+    replay.trace = trace_open(path);
+    if (!replay.trace) return false;
+    replay.path = path;
+    replay.fast = fast;
+
+    replay.timer = event_loop_add_timer(handle_replay_timer, NULL);
+    if (replay.timer < 0) return false;
+
+    replay.start = get_time_ns();
+    replay.type = trace_read(replay.trace, &replay.record);
+    log_debugf("replay %s", path);
+
+    return event_loop_set_timer(replay.timer, 1, 0);
+}
+
+/**
+ * Stop replaying the trace and close it.
+ */
+static void replay_stop(void) {
+    if (replay.timer >= 0) event_loop_remove_timer(replay.timer);
+    replay.timer = -1;
+    if (replay.trace) trace_close(replay.trace);
+    replay.trace = NULL;
+}
+
+/**
+ * Load the config file again and replace the config used to handle the events
+ * once the new one is compiled. The previous config is kept if the new one is
+ * invalid.
+ * See ConfigWatcherCallBack.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool reload_config(void) {
+    Config *new_config = config_load(config_path, config_required);
+    if (!new_config) {
+        log_errorf("invalid config, keeping the previous one");
+        return true;
+    }
+
+    // The actions of the pressed buttons are in the previous config.
+    for (Pad *pad = pads; pad; pad = pad->next) release_buttons(pad);
+    Config *old_config = config;
+    config = new_config;
+    if (!profile_set_config(config)) return false;
+    config_free(old_config);
+    log_debugf("config reloaded");
+
+    for (Pad *pad = pads; pad; pad = pad->next) {
+        if (!update_sticks(pad)) return false;
+    }
+
+    return output_flush();
+}
+
+/**
+ * Print the statistics of the output, of the input threads and the latencies,
+ * one line of key=value pairs each.
+ */
+static void dump_stats(void) {
+    OutputStats output_stats;
+    output_get_stats(&output_stats);
+    printf("output moves_requested=%lu moves_sent=%lu saved=%lu\n",
+           output_stats.moves_requested, output_stats.moves_sent,
+           output_stats.moves_requested - output_stats.moves_sent);
+
+    for (Pad *pad = pads; pad; pad = pad->next) {
+        if (!pad->pipeline) continue;
+
+        EventRingStats stats;
+        pipeline_get_stats(pad->pipeline, &stats);
+        printf("pipeline=%s occupancy=%zu max_occupancy=%zu capacity=%d "
+               "overruns=%lu\n", controller_get_path(pad->controller),
+               stats.occupancy, stats.max_occupancy, EVENT_RING_CAPACITY,
+               stats.overruns);
+    }
+    latency_dump();
+    fflush(stdout);
+}
+
+/**
+ * Handle the SIGINT signal (Ctrl+C) to stop the event loop, the SIGHUP signal
+ * to reload the config file, and the SIGUSR1 signal to print the statistics.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the file descriptor of the signalfd.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool handle_signal(void *data) {
+    const int signal_fd = *(int *)data;
+
+    struct signalfd_siginfo info;
+    if (read(signal_fd, &info, sizeof(info)) < 0) {
+        log_errorf("failed to read signal: %s", strerror(errno));
+        return false;
+    }
+
+    if (info.ssi_signo == SIGHUP) return reload_config();
+    if (info.ssi_signo == SIGUSR1) {
+        dump_stats();
+        return true;
+    }
+
     log_debugf("quiting...");
+    event_loop_stop();
+
+    return true;
 }
 
 int main(const int argc, char *argv[]) {
@@ -335,108 +1250,99 @@ int main(const int argc, char *argv[]) {
         return EXIT_SUCCESS;
     }
 
-    if (args.controller) {
-        controller = controller_from_device_path(args.controller);
-    } else {
-        controller = controller_from_first();
+    // Before the other threads are created, so they inherit the priority and
+    // the CPU.
+    if (args.cpu) {
+        char *end;
+        errno = 0;
+        const long cpu = strtol(args.cpu, &end, 10);
+        if (errno || end == args.cpu || *end || cpu < 0 || cpu > INT_MAX) {
+            log_errorf("invalid CPU: '%s'", args.cpu);
+            return EXIT_FAILURE;
+        }
+        if (!realtime_pin(cpu)) return EXIT_FAILURE;
     }
-    if (!controller) return EXIT_FAILURE;
+    if (args.realtime) realtime_init();
+
+    if (!event_loop_init()) return EXIT_FAILURE;
 
-    xdo = xdo_new(NULL);
-    if (!xdo) {
-        log_errorf("failed to initialize xdo");
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    if (args.latency) latency_enable();
+    if (sigprocmask(SIG_BLOCK, &signals, NULL) < 0) {
+        log_errorf("failed to block signals: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) {
+        log_errorf("failed to setup signal handler: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (!event_loop_add_fd(signal_fd, handle_signal, &signal_fd)) {
         return EXIT_FAILURE;
     }
-    log_debugf("libxdo %s", xdo_version());
 
-    uint64_t loop_start = get_time_ms();
-    uint64_t delta_time = 0;
+    if (!output_init(args.backend ? args.backend : DEFAULT_OUTPUT_BACKEND)) {
+        return EXIT_FAILURE;
+    }
 
-    uint64_t last_scroll_x = 0;
-    uint64_t last_scroll_y = 0;
+    config_required = args.config != NULL;
+    config_path = args.config ? args.config : config_get_default_path();
+    config = config_load(config_path, config_required);
+    if (!config) return EXIT_FAILURE;
+    if (!profile_init(config, set_mapping)) return EXIT_FAILURE;
+    if (config_path && !config_watcher_init(config_path, reload_config)) {
+        return EXIT_FAILURE;
+    }
 
-    float mouse_movement_x = 0.0f;
-    float mouse_movement_y = 0.0f;
+    if (args.record) {
+        record_trace = trace_create(args.record);
+        if (!record_trace) return EXIT_FAILURE;
+    }
 
-    if (signal(SIGINT, hanlde_sigint) == SIG_ERR) {
-        log_errorf("failed to setup SIGINT handler: %s", strerror(errno));
+    controller_path = args.controller;
+    threaded = args.threaded;
+    smooth_scroll = args.smooth;
+    // The devices are watched before the controllers are searched, so a
+    // controller connected in between isn't missed.
+    if (!args.replay && !device_watcher_init(handle_device)) {
         return EXIT_FAILURE;
     }
-
-    log_debugf("app ready");
-    while (!app_quit) {
-        if (!controller_update(controller, handle_button_down,
-                               handle_button_up)) {
+    if (args.replay) {
+        if (!replay_start(args.replay, args.fast)) return EXIT_FAILURE;
+    } else if (controller_path) {
+        Controller *controller = controller_from_device_path(controller_path);
+        if (!controller || !attach_controller(controller)) {
             return EXIT_FAILURE;
         }
-
-        if (controller_get_grabbed(controller)) {
-            float lx, ly;
-            controller_get_stick(controller, CONTROLLER_STICK_LEFT, &lx, &ly);
-            mouse_movement_x += lx * mouse_speed * delta_time;
-            mouse_movement_y += ly * mouse_speed * delta_time;
-            if (fabsf(mouse_movement_x) >= 1.0f ||
-                fabsf(mouse_movement_y) >= 1.0f) {
-                const int mouse_movement_x_int = (int)mouse_movement_x;
-                const int mouse_movement_y_int = (int)mouse_movement_y;
-                mouse_movement_x -= mouse_movement_x_int;
-                mouse_movement_y -= mouse_movement_y_int;
-                if (xdo_move_mouse_relative(xdo, mouse_movement_x_int,
-                                            mouse_movement_y_int)) {
-                    log_errorf("failed to move mouse");
-                }
-                log_debugf("move mouse: dx=%d dy=%d", mouse_movement_x_int,
-                           mouse_movement_y_int);
-            }
-
-            float rx, ry;
-            controller_get_stick(controller, CONTROLLER_STICK_RIGHT, &rx, &ry);
-            if (get_time_ms() - last_scroll_y > get_scroll_speed(ry)) {
-                if (ry < 0.0f) {
-                    if (xdo_click_window(xdo, CURRENTWINDOW, MOUSE_WHEEL_UP)) {
-                        log_errorf("failed to scroll up");
-                        return EXIT_FAILURE;
-                    }
-                    log_debugf("scroll up");
-                    last_scroll_y = get_time_ms();
-                } else if (ry > 0.0f) {
-                    if (xdo_click_window(xdo, CURRENTWINDOW, MOUSE_WHEEL_DOWN))
-                    {
-                        log_errorf("failed to scroll down");
-                        return EXIT_FAILURE;
-                    }
-                    log_debugf("scroll down");
-                    last_scroll_y = get_time_ms();
-                }
-            }
-            if (get_time_ms() - last_scroll_x > get_scroll_speed(rx)) {
-                if (rx < 0.0f) {
-                    if (xdo_click_window(xdo, CURRENTWINDOW, MOUSE_WHEEL_LEFT))
-                    {
-                        log_errorf("failed to scroll left");
-                        return EXIT_FAILURE;
-                    }
-                    log_debugf("scroll left");
-                    last_scroll_x = get_time_ms();
-                } else if (rx > 0.0f) {
-                    if (xdo_click_window(xdo, CURRENTWINDOW, MOUSE_WHEEL_RIGHT))
-                    {
-                        log_errorf("failed to scroll right");
-                        return EXIT_FAILURE;
-                    }
-                    log_debugf("scroll right");
-                    last_scroll_x = get_time_ms();
-                }
-            }
+    } else {
+        if (!controller_from_all(attach_controller)) return EXIT_FAILURE;
+        if (!pads) {
+            log_errorf("no controller found, waiting for one to be "
+                       "connected");
         }
-
-        const uint64_t loop_end = get_time_ms();
-        delta_time = loop_end - loop_start;
-        loop_start = loop_end;
     }
 
-    xdo_free(xdo);
-    controller_destroy(controller);
+    realtime_lock_memory();
+    log_debugf("app ready");
+    if (!event_loop_run()) return EXIT_FAILURE;
+    if (args.latency) latency_dump();
+
+    while (pads) {
+        if (!detach_pad(pads)) return EXIT_FAILURE;
+    }
+    device_watcher_quit();
+    replay_stop();
+    if (record_trace && !trace_close(record_trace)) return EXIT_FAILURE;
+    config_watcher_quit();
+    profile_quit();
+    config_free(config);
+    output_quit();
+    event_loop_quit();
+    close(signal_fd);
 
     log_debugf("quit");
 
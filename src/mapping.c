@@ -0,0 +1,44 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "config.h"
+#include "log.h"
+#include "mapping.h"
+#include "output.h"
+
+bool mapping_set_keys(Action *action, const char *keys) {
+    if (strlen(keys) >= MAPPING_KEYS_NAME_SIZE) {
+        log_errorf("keyboard shortcut too long: '%s'", keys);
+        return false;
+    }
+
+    if (!output_compile_keys(keys, &action->keys)) return false;
+    action->type = ACTION_KEYS;
+    strcpy(action->keys_name, keys);
+
+    return true;
+}
+
+bool mapping_init(Mapping *mapping) {
+    memset(mapping, 0, sizeof(*mapping));
+
+    mapping->actions[GRAB_TOGGLE_BUTTON].type = ACTION_GRAB_TOGGLE;
+    mapping->actions[MOUSE_SPEED_BUTTON].type = ACTION_MOUSE_SPEED;
+
+#define MAP(controller_button, button) {                   \
+    Action *action = &mapping->actions[controller_button]; \
+    action->type = ACTION_MOUSE_BUTTON;                    \
+    action->mouse_button = button;                         \
+}
+    MAP_BUTTON_TO_MOUSE
+#undef MAP
+
+#define MAP(controller_button, string)                                      \
+    if (!mapping_set_keys(&mapping->actions[controller_button], string)) { \
+        return false;                                                      \
+    }
+    MAP_BUTTON_TO_KEYS
+#undef MAP
+
+    return true;
+}
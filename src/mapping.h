@@ -0,0 +1,66 @@
+#pragma once
+
+/**
+ * Mapping of the controller buttons to the actions they trigger.
+ *
+ * The mapping is resolved once into a table indexed by ControllerButton, so
+ * handling a button is a single table lookup.
+ */
+
+#include <stdbool.h>
+
+#include "controller.h"
+#include "mouse_buttons.h"
+#include "output.h"
+
+#define MAPPING_KEYS_NAME_SIZE 64
+
+/**
+ * Enum representing the kinds of action a button can trigger.
+ */
+typedef enum {
+    ACTION_NONE = 0,
+    ACTION_GRAB_TOGGLE,
+    ACTION_MOUSE_SPEED,
+    ACTION_MOUSE_BUTTON,
+    ACTION_KEYS,
+} ActionType;
+
+/**
+ * An action triggered by a button.
+ */
+typedef struct {
+    ActionType type;
+    MouseButton mouse_button;  // for ACTION_MOUSE_BUTTON
+    KeySequence keys;  // for ACTION_KEYS
+    char keys_name[MAPPING_KEYS_NAME_SIZE];  // for ACTION_KEYS
+} Action;
+
+/**
+ * The actions of every controller button.
+ */
+typedef struct {
+    Action actions[CONTROLLER_BUTTON_COUNT];
+} Mapping;
+
+/**
+ * Initialize a mapping from the mappings of config.h.
+ *
+ * The output must be initialized since the keyboard shortcuts are resolved
+ * with output_compile_keys().
+ *
+ * \param mapping A pointer to the mapping to initialize.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool mapping_init(Mapping *mapping);
+
+/**
+ * Set the action of a button to a keyboard shortcut.
+ *
+ * \param action A pointer to the action of the button.
+ * \param keys A key name or a keyboard shortcut using the xdotool syntax.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool mapping_set_keys(Action *action, const char *keys);
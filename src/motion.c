@@ -0,0 +1,37 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "motion.h"
+#include "utils.h"
+
+void motion_init(Motion *motion, const uint64_t rate) {
+    assert(rate > 0 && "invalid motion rate");
+    motion->tick_duration = NS_PER_S / rate;
+    motion->last_tick = 0;
+    motion->remainder_x = 0.0;
+    motion->remainder_y = 0.0;
+}
+
+void motion_start(Motion *motion, const uint64_t now) {
+    motion->last_tick = now;
+}
+
+bool motion_update(Motion *motion, const uint64_t now, const float velocity_x,
+                   const float velocity_y, int *dx, int *dy) {
+    const uint64_t ticks = (now - motion->last_tick) / motion->tick_duration;
+    // Advance by whole ticks so the phase of the ticks never drifts.
+    motion->last_tick += ticks * motion->tick_duration;
+
+    const double elapsed = (double)(ticks * motion->tick_duration) / NS_PER_MS;
+    motion->remainder_x += velocity_x * elapsed;
+    motion->remainder_y += velocity_y * elapsed;
+
+    *dx = (int)trunc(motion->remainder_x);
+    *dy = (int)trunc(motion->remainder_y);
+    motion->remainder_x -= *dx;
+    motion->remainder_y -= *dy;
+
+    return *dx || *dy;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * Fixed-rate integration of the stick position into mouse moves.
+ *
+ * The time is split in ticks of a fixed duration. Each tick, the velocity is
+ * integrated over the tick duration and the whole pixels are returned while the
+ * sub-pixel remainder is carried to the next tick, so the speed of the mouse
+ * doesn't depend on how often the integrator is updated.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * State of a motion integrator.
+ */
+typedef struct {
+    uint64_t tick_duration;  // ns
+    uint64_t last_tick;  // ns
+    double remainder_x;
+    double remainder_y;
+} Motion;
+
+/**
+ * Initialize a motion integrator.
+ *
+ * \param motion A pointer to the motion integrator to initialize.
+ * \param rate The number of ticks per second.
+ */
+void motion_init(Motion *motion, const uint64_t rate);
+
+/**
+ * Start integrating from the given time. The ticks elapsed before are ignored
+ * but the sub-pixel remainder is kept.
+ *
+ * \param motion A pointer to the motion integrator.
+ * \param now The current time in nanoseconds.
+ */
+void motion_start(Motion *motion, const uint64_t now);
+
+/**
+ * Integrate a velocity over the ticks elapsed since the last update.
+ *
+ * \param motion A pointer to the motion integrator.
+ * \param now The current time in nanoseconds.
+ * \param velocity_x The velocity along the X axis in pixels per millisecond.
+ * \param velocity_y The velocity along the Y axis in pixels per millisecond.
+ * \param dx A pointer to an int where the whole pixels to move along the X axis
+ *           will be stored.
+ * \param dy A pointer to an int where the whole pixels to move along the Y axis
+ *           will be stored.
+ *
+ * \returns true if the mouse need to be moved.
+ */
+bool motion_update(Motion *motion, const uint64_t now, const float velocity_x,
+                   const float velocity_y, int *dx, int *dy);
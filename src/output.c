@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "latency.h"
+#include "log.h"
+#include "output.h"
+#include "output_backend.h"
+#include "utils.h"
+
+/**
+ * The backend used by the output.
+ */
+static const OutputBackend *backend = NULL;
+
+/**
+ * The mouse move and the scroll of the current frame, sent by
+ * output_flush_motion().
+ */
+static int pending_dx = 0;
+static int pending_dy = 0;
+static int pending_scroll_x = 0;
+static int pending_scroll_y = 0;
+static bool motion_pending = false;
+
+static OutputStats stats = {0};
+
+bool output_init(const char *backend_name) {
+#define OUTPUT_BACKEND(name, output_backend) \
+    if (streq(backend_name, #name)) backend = &output_backend;
+    OUTPUT_BACKENDS
+#undef OUTPUT_BACKEND
+
+    if (!backend) {
+        log_errorf("unknown output backend: '%s'", backend_name);
+        return false;
+    }
+    log_debugf("output backend: %s", backend_name);
+
+    if (!backend->init()) {
+        backend = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void output_quit(void) {
+#ifndef PROD
+    log_debugf("mouse moves: requested=%lu sent=%lu saved=%lu",
+               stats.moves_requested, stats.moves_sent,
+               stats.moves_requested - stats.moves_sent);
+#endif
+
+    if (backend) backend->quit();
+    backend = NULL;
+    pending_dx = pending_dy = 0;
+    pending_scroll_x = pending_scroll_y = 0;
+    motion_pending = false;
+}
+
+/**
+ * Send the mouse move and the scroll accumulated since the last ones in a
+ * single call to the backend each.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool output_flush_motion(void) {
+    if (!motion_pending) return true;
+    motion_pending = false;
+
+    if (pending_dx || pending_dy) {
+        const int dx = pending_dx, dy = pending_dy;
+        pending_dx = pending_dy = 0;
+        ++stats.moves_sent;
+        if (!backend->move_mouse(dx, dy)) return false;
+    }
+
+    if (pending_scroll_x || pending_scroll_y) {
+        const int dx = pending_scroll_x, dy = pending_scroll_y;
+        pending_scroll_x = pending_scroll_y = 0;
+        if (!backend->scroll(dx, dy)) return false;
+    }
+
+    return true;
+}
+
+bool output_move_mouse(const int dx, const int dy) {
+    assert(backend && "output hasn't been initialized");
+    pending_dx += dx;
+    pending_dy += dy;
+    motion_pending = true;
+    ++stats.moves_requested;
+    return true;
+}
+
+bool output_scroll(const int dx, const int dy) {
+    assert(backend && "output hasn't been initialized");
+    pending_scroll_x += dx;
+    pending_scroll_y += dy;
+    motion_pending = true;
+    return true;
+}
+
+bool output_mouse_down(const MouseButton button) {
+    assert(backend && "output hasn't been initialized");
+    // The button must be pressed where the mouse was moved.
+    return output_flush_motion() && backend->mouse_down(button);
+}
+
+bool output_mouse_up(const MouseButton button) {
+    assert(backend && "output hasn't been initialized");
+    return output_flush_motion() && backend->mouse_up(button);
+}
+
+bool output_mouse_click(const MouseButton button) {
+    assert(backend && "output hasn't been initialized");
+    return output_flush_motion() && backend->mouse_click(button);
+}
+
+bool output_compile_keys(const char *keys, KeySequence *sequence) {
+    assert(backend && "output hasn't been initialized");
+    return backend->compile_keys(keys, sequence);
+}
+
+bool output_keys_down(const KeySequence *sequence) {
+    assert(backend && "output hasn't been initialized");
+    // The keys must be pressed after the earlier mouse moves.
+    return output_flush_motion() && backend->keys_down(sequence);
+}
+
+bool output_keys_up(const KeySequence *sequence) {
+    assert(backend && "output hasn't been initialized");
+    return output_flush_motion() && backend->keys_up(sequence);
+}
+
+bool output_flush(void) {
+    assert(backend && "output hasn't been initialized");
+    if (!output_flush_motion() || !backend->flush()) return false;
+
+    // The outputs of the frame are sent.
+    latency_flush();
+    return true;
+}
+
+void output_get_stats(OutputStats *output_stats) {
+    *output_stats = stats;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+/**
+ * Output of the application: mouse moves, mouse buttons and keyboard keys sent
+ * to the desktop through an output backend selected at runtime.
+ *
+ * The output functions may buffer their events until output_flush() is called,
+ * so every output of a frame must be followed by a call to output_flush(). The
+ * mouse moves of a frame are coalesced into a single move.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mouse_buttons.h"
+
+#define OUTPUT_KEYS_MAX 8
+
+/**
+ * Number of high-resolution scroll units of a mouse wheel notch, like
+ * REL_WHEEL_HI_RES.
+ */
+#define OUTPUT_SCROLL_NOTCH 120
+
+/**
+ * A keyboard shortcut resolved to the key codes of the output backend, in the
+ * order the keys are pressed.
+ *
+ * The symbols, the modifiers and the keymap are only used by the backends
+ * whose key codes depend on the keyboard mapping of the desktop, to resolve the
+ * keys again after the mapping changes.
+ */
+typedef struct {
+    uint16_t codes[OUTPUT_KEYS_MAX];  // 0 if the key isn't in the mapping.
+    uint16_t modifiers[OUTPUT_KEYS_MAX];  // Modifier mask to send with a key.
+    uint32_t symbols[OUTPUT_KEYS_MAX];
+    uint32_t keymap;  // Version of the keyboard mapping of the codes.
+    uint8_t count;
+} KeySequence;
+
+/**
+ * Statistics of the output.
+ */
+typedef struct {
+    uint64_t moves_requested;  // Calls to output_move_mouse().
+    uint64_t moves_sent;  // Mouse moves sent to the backend.
+} OutputStats;
+
+/**
+ * Initialize the output with the given backend.
+ *
+ * \param backend_name The name of the backend to use.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_init(const char *backend_name);
+
+/**
+ * Free the resources used by the output backend.
+ */
+void output_quit(void);
+
+/**
+ * Move the mouse relatively to its current position. The move is sent with the
+ * other moves of the frame on the next output_flush(), or before the next
+ * mouse button or key event.
+ *
+ * \param dx The number of pixels to move along the X axis.
+ * \param dy The number of pixels to move along the Y axis.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_move_mouse(const int dx, const int dy);
+
+/**
+ * Scroll by a number of high-resolution units. The scroll is sent with the
+ * other moves of the frame like output_move_mouse().
+ *
+ * \param dx The number of units to scroll to the right, 1/OUTPUT_SCROLL_NOTCH
+ *           of a notch each.
+ * \param dy The number of units to scroll down, 1/OUTPUT_SCROLL_NOTCH of a
+ *           notch each.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_scroll(const int dx, const int dy);
+
+/**
+ * Press a mouse button.
+ *
+ * \param button The mouse button to press.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_mouse_down(const MouseButton button);
+
+/**
+ * Release a mouse button.
+ *
+ * \param button The mouse button to release.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_mouse_up(const MouseButton button);
+
+/**
+ * Press and release a mouse button.
+ *
+ * \param button The mouse button to click.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_mouse_click(const MouseButton button);
+
+/**
+ * Resolve a keyboard shortcut to the key codes of the output backend, so it
+ * can be pressed without parsing it again.
+ *
+ * \param keys A key name or a keyboard shortcut using the xdotool syntax
+ *             (example: "Super+Control+h").
+ * \param sequence A pointer to the KeySequence where the key codes will be
+ *                 stored.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_compile_keys(const char *keys, KeySequence *sequence);
+
+/**
+ * Press the keys of a keyboard shortcut.
+ *
+ * \param sequence The keyboard shortcut resolved by output_compile_keys().
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_keys_down(const KeySequence *sequence);
+
+/**
+ * Release the keys of a keyboard shortcut in the reverse order they were
+ * pressed.
+ *
+ * \param sequence The keyboard shortcut resolved by output_compile_keys().
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_keys_up(const KeySequence *sequence);
+
+/**
+ * Send the buffered events of the current frame.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool output_flush(void);
+
+/**
+ * Get the statistics of the output. The difference between the requested and
+ * the sent mouse moves is the number of calls to the backend saved by
+ * coalescing them.
+ *
+ * \param stats A pointer to the OutputStats where the statistics will be
+ *              stored.
+ */
+void output_get_stats(OutputStats *stats);
@@ -0,0 +1,41 @@
+#pragma once
+
+/**
+ * Interface implemented by the output backends.
+ * See output.h for the documentation of each function.
+ */
+
+#include <stdbool.h>
+
+#include "mouse_buttons.h"
+#include "output.h"
+
+/**
+ * List of the output backends. The first parameter is the name of the backend
+ * used on the command-line and the second one is the OutputBackend
+ * implementing it.
+ */
+#define OUTPUT_BACKENDS                        \
+    OUTPUT_BACKEND(xdo, output_backend_xdo)    \
+    OUTPUT_BACKEND(uinput, output_backend_uinput)
+
+/**
+ * Functions implemented by an output backend.
+ */
+typedef struct {
+    bool (*init)(void);
+    void (*quit)(void);
+    bool (*move_mouse)(const int dx, const int dy);
+    bool (*scroll)(const int dx, const int dy);
+    bool (*mouse_down)(const MouseButton button);
+    bool (*mouse_up)(const MouseButton button);
+    bool (*mouse_click)(const MouseButton button);
+    bool (*compile_keys)(const char *keys, KeySequence *sequence);
+    bool (*keys_down)(const KeySequence *sequence);
+    bool (*keys_up)(const KeySequence *sequence);
+    bool (*flush)(void);
+} OutputBackend;
+
+#define OUTPUT_BACKEND(name, backend) extern const OutputBackend backend;
+    OUTPUT_BACKENDS
+#undef OUTPUT_BACKEND
@@ -0,0 +1,514 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <linux/uinput.h>
+
+#include "log.h"
+#include "mouse_buttons.h"
+#include "output_backend.h"
+#include "utils.h"
+
+#define UINPUT_PATH "/dev/uinput"
+#define UINPUT_DEVICE_NAME "desktop-controller virtual input"
+#define UINPUT_BUFFER_SIZE 64
+#define UINPUT_KEY_NAME_SIZE 32
+
+/**
+ * Mapping of the X keysym names used in keyboard shortcuts to the Linux key
+ * codes.
+ */
+#define KEY_NAMES                                         \
+    KEY_NAME("a", KEY_A) KEY_NAME("b", KEY_B)             \
+    KEY_NAME("c", KEY_C) KEY_NAME("d", KEY_D)             \
+    KEY_NAME("e", KEY_E) KEY_NAME("f", KEY_F)             \
+    KEY_NAME("g", KEY_G) KEY_NAME("h", KEY_H)             \
+    KEY_NAME("i", KEY_I) KEY_NAME("j", KEY_J)             \
+    KEY_NAME("k", KEY_K) KEY_NAME("l", KEY_L)             \
+    KEY_NAME("m", KEY_M) KEY_NAME("n", KEY_N)             \
+    KEY_NAME("o", KEY_O) KEY_NAME("p", KEY_P)             \
+    KEY_NAME("q", KEY_Q) KEY_NAME("r", KEY_R)             \
+    KEY_NAME("s", KEY_S) KEY_NAME("t", KEY_T)             \
+    KEY_NAME("u", KEY_U) KEY_NAME("v", KEY_V)             \
+    KEY_NAME("w", KEY_W) KEY_NAME("x", KEY_X)             \
+    KEY_NAME("y", KEY_Y) KEY_NAME("z", KEY_Z)             \
+    KEY_NAME("0", KEY_0) KEY_NAME("1", KEY_1)             \
+    KEY_NAME("2", KEY_2) KEY_NAME("3", KEY_3)             \
+    KEY_NAME("4", KEY_4) KEY_NAME("5", KEY_5)             \
+    KEY_NAME("6", KEY_6) KEY_NAME("7", KEY_7)             \
+    KEY_NAME("8", KEY_8) KEY_NAME("9", KEY_9)             \
+    KEY_NAME("F1", KEY_F1) KEY_NAME("F2", KEY_F2)         \
+    KEY_NAME("F3", KEY_F3) KEY_NAME("F4", KEY_F4)         \
+    KEY_NAME("F5", KEY_F5) KEY_NAME("F6", KEY_F6)         \
+    KEY_NAME("F7", KEY_F7) KEY_NAME("F8", KEY_F8)         \
+    KEY_NAME("F9", KEY_F9) KEY_NAME("F10", KEY_F10)       \
+    KEY_NAME("F11", KEY_F11) KEY_NAME("F12", KEY_F12)     \
+    KEY_NAME("Escape", KEY_ESC)                           \
+    KEY_NAME("Return", KEY_ENTER)                         \
+    KEY_NAME("Tab", KEY_TAB)                              \
+    KEY_NAME("BackSpace", KEY_BACKSPACE)                  \
+    KEY_NAME("space", KEY_SPACE)                          \
+    KEY_NAME("Delete", KEY_DELETE)                        \
+    KEY_NAME("Insert", KEY_INSERT)                        \
+    KEY_NAME("Home", KEY_HOME)                            \
+    KEY_NAME("End", KEY_END)                              \
+    KEY_NAME("Prior", KEY_PAGEUP)                         \
+    KEY_NAME("Page_Up", KEY_PAGEUP)                       \
+    KEY_NAME("Next", KEY_PAGEDOWN)                        \
+    KEY_NAME("Page_Down", KEY_PAGEDOWN)                   \
+    KEY_NAME("Left", KEY_LEFT)                            \
+    KEY_NAME("Right", KEY_RIGHT)                          \
+    KEY_NAME("Up", KEY_UP)                                \
+    KEY_NAME("Down", KEY_DOWN)                            \
+    KEY_NAME("Print", KEY_SYSRQ)                          \
+    KEY_NAME("Menu", KEY_COMPOSE)                         \
+    KEY_NAME("Caps_Lock", KEY_CAPSLOCK)                   \
+    KEY_NAME("minus", KEY_MINUS)                          \
+    KEY_NAME("equal", KEY_EQUAL)                          \
+    KEY_NAME("comma", KEY_COMMA)                          \
+    KEY_NAME("period", KEY_DOT)                           \
+    KEY_NAME("slash", KEY_SLASH)                          \
+    KEY_NAME("backslash", KEY_BACKSLASH)                  \
+    KEY_NAME("semicolon", KEY_SEMICOLON)                  \
+    KEY_NAME("apostrophe", KEY_APOSTROPHE)                \
+    KEY_NAME("grave", KEY_GRAVE)                          \
+    KEY_NAME("bracketleft", KEY_LEFTBRACE)                \
+    KEY_NAME("bracketright", KEY_RIGHTBRACE)              \
+    KEY_NAME("Shift_L", KEY_LEFTSHIFT)                    \
+    KEY_NAME("Shift_R", KEY_RIGHTSHIFT)                   \
+    KEY_NAME("Control_L", KEY_LEFTCTRL)                   \
+    KEY_NAME("Control_R", KEY_RIGHTCTRL)                  \
+    KEY_NAME("Alt_L", KEY_LEFTALT)                        \
+    KEY_NAME("Alt_R", KEY_RIGHTALT)                       \
+    KEY_NAME("Meta_L", KEY_LEFTMETA)                      \
+    KEY_NAME("Super_L", KEY_LEFTMETA)                     \
+    KEY_NAME("Super_R", KEY_RIGHTMETA)                    \
+    KEY_NAME("XF86AudioPlay", KEY_PLAYPAUSE)              \
+    KEY_NAME("XF86AudioPause", KEY_PAUSECD)               \
+    KEY_NAME("XF86AudioStop", KEY_STOPCD)                 \
+    KEY_NAME("XF86AudioNext", KEY_NEXTSONG)               \
+    KEY_NAME("XF86AudioPrev", KEY_PREVIOUSSONG)           \
+    KEY_NAME("XF86AudioMute", KEY_MUTE)                   \
+    KEY_NAME("XF86AudioMicMute", KEY_MICMUTE)             \
+    KEY_NAME("XF86AudioRaiseVolume", KEY_VOLUMEUP)        \
+    KEY_NAME("XF86AudioLowerVolume", KEY_VOLUMEDOWN)      \
+    KEY_NAME("XF86MonBrightnessUp", KEY_BRIGHTNESSUP)     \
+    KEY_NAME("XF86MonBrightnessDown", KEY_BRIGHTNESSDOWN) \
+    KEY_NAME("XF86Back", KEY_BACK)                        \
+    KEY_NAME("XF86Forward", KEY_FORWARD)
+
+/**
+ * Mapping of the X keysym names on the second level of the keys of a US
+ * layout to the Linux key codes of the keys, typed with Shift. The uppercase
+ * letters are typed with Shift as well.
+ */
+#define SHIFTED_KEY_NAMES                  \
+    KEY_NAME("exclam", KEY_1)              \
+    KEY_NAME("at", KEY_2)                  \
+    KEY_NAME("numbersign", KEY_3)          \
+    KEY_NAME("dollar", KEY_4)              \
+    KEY_NAME("percent", KEY_5)             \
+    KEY_NAME("asciicircum", KEY_6)         \
+    KEY_NAME("ampersand", KEY_7)           \
+    KEY_NAME("asterisk", KEY_8)            \
+    KEY_NAME("parenleft", KEY_9)           \
+    KEY_NAME("parenright", KEY_0)          \
+    KEY_NAME("underscore", KEY_MINUS)      \
+    KEY_NAME("plus", KEY_EQUAL)            \
+    KEY_NAME("less", KEY_COMMA)            \
+    KEY_NAME("greater", KEY_DOT)           \
+    KEY_NAME("question", KEY_SLASH)        \
+    KEY_NAME("bar", KEY_BACKSLASH)         \
+    KEY_NAME("colon", KEY_SEMICOLON)       \
+    KEY_NAME("quotedbl", KEY_APOSTROPHE)   \
+    KEY_NAME("asciitilde", KEY_GRAVE)      \
+    KEY_NAME("braceleft", KEY_LEFTBRACE)   \
+    KEY_NAME("braceright", KEY_RIGHTBRACE) \
+    KEY_NAME("ISO_Left_Tab", KEY_TAB)
+
+/**
+ * Aliases of the modifiers accepted by xdotool. They are not case sensitive.
+ */
+#define KEY_ALIASES                    \
+    KEY_ALIAS("alt", KEY_LEFTALT)      \
+    KEY_ALIAS("ctrl", KEY_LEFTCTRL)    \
+    KEY_ALIAS("control", KEY_LEFTCTRL) \
+    KEY_ALIAS("meta", KEY_LEFTMETA)    \
+    KEY_ALIAS("super", KEY_LEFTMETA)   \
+    KEY_ALIAS("shift", KEY_LEFTSHIFT)
+
+static int uinput_fd = -1;
+
+/**
+ * Events of the current frame, written at once by output_uinput_flush().
+ */
+static struct input_event buffer[UINPUT_BUFFER_SIZE];
+static size_t buffer_size = 0;
+
+/**
+ * High-resolution scroll not yet sent as a REL_WHEEL or REL_HWHEEL notch, for
+ * the applications that don't support REL_WHEEL_HI_RES.
+ */
+static int scroll_remainder_x = 0;
+static int scroll_remainder_y = 0;
+
+static bool output_uinput_flush(void);
+
+/**
+ * Check if the events of the current frame press a key.
+ *
+ * \param code The code of the key.
+ *
+ * \returns true if the key is pressed in the current frame, or false otherwise.
+ */
+static bool output_uinput_is_pending_press(const uint16_t code) {
+    for (size_t i = 0; i < buffer_size; ++i) {
+        if (buffer[i].type == EV_KEY && buffer[i].code == code &&
+            buffer[i].value) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Append an event to the events of the current frame.
+ *
+ * \param type The type of the event.
+ * \param code The code of the event.
+ * \param value The value of the event.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool output_uinput_emit(const uint16_t type, const uint16_t code,
+                               const int32_t value) {
+    // Keep a slot for the SYN_REPORT ending the frame. A key pressed and
+    // released in the same frame would be ignored by libinput, so the release
+    // starts a new frame.
+    if (
+        (buffer_size == UINPUT_BUFFER_SIZE - 1 ||
+         (type == EV_KEY && !value && output_uinput_is_pending_press(code))) &&
+        !output_uinput_flush()
+    ) {
+        return false;
+    }
+
+    struct input_event *event = &buffer[buffer_size++];
+    memset(event, 0, sizeof(*event));
+    event->type = type;
+    event->code = code;
+    event->value = value;
+
+    return true;
+}
+
+static bool output_uinput_flush(void) {
+    if (!buffer_size) return true;
+
+    struct input_event *syn = &buffer[buffer_size++];
+    memset(syn, 0, sizeof(*syn));
+    syn->type = EV_SYN;
+    syn->code = SYN_REPORT;
+
+    const size_t size = buffer_size * sizeof(*buffer);
+    buffer_size = 0;
+    if (write(uinput_fd, buffer, size) != (ssize_t)size) {
+        log_errorf("failed to write events to " UINPUT_PATH ": %s",
+                   strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Enable an event code on the uinput device.
+ *
+ * \param request The ioctl request to enable the code (example: UI_SET_KEYBIT).
+ * \param code The code to enable.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool output_uinput_enable(const unsigned long request, const int code) {
+    if (ioctl(uinput_fd, request, code) < 0) {
+        log_errorf("failed to enable event code %d on the uinput device: %s",
+                   code, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+static bool output_uinput_init(void) {
+    uinput_fd = open(UINPUT_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (uinput_fd < 0) {
+        log_errorf("failed to open " UINPUT_PATH ": %s", strerror(errno));
+        return false;
+    }
+
+    bool success = (
+        output_uinput_enable(UI_SET_EVBIT, EV_SYN) &&
+        output_uinput_enable(UI_SET_EVBIT, EV_KEY) &&
+        output_uinput_enable(UI_SET_EVBIT, EV_REL) &&
+        output_uinput_enable(UI_SET_RELBIT, REL_X) &&
+        output_uinput_enable(UI_SET_RELBIT, REL_Y) &&
+        output_uinput_enable(UI_SET_RELBIT, REL_WHEEL) &&
+        output_uinput_enable(UI_SET_RELBIT, REL_HWHEEL) &&
+        output_uinput_enable(UI_SET_RELBIT, REL_WHEEL_HI_RES) &&
+        output_uinput_enable(UI_SET_RELBIT, REL_HWHEEL_HI_RES) &&
+        output_uinput_enable(UI_SET_KEYBIT, BTN_LEFT) &&
+        output_uinput_enable(UI_SET_KEYBIT, BTN_MIDDLE) &&
+        output_uinput_enable(UI_SET_KEYBIT, BTN_RIGHT)
+    );
+    for (int key = KEY_ESC; success && key < BTN_MISC; ++key) {
+        success = output_uinput_enable(UI_SET_KEYBIT, key);
+    }
+    if (!success) {
+        close(uinput_fd);
+        return false;
+    }
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    strncpy(setup.name, UINPUT_DEVICE_NAME, UINPUT_MAX_NAME_SIZE - 1);
+    if (ioctl(uinput_fd, UI_DEV_SETUP, &setup) < 0 ||
+        ioctl(uinput_fd, UI_DEV_CREATE) < 0) {
+        log_errorf("failed to create the uinput device: %s", strerror(errno));
+        close(uinput_fd);
+        return false;
+    }
+    log_debugf("created uinput device '" UINPUT_DEVICE_NAME "'");
+
+    return true;
+}
+
+static void output_uinput_quit(void) {
+    ioctl(uinput_fd, UI_DEV_DESTROY);
+    close(uinput_fd);
+    uinput_fd = -1;
+    scroll_remainder_x = scroll_remainder_y = 0;
+}
+
+static bool output_uinput_move_mouse(const int dx, const int dy) {
+    return (
+        (!dx || output_uinput_emit(EV_REL, REL_X, dx)) &&
+        (!dy || output_uinput_emit(EV_REL, REL_Y, dy))
+    );
+}
+
+/**
+ * Emit a high-resolution scroll along a wheel axis, followed by the notches it
+ * completes like a mouse with a high-resolution wheel.
+ *
+ * \param code_hi_res The code of the high-resolution wheel axis.
+ * \param code The code of the wheel axis.
+ * \param value The number of high-resolution units to scroll.
+ * \param remainder A pointer to the units of the axis not yet sent as a notch.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool output_uinput_scroll_axis(const uint16_t code_hi_res,
+                                      const uint16_t code, const int value,
+                                      int *remainder) {
+    if (!value) return true;
+    if (!output_uinput_emit(EV_REL, code_hi_res, value)) return false;
+
+    *remainder += value;
+    const int notches = *remainder / OUTPUT_SCROLL_NOTCH;
+    if (!notches) return true;
+    *remainder -= notches * OUTPUT_SCROLL_NOTCH;
+    return output_uinput_emit(EV_REL, code, notches);
+}
+
+static bool output_uinput_scroll(const int dx, const int dy) {
+    // The vertical wheel axis is positive when scrolling up.
+    return (
+        output_uinput_scroll_axis(REL_HWHEEL_HI_RES, REL_HWHEEL, dx,
+                                  &scroll_remainder_x) &&
+        output_uinput_scroll_axis(REL_WHEEL_HI_RES, REL_WHEEL, -dy,
+                                  &scroll_remainder_y)
+    );
+}
+
+/**
+ * Get the Linux button code of a mouse button.
+ *
+ * \param button The mouse button. It must not be a mouse wheel button.
+ *
+ * \returns the button code.
+ */
+static uint16_t mouse_button_code(const MouseButton button) {
+    if (button == MOUSE_MIDDLE) return BTN_MIDDLE;
+    if (button == MOUSE_RIGHT) return BTN_RIGHT;
+    return BTN_LEFT;
+}
+
+/**
+ * Emit a mouse wheel notch.
+ *
+ * \param button The mouse wheel button.
+ *
+ * \returns true if the button is a mouse wheel button and the event was
+ *          emitted, false otherwise.
+ */
+static bool output_uinput_wheel(const MouseButton button) {
+    if (button == MOUSE_WHEEL_UP) {
+        return output_uinput_emit(EV_REL, REL_WHEEL, 1);
+    }
+    if (button == MOUSE_WHEEL_DOWN) {
+        return output_uinput_emit(EV_REL, REL_WHEEL, -1);
+    }
+    if (button == MOUSE_WHEEL_LEFT) {
+        return output_uinput_emit(EV_REL, REL_HWHEEL, -1);
+    }
+    if (button == MOUSE_WHEEL_RIGHT) {
+        return output_uinput_emit(EV_REL, REL_HWHEEL, 1);
+    }
+    return false;
+}
+
+static bool output_uinput_mouse_down(const MouseButton button) {
+    if (button >= MOUSE_WHEEL_UP) return output_uinput_wheel(button);
+    return output_uinput_emit(EV_KEY, mouse_button_code(button), 1);
+}
+
+static bool output_uinput_mouse_up(const MouseButton button) {
+    // A mouse wheel notch is emitted when the button is pressed.
+    if (button >= MOUSE_WHEEL_UP) return true;
+    return output_uinput_emit(EV_KEY, mouse_button_code(button), 0);
+}
+
+static bool output_uinput_mouse_click(const MouseButton button) {
+    return output_uinput_mouse_down(button) && output_uinput_mouse_up(button);
+}
+
+/**
+ * Get the Linux key code of a key name.
+ *
+ * \param name A X keysym name or a modifier alias accepted by xdotool.
+ * \param shifted A pointer set to true if the key must be typed with Shift.
+ *
+ * \returns the key code, or KEY_RESERVED if the key is unknown.
+ */
+static uint16_t key_code_from_name(const char *name, bool *shifted) {
+    *shifted = false;
+#define KEY_ALIAS(alias, code) if (strcasecmp(name, alias) == 0) return code;
+    KEY_ALIASES
+#undef KEY_ALIAS
+#define KEY_NAME(key_name, code) if (streq(name, key_name)) return code;
+    KEY_NAMES
+#undef KEY_NAME
+
+    *shifted = true;
+#define KEY_NAME(key_name, code) if (streq(name, key_name)) return code;
+    SHIFTED_KEY_NAMES
+#undef KEY_NAME
+    if (name[0] && !name[1] && name[0] >= 'A' && name[0] <= 'Z') {
+        const char lower_name[] = {name[0] - 'A' + 'a', '\0'};
+        bool lower_shifted;
+        return key_code_from_name(lower_name, &lower_shifted);
+    }
+    return KEY_RESERVED;
+}
+
+/**
+ * Check if a keyboard shortcut presses a key.
+ *
+ * \param sequence The keyboard shortcut.
+ * \param code The key code.
+ *
+ * \returns true if the key is in the shortcut.
+ */
+static bool key_sequence_has(const KeySequence *sequence,
+                             const uint16_t code) {
+    for (uint8_t i = 0; i < sequence->count; ++i) {
+        if (sequence->codes[i] == code) return true;
+    }
+
+    return false;
+}
+
+static bool output_uinput_compile_keys(const char *keys,
+                                       KeySequence *sequence) {
+    memset(sequence, 0, sizeof(*sequence));
+    for (const char *key = keys; *key;) {
+        const size_t key_size = strcspn(key, "+");
+        if (key_size == 0 || key_size >= UINPUT_KEY_NAME_SIZE) {
+            log_errorf("invalid key in '%s'", keys);
+            return false;
+        }
+
+        char key_name[UINPUT_KEY_NAME_SIZE];
+        memcpy(key_name, key, key_size);
+        key_name[key_size] = '\0';
+        bool shifted;
+        const uint16_t code = key_code_from_name(key_name, &shifted);
+        if (code == KEY_RESERVED) {
+            log_errorf("key '%s' in '%s' can't be typed with the uinput "
+                       "backend", key_name, keys);
+            return false;
+        }
+
+        // A second-level key is typed with Shift, like the ShiftMask of the
+        // xdo backend.
+        const bool add_shift = (
+            shifted && !key_sequence_has(sequence, KEY_LEFTSHIFT)
+        );
+        if (sequence->count + add_shift + 1 > OUTPUT_KEYS_MAX) {
+            log_errorf("too many keys in '%s'", keys);
+            return false;
+        }
+        if (add_shift) sequence->codes[sequence->count++] = KEY_LEFTSHIFT;
+        sequence->codes[sequence->count++] = code;
+
+        key += key_size;
+        if (*key == '+') ++key;
+    }
+
+    if (!sequence->count) {
+        log_errorf("no key in '%s'", keys);
+        return false;
+    }
+
+    return true;
+}
+
+static bool output_uinput_keys_down(const KeySequence *sequence) {
+    for (uint8_t i = 0; i < sequence->count; ++i) {
+        if (!output_uinput_emit(EV_KEY, sequence->codes[i], 1)) return false;
+    }
+
+    return true;
+}
+
+static bool output_uinput_keys_up(const KeySequence *sequence) {
+    for (uint8_t i = sequence->count; i > 0; --i) {
+        if (!output_uinput_emit(EV_KEY, sequence->codes[i - 1], 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const OutputBackend output_backend_uinput = {
+    .init = output_uinput_init,
+    .quit = output_uinput_quit,
+    .move_mouse = output_uinput_move_mouse,
+    .scroll = output_uinput_scroll,
+    .mouse_down = output_uinput_mouse_down,
+    .mouse_up = output_uinput_mouse_up,
+    .mouse_click = output_uinput_mouse_click,
+    .compile_keys = output_uinput_compile_keys,
+    .keys_down = output_uinput_keys_down,
+    .keys_up = output_uinput_keys_up,
+    .flush = output_uinput_flush,
+};
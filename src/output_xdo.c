@@ -0,0 +1,314 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include <X11/XKBlib.h>
+#include <X11/Xlib.h>
+#include <xdo.h>
+
+#include "log.h"
+#include "mouse_buttons.h"
+#include "output.h"
+#include "output_backend.h"
+
+#define XDO_KEY_NAME_SIZE 64
+
+/**
+ * Aliases of the modifiers accepted by xdotool. They are not case sensitive.
+ */
+#define KEY_ALIASES                   \
+    KEY_ALIAS("alt", "Alt_L")         \
+    KEY_ALIAS("ctrl", "Control_L")    \
+    KEY_ALIAS("control", "Control_L") \
+    KEY_ALIAS("meta", "Meta_L")       \
+    KEY_ALIAS("super", "Super_L")     \
+    KEY_ALIAS("shift", "Shift_L")
+
+static xdo_t *xdo = NULL;
+
+/**
+ * Version of the keyboard mapping, incremented on every MappingNotify.
+ */
+static uint32_t keymap = 0;
+
+/**
+ * High-resolution scroll not yet sent as a mouse wheel click.
+ */
+static int scroll_remainder_x = 0;
+static int scroll_remainder_y = 0;
+
+static bool output_xdo_init(void) {
+    xdo = xdo_new(NULL);
+    if (!xdo) {
+        log_errorf("failed to initialize xdo");
+        return false;
+    }
+    log_debugf("libxdo %s", xdo_version());
+
+    return true;
+}
+
+static void output_xdo_quit(void) {
+    xdo_free(xdo);
+    xdo = NULL;
+    scroll_remainder_x = scroll_remainder_y = 0;
+}
+
+static bool output_xdo_move_mouse(const int dx, const int dy) {
+    assert(xdo && "xdo isn't initialized");
+    if (xdo_move_mouse_relative(xdo, dx, dy)) {
+        log_errorf("failed to move mouse");
+        return false;
+    }
+
+    return true;
+}
+
+static bool output_xdo_mouse_down(const MouseButton button) {
+    assert(xdo && "xdo isn't initialized");
+    if (xdo_mouse_down(xdo, CURRENTWINDOW, button)) {
+        log_errorf("failed to set mouse button %s down",
+                   mouse_button_to_string(button));
+        return false;
+    }
+
+    return true;
+}
+
+static bool output_xdo_mouse_up(const MouseButton button) {
+    assert(xdo && "xdo isn't initialized");
+    if (xdo_mouse_up(xdo, CURRENTWINDOW, button)) {
+        log_errorf("failed to set mouse button %s up",
+                   mouse_button_to_string(button));
+        return false;
+    }
+
+    return true;
+}
+
+static bool output_xdo_mouse_click(const MouseButton button) {
+    assert(xdo && "xdo isn't initialized");
+    if (xdo_click_window(xdo, CURRENTWINDOW, button)) {
+        log_errorf("failed to click mouse button %s",
+                   mouse_button_to_string(button));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Click a mouse wheel button for each notch completed by a high-resolution
+ * scroll along an axis.
+ *
+ * \param value The number of high-resolution units to scroll.
+ * \param remainder A pointer to the units of the axis not yet sent as a click.
+ * \param button_negative The mouse wheel button of the negative direction.
+ * \param button_positive The mouse wheel button of the positive direction.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool output_xdo_scroll_axis(const int value, int *remainder,
+                                   const MouseButton button_negative,
+                                   const MouseButton button_positive) {
+    *remainder += value;
+    while (*remainder >= OUTPUT_SCROLL_NOTCH) {
+        if (!output_xdo_mouse_click(button_positive)) return false;
+        *remainder -= OUTPUT_SCROLL_NOTCH;
+    }
+    while (*remainder <= -OUTPUT_SCROLL_NOTCH) {
+        if (!output_xdo_mouse_click(button_negative)) return false;
+        *remainder += OUTPUT_SCROLL_NOTCH;
+    }
+
+    return true;
+}
+
+/**
+ * XTest can't send the smooth scrolling valuators of XInput2, so the scroll is
+ * sent as mouse wheel clicks once a notch is completed.
+ */
+static bool output_xdo_scroll(const int dx, const int dy) {
+    return (
+        output_xdo_scroll_axis(dx, &scroll_remainder_x, MOUSE_WHEEL_LEFT,
+                               MOUSE_WHEEL_RIGHT) &&
+        output_xdo_scroll_axis(dy, &scroll_remainder_y, MOUSE_WHEEL_UP,
+                               MOUSE_WHEEL_DOWN)
+    );
+}
+
+/**
+ * Process the MappingNotify events received since the last call, so the keys
+ * are resolved with the current keyboard mapping.
+ */
+static void output_xdo_update_keymap(void) {
+    XEvent event;
+    while (XCheckTypedEvent(xdo->xdpy, MappingNotify, &event)) {
+        XRefreshKeyboardMapping(&event.xmapping);
+        if (event.xmapping.request != MappingPointer) {
+            ++keymap;
+            log_debugf("keyboard mapping changed");
+        }
+    }
+}
+
+/**
+ * Resolve a keysym to a keycode of the X server like xdo does: the keycode
+ * whose first level has the keysym, or the one whose second level has it with
+ * the Shift modifier. A keysym missing from the keyboard mapping is bound to a
+ * spare keycode by xdo_send_keysequence_window_list_do() when it's sent.
+ *
+ * \param keysym The keysym to resolve.
+ * \param key A pointer to the charcodemap_t where the key will be stored.
+ */
+static void output_xdo_resolve_key(const KeySym keysym, charcodemap_t *key) {
+    memset(key, 0, sizeof(*key));
+    key->symbol = keysym;
+
+    const KeyCode code = XKeysymToKeycode(xdo->xdpy, keysym);
+    if (code) {
+        if (XkbKeycodeToKeysym(xdo->xdpy, code, 0, 0) == keysym) {
+            key->code = code;
+            return;
+        }
+        if (XkbKeycodeToKeysym(xdo->xdpy, code, 0, 1) == keysym) {
+            key->code = code;
+            key->modmask = ShiftMask;
+            return;
+        }
+    }
+
+    key->needs_binding = 1;
+}
+
+/**
+ * Get the keysym of a key name.
+ *
+ * \param name A X keysym name or a modifier alias accepted by xdotool.
+ *
+ * \returns the keysym, or NoSymbol if the name is unknown.
+ */
+static KeySym keysym_from_name(const char *name) {
+#define KEY_ALIAS(alias, keysym_name) \
+    if (strcasecmp(name, alias) == 0) name = keysym_name;
+    KEY_ALIASES
+#undef KEY_ALIAS
+
+    return XStringToKeysym(name);
+}
+
+static bool output_xdo_compile_keys(const char *keys, KeySequence *sequence) {
+    assert(xdo && "xdo isn't initialized");
+    output_xdo_update_keymap();
+
+    memset(sequence, 0, sizeof(*sequence));
+    sequence->keymap = keymap;
+    for (const char *key = keys; *key;) {
+        const size_t key_size = strcspn(key, "+");
+        if (key_size == 0 || key_size >= XDO_KEY_NAME_SIZE) {
+            log_errorf("invalid key in '%s'", keys);
+            return false;
+        }
+        if (sequence->count == OUTPUT_KEYS_MAX) {
+            log_errorf("too many keys in '%s'", keys);
+            return false;
+        }
+
+        char key_name[XDO_KEY_NAME_SIZE];
+        memcpy(key_name, key, key_size);
+        key_name[key_size] = '\0';
+        const KeySym keysym = keysym_from_name(key_name);
+        if (keysym == NoSymbol) {
+            log_errorf("unknown key '%s' in '%s'", key_name, keys);
+            return false;
+        }
+
+        charcodemap_t resolved;
+        output_xdo_resolve_key(keysym, &resolved);
+        sequence->codes[sequence->count] = resolved.code;
+        sequence->modifiers[sequence->count] = resolved.modmask;
+        sequence->symbols[sequence->count] = keysym;
+        ++sequence->count;
+
+        key += key_size;
+        if (*key == '+') ++key;
+    }
+
+    if (!sequence->count) {
+        log_errorf("no key in '%s'", keys);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Press or release the keys of a keyboard shortcut. The keys are resolved
+ * again if the keyboard mapping changed since they were compiled.
+ *
+ * \param sequence The keyboard shortcut to send.
+ * \param pressed True to press the keys in order, false to release them in
+ *                the reverse order.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool output_xdo_send_keys(const KeySequence *sequence,
+                                 const bool pressed) {
+    assert(xdo && "xdo isn't initialized");
+    output_xdo_update_keymap();
+
+    charcodemap_t keys[OUTPUT_KEYS_MAX];
+    memset(keys, 0, sizeof(keys));
+    for (uint8_t i = 0; i < sequence->count; ++i) {
+        const uint8_t index = pressed ? i : sequence->count - 1 - i;
+        if (sequence->keymap != keymap) {
+            output_xdo_resolve_key(sequence->symbols[index], &keys[i]);
+            continue;
+        }
+        keys[i].code = sequence->codes[index];
+        keys[i].modmask = sequence->modifiers[index];
+        keys[i].symbol = sequence->symbols[index];
+        keys[i].needs_binding = !keys[i].code;
+    }
+
+    if (xdo_send_keysequence_window_list_do(xdo, CURRENTWINDOW, keys,
+                                            sequence->count, pressed, NULL,
+                                            0)) {
+        log_errorf("failed to set keys %s", pressed ? "down" : "up");
+        return false;
+    }
+
+    return true;
+}
+
+static bool output_xdo_keys_down(const KeySequence *sequence) {
+    return output_xdo_send_keys(sequence, true);
+}
+
+static bool output_xdo_keys_up(const KeySequence *sequence) {
+    return output_xdo_send_keys(sequence, false);
+}
+
+/**
+ * libxdo flushes the X connection after every request so there is nothing
+ * buffered.
+ */
+static bool output_xdo_flush(void) {
+    return true;
+}
+
+const OutputBackend output_backend_xdo = {
+    .init = output_xdo_init,
+    .quit = output_xdo_quit,
+    .move_mouse = output_xdo_move_mouse,
+    .scroll = output_xdo_scroll,
+    .mouse_down = output_xdo_mouse_down,
+    .mouse_up = output_xdo_mouse_up,
+    .mouse_click = output_xdo_mouse_click,
+    .compile_keys = output_xdo_compile_keys,
+    .keys_down = output_xdo_keys_down,
+    .keys_up = output_xdo_keys_up,
+    .flush = output_xdo_flush,
+};
@@ -0,0 +1,310 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "controller.h"
+#include "event_loop.h"
+#include "event_ring.h"
+#include "log.h"
+#include "pipeline.h"
+#include "realtime.h"
+
+struct _Pipeline {
+    EventRing ring;
+    pthread_t input_thread;
+    bool input_thread_started;
+
+    /**
+     * Eventfd written by the input thread when events are pushed to the ring.
+     */
+    int wake_fd;
+
+    /**
+     * Eventfd written by pipeline_stop() to stop the input thread.
+     */
+    int stop_fd;
+
+    /**
+     * Eventfd written by the event loop when it emptied the ring while the
+     * input thread waits for room to resynchronize the controller.
+     */
+    int room_fd;
+
+    /**
+     * Set by the input thread when reading the controller failed.
+     */
+    atomic_bool input_failed;
+
+    /**
+     * Set by the input thread when an event was dropped because the ring was
+     * full, until the state of the controller is pushed again.
+     */
+    atomic_bool overflowed;
+
+    Controller *controller;
+    ControllerButtonEventCallBack on_button_down;
+    ControllerButtonEventCallBack on_button_up;
+    EventLoopCallback on_processed;
+    EventLoopCallback on_failed;
+    void *data;
+
+    /**
+     * The number of overruns already reported.
+     */
+    uint64_t reported_overruns;
+};
+
+/**
+ * The pipeline filled by pipeline_push_event().
+ */
+typedef struct {
+    Pipeline *pipeline;
+    bool pushed;  // Set to true when an event is pushed.
+} PipelinePush;
+
+/**
+ * Push an event read by the input thread to the ring.
+ * See ControllerEventCallBack.
+ *
+ * Once an event is dropped because the ring is full, the following events are
+ * dropped as well until the state of the controller is pushed again by
+ * pipeline_read(), so a release or the end of a frame is never lost.
+ *
+ * \param event The event read from the controller.
+ * \param data A pointer to the PipelinePush.
+ */
+static void pipeline_push_event(const struct input_event *event, void *data) {
+    PipelinePush *push = data;
+    Pipeline *pipeline = push->pipeline;
+    if (atomic_load_explicit(&pipeline->overflowed, memory_order_relaxed)) {
+        return;
+    }
+
+    if (event_ring_push(&pipeline->ring, event)) {
+        push->pushed = true;
+    } else {
+        atomic_store(&pipeline->overflowed, true);
+    }
+}
+
+/**
+ * Wake up an eventfd.
+ *
+ * \param fd The eventfd to wake up.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool pipeline_wake(const int fd) {
+    const uint64_t value = 1;
+    if (write(fd, &value, sizeof(value)) < 0) {
+        log_errorf("failed to write eventfd: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Clear an eventfd.
+ *
+ * \param fd The eventfd to clear.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool pipeline_clear(const int fd) {
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        log_errorf("failed to read eventfd: %s", strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Read the pending events of the controller into the ring. After an overflow,
+ * the state of the controller is pushed as a frame of events instead, once
+ * the event loop emptied at least half of the ring.
+ *
+ * \param pipeline The pipeline.
+ * \param push A pointer to the PipelinePush of the events.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool pipeline_read(Pipeline *pipeline, PipelinePush *push) {
+    if (atomic_load(&pipeline->overflowed)) {
+        EventRingStats stats;
+        event_ring_get_stats(&pipeline->ring, &stats);
+        if (stats.occupancy <= EVENT_RING_CAPACITY / 2) {
+            atomic_store(&pipeline->overflowed, false);
+            return controller_resync(pipeline->controller, pipeline_push_event,
+                                     push);
+        }
+    }
+
+    // The events are dropped by pipeline_push_event() while the ring is full.
+    return controller_read(pipeline->controller, pipeline_push_event, push);
+}
+
+/**
+ * Main function of the input thread.
+ *
+ * \param data A pointer to the Pipeline.
+ *
+ * \returns NULL.
+ */
+static void *pipeline_input_thread(void *data) {
+    Pipeline *pipeline = data;
+    realtime_init_thread();
+
+    struct pollfd fds[] = {
+        {.fd = controller_get_fd(pipeline->controller), .events = POLLIN},
+        {.fd = pipeline->stop_fd, .events = POLLIN},
+        {.fd = pipeline->room_fd, .events = POLLIN},
+    };
+    for (;;) {
+        if (poll(fds, sizeof(fds) / sizeof(*fds), -1) < 0) {
+            if (errno == EINTR) continue;
+            log_errorf("failed to poll controller: %s", strerror(errno));
+            break;
+        }
+        if (fds[1].revents) return NULL;
+        if (fds[2].revents && !pipeline_clear(pipeline->room_fd)) break;
+
+        PipelinePush push = {.pipeline = pipeline, .pushed = false};
+        if (!pipeline_read(pipeline, &push)) break;
+        if (push.pushed && !pipeline_wake(pipeline->wake_fd)) break;
+    }
+
+    atomic_store(&pipeline->input_failed, true);
+    pipeline_wake(pipeline->wake_fd);
+    return NULL;
+}
+
+/**
+ * Process the events pushed to the ring by the input thread.
+ * See EventLoopCallback.
+ *
+ * \param data A pointer to the Pipeline.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool pipeline_handle_events(void *data) {
+    Pipeline *pipeline = data;
+    if (!pipeline_clear(pipeline->wake_fd)) return false;
+
+    struct input_event event;
+    while (event_ring_pop(&pipeline->ring, &event)) {
+        controller_process_event(pipeline->controller, &event,
+                                 pipeline->on_button_down,
+                                 pipeline->on_button_up, pipeline->data);
+    }
+
+    EventRingStats stats;
+    event_ring_get_stats(&pipeline->ring, &stats);
+    if (stats.overruns != pipeline->reported_overruns) {
+        log_errorf("event ring full: %lu events dropped, resynchronizing the "
+                   "controller", stats.overruns - pipeline->reported_overruns);
+        pipeline->reported_overruns = stats.overruns;
+    }
+    // The input thread waits for room in the ring to push the state of the
+    // controller.
+    if (atomic_load(&pipeline->overflowed) &&
+        !pipeline_wake(pipeline->room_fd)) {
+        return false;
+    }
+
+    if (atomic_load(&pipeline->input_failed)) {
+        return pipeline->on_failed(pipeline->data);
+    }
+
+    return pipeline->on_processed(pipeline->data);
+}
+
+Pipeline *pipeline_start(Controller *controller,
+                         const ControllerButtonEventCallBack on_button_down,
+                         const ControllerButtonEventCallBack on_button_up,
+                         const EventLoopCallback on_processed,
+                         const EventLoopCallback on_failed, void *data) {
+    // The ring is aligned on cache lines, which malloc() doesn't guarantee.
+    Pipeline *pipeline = aligned_alloc(_Alignof(Pipeline), sizeof(*pipeline));
+    if (!pipeline) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return NULL;
+    }
+
+    pipeline->controller = controller;
+    pipeline->on_button_down = on_button_down;
+    pipeline->on_button_up = on_button_up;
+    pipeline->on_processed = on_processed;
+    pipeline->on_failed = on_failed;
+    pipeline->data = data;
+    pipeline->input_thread_started = false;
+    pipeline->reported_overruns = 0;
+    event_ring_init(&pipeline->ring);
+    atomic_init(&pipeline->input_failed, false);
+    atomic_init(&pipeline->overflowed, false);
+
+    pipeline->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pipeline->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pipeline->room_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pipeline->wake_fd < 0 || pipeline->stop_fd < 0 ||
+        pipeline->room_fd < 0) {
+        log_errorf("failed to create eventfd: %s", strerror(errno));
+        pipeline_stop(pipeline);
+        return NULL;
+    }
+
+    if (!event_loop_add_fd(pipeline->wake_fd, pipeline_handle_events,
+                           pipeline)) {
+        close(pipeline->wake_fd);
+        pipeline->wake_fd = -1;
+        pipeline_stop(pipeline);
+        return NULL;
+    }
+
+    const int err = pthread_create(&pipeline->input_thread, NULL,
+                                   pipeline_input_thread, pipeline);
+    if (err) {
+        log_errorf("failed to create input thread: %s", strerror(err));
+        pipeline_stop(pipeline);
+        return NULL;
+    }
+    pipeline->input_thread_started = true;
+    log_debugf("input thread started");
+
+    return pipeline;
+}
+
+void pipeline_stop(Pipeline *pipeline) {
+    if (pipeline->input_thread_started) {
+        pipeline_wake(pipeline->stop_fd);
+        pthread_join(pipeline->input_thread, NULL);
+
+#ifndef PROD
+        EventRingStats stats;
+        event_ring_get_stats(&pipeline->ring, &stats);
+        log_debugf("event ring: max occupancy=%zu overruns=%lu",
+                   stats.max_occupancy, stats.overruns);
+#endif
+    }
+
+    if (pipeline->wake_fd >= 0) {
+        event_loop_remove_fd(pipeline->wake_fd);
+        close(pipeline->wake_fd);
+    }
+    if (pipeline->stop_fd >= 0) close(pipeline->stop_fd);
+    if (pipeline->room_fd >= 0) close(pipeline->room_fd);
+    free(pipeline);
+}
+
+void pipeline_get_stats(Pipeline *pipeline, EventRingStats *stats) {
+    event_ring_get_stats(&pipeline->ring, stats);
+}
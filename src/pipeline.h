@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * Pipeline mode of the application.
+ *
+ * An input thread drains the controller device into an EventRing as soon as
+ * events are available, so a slow output never delays the reading of the
+ * device. The events are processed in the thread of the event loop, which is
+ * woken up through an eventfd.
+ *
+ * When the ring is full, the events are dropped until the event loop catches
+ * up, then the current state of the controller is pushed like after the
+ * kernel dropped events, so no button stays pressed.
+ */
+
+#include <stdbool.h>
+
+#include "controller.h"
+#include "event_loop.h"
+#include "event_ring.h"
+
+/**
+ * A controller read by an input thread.
+ */
+typedef struct _Pipeline Pipeline;
+
+/**
+ * Start an input thread reading a controller and watch its ring in the event
+ * loop. The pipeline need to be stopped with pipeline_stop().
+ *
+ * The controller must not be updated with controller_update() while the
+ * pipeline is running.
+ *
+ * \param controller The controller to read.
+ * \param on_button_down A callback function that is invoked when a button
+ *                       is pressed down.
+ * \param on_button_up A callback function that is invoked when a button
+ *                     is released.
+ * \param on_processed A callback function that is invoked in the event loop
+ *                     after a batch of events is processed.
+ * \param on_failed A callback function that is invoked in the event loop when
+ *                  the input thread failed to read the controller, for example
+ *                  because it was disconnected.
+ * \param data The user data passed to the callbacks.
+ *
+ * \returns a pointer to the pipeline, or NULL on failure.
+ */
+Pipeline *pipeline_start(Controller *controller,
+                         const ControllerButtonEventCallBack on_button_down,
+                         const ControllerButtonEventCallBack on_button_up,
+                         const EventLoopCallback on_processed,
+                         const EventLoopCallback on_failed, void *data);
+
+/**
+ * Stop the input thread and free the resources used by the pipeline. The
+ * controller is not destroyed.
+ *
+ * \param pipeline The pipeline to stop.
+ */
+void pipeline_stop(Pipeline *pipeline);
+
+/**
+ * Get the statistics of the ring between the input thread and the event loop.
+ *
+ * \param pipeline The pipeline.
+ * \param stats A pointer where the statistics will be stored.
+ */
+void pipeline_get_stats(Pipeline *pipeline, EventRingStats *stats);
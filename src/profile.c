@@ -0,0 +1,311 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "config_file.h"
+#include "event_loop.h"
+#include "log.h"
+#include "mapping.h"
+#include "profile.h"
+
+#define PROFILE_CACHE_BITS 8
+#define PROFILE_CACHE_SIZE (1 << PROFILE_CACHE_BITS)
+#define PROFILE_CACHE_MASK (PROFILE_CACHE_SIZE - 1)
+#define PROFILE_ERROR_SIZE 128
+
+/**
+ * The mapping used for a window, in the cache.
+ */
+typedef struct {
+    Window window;  // None for an empty entry.
+    const Mapping *mapping;
+} ProfileCacheEntry;
+
+static Display *display = NULL;
+static Window root = None;
+static Atom net_active_window = None;
+static int (*previous_error_handler)(Display *, XErrorEvent *) = NULL;
+
+static const Config *config = NULL;
+static ProfileCallBack on_change = NULL;
+
+/**
+ * The mapping given to on_change, or NULL before the first call.
+ */
+static const Mapping *active_mapping = NULL;
+
+/**
+ * Hash map from the windows already focused to their mapping, using linear
+ * probing. The windows are removed when they are destroyed, since their id can
+ * be reused.
+ */
+static ProfileCacheEntry cache[PROFILE_CACHE_SIZE];
+static size_t cache_count = 0;
+
+/**
+ * Handle the errors of the X requests. The windows can be destroyed at any
+ * time, so the requests about them may fail without stopping the app.
+ *
+ * \param error_display The display of the request.
+ * \param event The error.
+ *
+ * \returns 0, the value is ignored by Xlib.
+ */
+static int profile_handle_x_error(Display *error_display,
+                                  XErrorEvent *event) {
+    if (event->error_code == BadWindow) {
+        log_debugf("window 0x%lx doesn't exist", event->resourceid);
+        return 0;
+    }
+
+    char message[PROFILE_ERROR_SIZE];
+    XGetErrorText(error_display, event->error_code, message, sizeof(message));
+    log_errorf("X request %d failed: %s", event->request_code, message);
+    return 0;
+}
+
+/**
+ * Get the first entry of the cache to probe for a window.
+ *
+ * \param window The window.
+ *
+ * \returns the index of the entry.
+ */
+static size_t profile_cache_index(const Window window) {
+    // The window ids are sequential, so they are scattered with a Fibonacci
+    // hash.
+    return (size_t)(
+        ((uint64_t)window * UINT64_C(0x9e3779b97f4a7c15)) >>
+        (64 - PROFILE_CACHE_BITS)
+    );
+}
+
+/**
+ * Remove all the windows from the cache.
+ */
+static void profile_cache_clear(void) {
+    memset(cache, 0, sizeof(cache));
+    cache_count = 0;
+}
+
+/**
+ * Find the mapping of a window in the cache.
+ *
+ * \param window The window.
+ *
+ * \returns the mapping of the window, or NULL if it isn't in the cache.
+ */
+static const Mapping *profile_cache_get(const Window window) {
+    for (size_t i = profile_cache_index(window); cache[i].window != None;
+         i = (i + 1) & PROFILE_CACHE_MASK) {
+        if (cache[i].window == window) return cache[i].mapping;
+    }
+
+    return NULL;
+}
+
+/**
+ * Add a window which isn't in the cache yet.
+ *
+ * \param window The window.
+ * \param mapping The mapping of the window.
+ */
+static void profile_cache_add(const Window window, const Mapping *mapping) {
+    // Keep empty entries so the probing stays short.
+    if (cache_count >= PROFILE_CACHE_SIZE * 3 / 4) profile_cache_clear();
+
+    size_t i = profile_cache_index(window);
+    while (cache[i].window != None) i = (i + 1) & PROFILE_CACHE_MASK;
+    cache[i].window = window;
+    cache[i].mapping = mapping;
+    ++cache_count;
+}
+
+/**
+ * Remove a window from the cache, if it is in it.
+ *
+ * \param window The window.
+ */
+static void profile_cache_remove(const Window window) {
+    size_t hole = profile_cache_index(window);
+    while (cache[hole].window != window) {
+        if (cache[hole].window == None) return;
+        hole = (hole + 1) & PROFILE_CACHE_MASK;
+    }
+
+    // Shift back the next entries of the probe sequence instead of leaving a
+    // tombstone, when the hole is between their first entry and their entry.
+    for (size_t i = (hole + 1) & PROFILE_CACHE_MASK; cache[i].window != None;
+         i = (i + 1) & PROFILE_CACHE_MASK) {
+        const size_t first = profile_cache_index(cache[i].window);
+        if (((i - first) & PROFILE_CACHE_MASK) >=
+            ((i - hole) & PROFILE_CACHE_MASK)) {
+            cache[hole] = cache[i];
+            hole = i;
+        }
+    }
+    cache[hole].window = None;
+    cache[hole].mapping = NULL;
+    --cache_count;
+}
+
+/**
+ * Get the active window from the _NET_ACTIVE_WINDOW property of the root
+ * window.
+ *
+ * \returns the active window, or None if there is no active window.
+ */
+static Window profile_get_active_window(void) {
+    Atom type;
+    int format;
+    unsigned long count, bytes_after;
+    unsigned char *data = NULL;
+    if (XGetWindowProperty(display, root, net_active_window, 0, 1, False,
+                           XA_WINDOW, &type, &format, &count, &bytes_after,
+                           &data) != Success) {
+        return None;
+    }
+
+    Window window = None;
+    if (data && type == XA_WINDOW && format == 32 && count == 1) {
+        window = *(const Window *)data;
+    }
+    if (data) XFree(data);
+
+    return window;
+}
+
+/**
+ * Get the mapping of a window from its class, and add it to the cache.
+ *
+ * \param window The window.
+ *
+ * \returns the mapping of the window.
+ */
+static const Mapping *profile_resolve(const Window window) {
+    // Be notified when the window is destroyed to remove it from the cache.
+    XSelectInput(display, window, StructureNotifyMask);
+
+    XClassHint hint;
+    if (!XGetClassHint(display, window, &hint)) {
+        // The window has no class or is already destroyed, so it isn't added
+        // to the cache.
+        return &config->mapping;
+    }
+
+    const Mapping *mapping = config_get_mapping(config, hint.res_name,
+                                                hint.res_class);
+    log_debugf("window 0x%lx of class %s: %s", window,
+               hint.res_class ? hint.res_class : "",
+               mapping == &config->mapping ? "default mapping" : "profile");
+    if (hint.res_name) XFree(hint.res_name);
+    if (hint.res_class) XFree(hint.res_class);
+
+    profile_cache_add(window, mapping);
+    return mapping;
+}
+
+/**
+ * Call on_change if the mapping of the active window changed.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool profile_update(void) {
+    const Mapping *mapping = &config->mapping;
+    // Without profiles, the active window doesn't need to be queried.
+    if (display && config->profiles_count) {
+        const Window window = profile_get_active_window();
+        if (window != None) {
+            mapping = profile_cache_get(window);
+            if (!mapping) mapping = profile_resolve(window);
+        }
+    }
+
+    if (mapping == active_mapping) return true;
+    active_mapping = mapping;
+    return on_change(mapping);
+}
+
+/**
+ * Handle the events of the X server. See EventLoopCallback.
+ *
+ * \param data Unused.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool profile_handle_events(void *data) {
+    (void)data;
+
+    // The events received during the requests of profile_update() are queued
+    // by Xlib without making the connection readable, so they are handled
+    // before returning.
+    for (;;) {
+        bool active_window_changed = false;
+        while (XPending(display)) {
+            XEvent event;
+            XNextEvent(display, &event);
+            if (event.type == PropertyNotify &&
+                event.xproperty.atom == net_active_window) {
+                active_window_changed = true;
+            } else if (event.type == DestroyNotify) {
+                profile_cache_remove(event.xdestroywindow.window);
+            }
+        }
+
+        if (!active_window_changed) return true;
+        if (!profile_update()) return false;
+    }
+}
+
+bool profile_init(const Config *new_config,
+                  const ProfileCallBack new_on_change) {
+    assert(!display && "the profiles are already initialized");
+    config = new_config;
+    on_change = new_on_change;
+    active_mapping = NULL;
+    profile_cache_clear();
+
+    display = XOpenDisplay(NULL);
+    if (!display) {
+        log_debugf("failed to open the X display, the profiles are disabled");
+        return profile_update();
+    }
+    previous_error_handler = XSetErrorHandler(profile_handle_x_error);
+
+    root = DefaultRootWindow(display);
+    net_active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+    XSelectInput(display, root, PropertyChangeMask);
+
+    if (!event_loop_add_fd(ConnectionNumber(display), profile_handle_events,
+                           NULL)) {
+        profile_quit();
+        return false;
+    }
+
+    return profile_update() && profile_handle_events(NULL);
+}
+
+bool profile_set_config(const Config *new_config) {
+    // The cached mappings are in the previous config.
+    config = new_config;
+    active_mapping = NULL;
+    profile_cache_clear();
+
+    return profile_update() && (!display || profile_handle_events(NULL));
+}
+
+void profile_quit(void) {
+    if (!display) return;
+    event_loop_remove_fd(ConnectionNumber(display));
+    XSetErrorHandler(previous_error_handler);
+    XCloseDisplay(display);
+    display = NULL;
+    previous_error_handler = NULL;
+    profile_cache_clear();
+}
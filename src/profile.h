@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * Profiles of the mapping following the active window.
+ *
+ * The _NET_ACTIVE_WINDOW property of the root window is watched through the
+ * event loop, and the mapping of each window is kept in a cache, so the class
+ * of a window is only queried the first time it is focused. Handling a button
+ * stays a single table lookup in the mapping given to the callback.
+ *
+ * The default mapping of the config is used when the X server isn't available.
+ */
+
+#include <stdbool.h>
+
+#include "config_file.h"
+#include "mapping.h"
+
+/**
+ * Callback function called when the mapping to use changes.
+ *
+ * \param mapping The mapping of the active window, in the config.
+ *
+ * \returns true on success, or false on failure which stops the event loop.
+ */
+typedef bool (*ProfileCallBack)(const Mapping *mapping);
+
+/**
+ * Start following the active window. The event loop must be initialized.
+ * on_change is called with the mapping of the current active window before
+ * returning.
+ *
+ * \param config The config containing the profiles.
+ * \param on_change A callback function that is invoked when the mapping to use
+ *                  changes.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool profile_init(const Config *config, const ProfileCallBack on_change);
+
+/**
+ * Replace the config containing the profiles, after the config file is
+ * reloaded. on_change is called with the mapping of the active window in the
+ * new config before returning, so the previous config can be freed.
+ *
+ * \param config The new config.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool profile_set_config(const Config *config);
+
+/**
+ * Stop following the active window.
+ */
+void profile_quit(void);
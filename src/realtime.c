@@ -0,0 +1,214 @@
+#define _GNU_SOURCE  // sched_setaffinity(), gettid()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <sched.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <linux/capability.h>
+
+#include "config.h"
+#include "log.h"
+#include "realtime.h"
+
+/**
+ * CPU time a real-time thread may use without blocking, which RealtimeKit
+ * requires. A thread stuck in a loop is killed by SIGXCPU instead of freezing
+ * its CPU.
+ */
+#define REALTIME_RTTIME 200000  // us
+
+/**
+ * Size of the stack touched in advance, far more than the event path uses.
+ */
+#define REALTIME_STACK_SIZE (256 * 1024)
+
+extern char **environ;
+
+static bool enabled = false;
+
+/**
+ * Whether the main thread got the real-time priority, otherwise the other
+ * threads don't try again.
+ */
+static bool scheduled = false;
+
+/**
+ * Ask RealtimeKit for the real-time priority of a thread, through busctl so
+ * there is no D-Bus library to link.
+ *
+ * \param thread The id of the thread.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool realtime_rtkit(const pid_t thread) {
+    char pid_string[24], thread_string[24], priority_string[8];
+    snprintf(pid_string, sizeof(pid_string), "%d", (int)getpid());
+    snprintf(thread_string, sizeof(thread_string), "%d", (int)thread);
+    snprintf(priority_string, sizeof(priority_string), "%d",
+             REALTIME_PRIORITY);
+    // The call comes from busctl, so the process of the thread is given.
+    char *argv[] = {
+        "busctl", "--system", "call", "org.freedesktop.RealtimeKit1",
+        "/org/freedesktop/RealtimeKit1", "org.freedesktop.RealtimeKit1",
+        "MakeThreadRealtimeWithPID", "ttu", pid_string, thread_string,
+        priority_string, NULL,
+    };
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    pid_t pid;
+    const int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv,
+                                 environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err) {
+        log_debugf("failed to run busctl: %s", strerror(err));
+        return false;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            log_debugf("failed to wait for busctl: %s", strerror(errno));
+            return false;
+        }
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Give the real-time priority to the calling thread.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool realtime_set_scheduler(void) {
+    const struct sched_param param = {.sched_priority = REALTIME_PRIORITY};
+    if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+        log_debugf("thread %d scheduled with SCHED_FIFO", (int)gettid());
+        return true;
+    }
+
+    const int err = errno;
+    if (realtime_rtkit(gettid())) {
+        log_debugf("thread %d scheduled by RealtimeKit", (int)gettid());
+        return true;
+    }
+
+    log_errorf("failed to get a real-time priority: %s, continuing at normal "
+               "priority", strerror(err));
+    return false;
+}
+
+/**
+ * Touch the stack in advance so its pages are mapped and locked.
+ */
+static __attribute__((noinline)) void realtime_prefault_stack(void) {
+    volatile char stack[REALTIME_STACK_SIZE];
+    const long page_size = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sizeof(stack); i += page_size) stack[i] = 0;
+}
+
+/**
+ * Check whether the memory mapped later can be locked without failing the
+ * allocations, because the locked memory isn't limited.
+ *
+ * \returns true if the locked memory is unlimited, or false otherwise.
+ */
+static bool realtime_memory_unlimited(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+        limit.rlim_cur == RLIM_INFINITY) {
+        return true;
+    }
+
+    // CAP_IPC_LOCK ignores the limit. glibc has no wrapper for capget().
+    struct __user_cap_header_struct header = {
+        .version = _LINUX_CAPABILITY_VERSION_3,
+        .pid = 0,
+    };
+    struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3];
+    return syscall(SYS_capget, &header, data) == 0 &&
+        data[CAP_TO_INDEX(CAP_IPC_LOCK)].effective & CAP_TO_MASK(CAP_IPC_LOCK);
+}
+
+void realtime_init(void) {
+    enabled = true;
+
+    // Freed memory stays in the heap, and the large allocations come from it
+    // instead of mappings, so the heap never has to be faulted in again.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    const struct rlimit limit = {
+        .rlim_cur = REALTIME_RTTIME,
+        .rlim_max = REALTIME_RTTIME,
+    };
+    if (setrlimit(RLIMIT_RTTIME, &limit) < 0) {
+        log_debugf("failed to limit the real-time CPU time: %s",
+                   strerror(errno));
+    }
+
+    scheduled = realtime_set_scheduler();
+}
+
+void realtime_lock_memory(void) {
+    if (!enabled) return;
+
+    // Under a limit, locking the future mappings would fail the allocations
+    // and the creation of threads once it is reached, so only the memory
+    // allocated by the initialization is locked.
+    const int flags = (
+        realtime_memory_unlimited() ? MCL_CURRENT | MCL_FUTURE : MCL_CURRENT
+    );
+    if (mlockall(flags) < 0) {
+        log_errorf("failed to lock the memory: %s, continuing without it "
+                   "(see ulimit -l)", strerror(errno));
+    } else {
+        log_debugf("memory locked%s", flags & MCL_FUTURE ? " with MCL_FUTURE"
+                                                         : "");
+    }
+    realtime_prefault_stack();
+}
+
+void realtime_init_thread(void) {
+    if (!enabled) return;
+
+    realtime_prefault_stack();
+    // The threads inherit SCHED_FIFO, but not the priority from RealtimeKit
+    // which sets SCHED_RESET_ON_FORK.
+    if (scheduled && sched_getscheduler(0) == SCHED_OTHER) {
+        realtime_set_scheduler();
+    }
+}
+
+bool realtime_pin(const int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        log_errorf("invalid CPU: %d", cpu);
+        return false;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        log_errorf("failed to pin to the CPU %d: %s", cpu, strerror(errno));
+        return false;
+    }
+
+    log_debugf("pinned to the CPU %d", cpu);
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/**
+ * Low-latency mode, which keeps the input and output work from waiting behind
+ * the other processes when they saturate the CPUs.
+ *
+ * The threads get a real-time scheduling priority from the kernel, or from
+ * RealtimeKit when the process isn't allowed to set it. The memory is locked
+ * and the stack and the heap are kept mapped, so the event path, which doesn't
+ * allocate, never waits for a page fault. A missing privilege is reported and
+ * the app keeps running without it.
+ */
+
+#include <stdbool.h>
+
+/**
+ * Enable the low-latency mode for the calling thread and the threads it
+ * creates afterwards.
+ */
+void realtime_init(void);
+
+/**
+ * Lock the memory of the process, if the low-latency mode is enabled. It is
+ * called once the app is initialized, so the memory it allocated is locked
+ * even when the future allocations can't be.
+ */
+void realtime_lock_memory(void);
+
+/**
+ * Give the real-time priority to the calling thread, if the low-latency mode is
+ * enabled and the thread didn't inherit it. It must be called by each thread
+ * doing input or output work.
+ */
+void realtime_init_thread(void);
+
+/**
+ * Pin the calling thread and the threads it creates afterwards to a CPU.
+ *
+ * \param cpu The index of the CPU.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool realtime_pin(const int cpu);
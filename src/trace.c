@@ -0,0 +1,448 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <linux/input.h>
+
+#include "controller.h"
+#include "log.h"
+#include "trace.h"
+
+#define TRACE_MAGIC "DCTRACE"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE (sizeof(TRACE_MAGIC) - 1 + 1)
+#define TRACE_BUFFER_SIZE 65536  // bytes written at once
+#define TRACE_RECORD_SIZE_MAX 4096
+#define TRACE_VARINT_SIZE_MAX 10
+
+#define TRACE_CONTROLLER 'C'
+#define TRACE_EVENT 'E'
+
+struct _Trace {
+    char *path;
+
+    /**
+     * State of a trace being written.
+     */
+    FILE *file;
+    bool started;  // whether an event was written
+    struct timeval previous_time;  // timestamp of the previous event
+
+    /**
+     * State of a trace being read.
+     */
+    uint8_t *data;
+    size_t size;
+    size_t position;
+    int64_t time;  // us since the first event
+};
+
+/**
+ * Encode an unsigned integer as a LEB128 varint.
+ *
+ * \param buffer The buffer where the varint is written, with at least
+ *               TRACE_VARINT_SIZE_MAX bytes available.
+ * \param value The integer to encode.
+ *
+ * \returns the position after the varint in the buffer.
+ */
+static uint8_t *trace_put_varint(uint8_t *buffer, uint64_t value) {
+    while (value >= 0x80) {
+        *buffer++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *buffer++ = (uint8_t)value;
+    return buffer;
+}
+
+/**
+ * Encode a signed integer as a zigzag LEB128 varint, so the small negative
+ * integers take as few bytes as the small positive ones.
+ *
+ * \param buffer The buffer where the varint is written, with at least
+ *               TRACE_VARINT_SIZE_MAX bytes available.
+ * \param value The integer to encode.
+ *
+ * \returns the position after the varint in the buffer.
+ */
+static uint8_t *trace_put_signed(uint8_t *buffer, const int64_t value) {
+    return trace_put_varint(
+        buffer,
+        ((uint64_t)value << 1) ^ (uint64_t)(value >> 63)
+    );
+}
+
+/**
+ * Append a record to a created trace.
+ *
+ * \param trace The trace.
+ * \param record The encoded record.
+ * \param end The end of the encoded record.
+ *
+ * \returns true on success, or false on failure.
+ */
+static bool trace_write(Trace *trace, const uint8_t *record,
+                        const uint8_t *end) {
+    const size_t size = end - record;
+    if (fwrite(record, 1, size, trace->file) != size) {
+        log_errorf("failed to write %s: %s", trace->path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+Trace *trace_create(const char *path) {
+    Trace *trace = calloc(1, sizeof(*trace));
+    if (!trace) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return NULL;
+    }
+    trace->path = strdup(path);
+    if (!trace->path) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        trace_close(trace);
+        return NULL;
+    }
+
+    trace->file = fopen(path, "wb");
+    if (!trace->file) {
+        log_errorf("failed to create %s: %s", path, strerror(errno));
+        trace_close(trace);
+        return NULL;
+    }
+    setvbuf(trace->file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    const uint8_t header[TRACE_HEADER_SIZE] = {
+        TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_MAGIC[3],
+        TRACE_MAGIC[4], TRACE_MAGIC[5], TRACE_MAGIC[6], TRACE_VERSION,
+    };
+    if (!trace_write(trace, header, header + sizeof(header))) {
+        trace_close(trace);
+        return NULL;
+    }
+
+    return trace;
+}
+
+bool trace_write_controller(Trace *trace, const unsigned int controller,
+                            const ControllerInfo *info) {
+    uint8_t record[TRACE_RECORD_SIZE_MAX];
+    uint8_t *end = record;
+    *end++ = TRACE_CONTROLLER;
+    end = trace_put_varint(end, controller);
+
+    const size_t name_size = strnlen(info->name, sizeof(info->name) - 1);
+    end = trace_put_varint(end, name_size);
+    memcpy(end, info->name, name_size);
+    end += name_size;
+
+    end = trace_put_varint(end, info->id.bustype);
+    end = trace_put_varint(end, info->id.vendor);
+    end = trace_put_varint(end, info->id.product);
+    end = trace_put_varint(end, info->id.version);
+
+    end = trace_put_varint(end, __builtin_popcountll(info->axes));
+    for (unsigned int code = 0; code < ABS_CNT; ++code) {
+        if (!(info->axes & (UINT64_C(1) << code))) continue;
+        const struct input_absinfo *absinfo = &info->absinfo[code];
+        end = trace_put_varint(end, code);
+        end = trace_put_signed(end, absinfo->value);
+        end = trace_put_signed(end, absinfo->minimum);
+        end = trace_put_signed(end, absinfo->maximum);
+        end = trace_put_signed(end, absinfo->fuzz);
+        end = trace_put_signed(end, absinfo->flat);
+        end = trace_put_signed(end, absinfo->resolution);
+    }
+
+    return trace_write(trace, record, end);
+}
+
+bool trace_write_event(Trace *trace, const unsigned int controller,
+                       const struct input_event *event) {
+    if (!trace->started) {
+        trace->started = true;
+        trace->previous_time = event->time;
+    }
+    const int64_t elapsed = (
+        (int64_t)(event->time.tv_sec - trace->previous_time.tv_sec) *
+            1000000 +
+        (event->time.tv_usec - trace->previous_time.tv_usec)
+    );
+    trace->previous_time = event->time;
+
+    uint8_t record[1 + 5 * TRACE_VARINT_SIZE_MAX];
+    uint8_t *end = record;
+    *end++ = TRACE_EVENT;
+    end = trace_put_varint(end, controller);
+    end = trace_put_signed(end, elapsed);
+    end = trace_put_varint(end, event->type);
+    end = trace_put_varint(end, event->code);
+    end = trace_put_signed(end, event->value);
+
+    return trace_write(trace, record, end);
+}
+
+/**
+ * Decode a LEB128 varint at the position of a trace being read.
+ *
+ * \param trace The trace.
+ * \param value A pointer where the integer will be stored.
+ *
+ * \returns true on success, or false if the varint is cut or too long.
+ */
+static bool trace_get_varint(Trace *trace, uint64_t *value) {
+    uint64_t result = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (trace->position == trace->size) return false;
+        const uint8_t byte = trace->data[trace->position++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Decode a zigzag LEB128 varint at the position of a trace being read.
+ *
+ * \param trace The trace.
+ * \param value A pointer where the integer will be stored.
+ *
+ * \returns true on success, or false if the varint is cut or too long.
+ */
+static bool trace_get_signed(Trace *trace, int64_t *value) {
+    uint64_t encoded;
+    if (!trace_get_varint(trace, &encoded)) return false;
+    *value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+    return true;
+}
+
+/**
+ * Decode a varint that must fit in a range.
+ *
+ * \param trace The trace.
+ * \param max The maximum value.
+ * \param value A pointer where the integer will be stored.
+ *
+ * \returns true on success, or false if the varint is invalid.
+ */
+static bool trace_get_bounded(Trace *trace, const uint64_t max,
+                              unsigned int *value) {
+    uint64_t decoded;
+    if (!trace_get_varint(trace, &decoded) || decoded > max) return false;
+    *value = decoded;
+    return true;
+}
+
+/**
+ * Decode a zigzag varint that must fit in an int32_t.
+ *
+ * \param trace The trace.
+ * \param value A pointer where the integer will be stored.
+ *
+ * \returns true on success, or false if the varint is invalid.
+ */
+static bool trace_get_int32(Trace *trace, int32_t *value) {
+    int64_t decoded;
+    if (!trace_get_signed(trace, &decoded) || decoded < INT32_MIN ||
+        decoded > INT32_MAX) {
+        return false;
+    }
+    *value = decoded;
+    return true;
+}
+
+/**
+ * Decode the description of a controller after its record type.
+ *
+ * \param trace The trace.
+ * \param info A pointer where the description will be stored.
+ *
+ * \returns true on success, or false if the record is invalid.
+ */
+static bool trace_read_controller(Trace *trace, ControllerInfo *info) {
+    memset(info, 0, sizeof(*info));
+
+    unsigned int name_size;
+    if (!trace_get_bounded(trace, sizeof(info->name) - 1, &name_size) ||
+        trace->size - trace->position < name_size) {
+        return false;
+    }
+    memcpy(info->name, trace->data + trace->position, name_size);
+    trace->position += name_size;
+
+    unsigned int bustype, vendor, product, version;
+    if (!trace_get_bounded(trace, UINT16_MAX, &bustype) ||
+        !trace_get_bounded(trace, UINT16_MAX, &vendor) ||
+        !trace_get_bounded(trace, UINT16_MAX, &product) ||
+        !trace_get_bounded(trace, UINT16_MAX, &version)) {
+        return false;
+    }
+    info->id.bustype = bustype;
+    info->id.vendor = vendor;
+    info->id.product = product;
+    info->id.version = version;
+
+    unsigned int count;
+    if (!trace_get_bounded(trace, ABS_CNT, &count)) return false;
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int code;
+        if (!trace_get_bounded(trace, ABS_CNT - 1, &code)) return false;
+        struct input_absinfo *absinfo = &info->absinfo[code];
+        if (!trace_get_int32(trace, &absinfo->value) ||
+            !trace_get_int32(trace, &absinfo->minimum) ||
+            !trace_get_int32(trace, &absinfo->maximum) ||
+            !trace_get_int32(trace, &absinfo->fuzz) ||
+            !trace_get_int32(trace, &absinfo->flat) ||
+            !trace_get_int32(trace, &absinfo->resolution)) {
+            return false;
+        }
+        info->axes |= UINT64_C(1) << code;
+    }
+
+    return true;
+}
+
+/**
+ * Decode an event after its record type.
+ *
+ * \param trace The trace.
+ * \param record A pointer where the time and the event will be stored.
+ *
+ * \returns true on success, or false if the record is invalid.
+ */
+static bool trace_read_event(Trace *trace, TraceRecord *record) {
+    int64_t elapsed;
+    unsigned int type, code;
+    if (!trace_get_signed(trace, &elapsed) ||
+        !trace_get_bounded(trace, EV_MAX, &type) ||
+        !trace_get_bounded(trace, KEY_MAX, &code) ||
+        !trace_get_int32(trace, &record->event.value)) {
+        return false;
+    }
+    trace->time += elapsed;
+    record->time = trace->time;
+    record->event.time = (struct timeval){0};
+    record->event.type = type;
+    record->event.code = code;
+
+    return true;
+}
+
+Trace *trace_open(const char *path) {
+    Trace *trace = calloc(1, sizeof(*trace));
+    if (!trace) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        return NULL;
+    }
+    trace->path = strdup(path);
+    if (!trace->path) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        trace_close(trace);
+        return NULL;
+    }
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log_errorf("failed to open %s: %s", path, strerror(errno));
+        trace_close(trace);
+        return NULL;
+    }
+    struct stat stat;
+    if (fstat(fd, &stat) < 0) {
+        log_errorf("failed to stat %s: %s", path, strerror(errno));
+        close(fd);
+        trace_close(trace);
+        return NULL;
+    }
+    trace->data = malloc(stat.st_size ? stat.st_size : 1);
+    if (!trace->data) {
+        log_errorf("failed to allocate memory: %s", strerror(errno));
+        close(fd);
+        trace_close(trace);
+        return NULL;
+    }
+    while (trace->size < (size_t)stat.st_size) {
+        const ssize_t size = read(fd, trace->data + trace->size,
+                                  stat.st_size - trace->size);
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) {
+            log_errorf("failed to read %s: %s", path,
+                       size ? strerror(errno) : "unexpected end of file");
+            close(fd);
+            trace_close(trace);
+            return NULL;
+        }
+        trace->size += size;
+    }
+    close(fd);
+
+    if (trace->size < TRACE_HEADER_SIZE ||
+        memcmp(trace->data, TRACE_MAGIC, TRACE_HEADER_SIZE - 1)) {
+        log_errorf("%s isn't a trace", path);
+        trace_close(trace);
+        return NULL;
+    }
+    if (trace->data[TRACE_HEADER_SIZE - 1] != TRACE_VERSION) {
+        log_errorf("unsupported version of trace %s: %d", path,
+                   trace->data[TRACE_HEADER_SIZE - 1]);
+        trace_close(trace);
+        return NULL;
+    }
+    trace->position = TRACE_HEADER_SIZE;
+
+    return trace;
+}
+
+TraceRecordType trace_read(Trace *trace, TraceRecord *record) {
+    if (trace->position == trace->size) return TRACE_RECORD_END;
+
+    const size_t start = trace->position;
+    const uint8_t type = trace->data[trace->position++];
+    bool valid = trace_get_bounded(trace, UINT_MAX, &record->controller);
+    if (valid && type == TRACE_CONTROLLER) {
+        valid = trace_read_controller(trace, &record->info);
+        if (valid) return TRACE_RECORD_CONTROLLER;
+    } else if (valid && type == TRACE_EVENT) {
+        valid = trace_read_event(trace, record);
+        if (valid) return TRACE_RECORD_EVENT;
+    } else if (valid) {
+        log_errorf("%s: unknown record type at offset %zu", trace->path,
+                   start);
+        return TRACE_RECORD_INVALID;
+    }
+
+    // The last record is cut if the program recording was killed.
+    if (trace->position == trace->size) {
+        log_debugf("%s: the last record is cut at offset %zu", trace->path,
+                   start);
+        return TRACE_RECORD_END;
+    }
+    log_errorf("%s: invalid record at offset %zu", trace->path, start);
+    return TRACE_RECORD_INVALID;
+}
+
+bool trace_close(Trace *trace) {
+    bool success = true;
+    if (trace->file && fclose(trace->file)) {
+        log_errorf("failed to write %s: %s", trace->path, strerror(errno));
+        success = false;
+    }
+    free(trace->data);
+    free(trace->path);
+    free(trace);
+
+    return success;
+}
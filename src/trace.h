@@ -0,0 +1,118 @@
+#pragma once
+
+/**
+ * Traces of the events of the controllers, to reproduce an issue without the
+ * controllers.
+ *
+ * A trace starts with the magic "DCTRACE" followed by the version of the
+ * format, then the records are appended one after the other. Each record starts
+ * with its type:
+ * - 'C' describes a controller: its index in the trace, the length of its name
+ *   and its name, its input_id, the number of its axes and for each axis its
+ *   code and its input_absinfo.
+ * - 'E' is an event of a controller: the index of the controller, the time
+ *   elapsed since the previous event of the trace in microseconds, and the
+ *   type, the code and the value of the event.
+ *
+ * The integers are LEB128 varints, zigzag encoded when they may be negative,
+ * so an event usually takes 6 bytes instead of the 24 bytes of an input_event.
+ * A trace cut in the middle of a record is read up to its last whole record.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <linux/input.h>
+
+#include "controller.h"
+
+/**
+ * Represents a trace being written or read.
+ */
+typedef struct _Trace Trace;
+
+/**
+ * Enum representing the types of record returned by trace_read().
+ */
+typedef enum {
+    TRACE_RECORD_CONTROLLER,
+    TRACE_RECORD_EVENT,
+    TRACE_RECORD_END,  // There is no more records.
+    TRACE_RECORD_INVALID,  // The trace is corrupted.
+} TraceRecordType;
+
+/**
+ * A record read from a trace.
+ */
+typedef struct {
+    unsigned int controller;  // The index of the controller in the trace.
+    ControllerInfo info;  // for TRACE_RECORD_CONTROLLER
+    int64_t time;  // us since the first event, for TRACE_RECORD_EVENT
+    struct input_event event;  // for TRACE_RECORD_EVENT, without its time
+} TraceRecord;
+
+/**
+ * Create a trace file to record events, replacing the file if it exists. The
+ * records are buffered by stdio and flushed when the buffer is full or the
+ * trace is closed with trace_close().
+ *
+ * \param path The path of the trace file.
+ *
+ * \returns a pointer to the trace, or NULL on failure.
+ */
+Trace *trace_create(const char *path);
+
+/**
+ * Append the description of a controller to a trace. It must be written before
+ * the events of the controller.
+ *
+ * \param trace The trace created with trace_create().
+ * \param controller The index of the controller in the trace.
+ * \param info The description of the controller.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool trace_write_controller(Trace *trace, const unsigned int controller,
+                            const ControllerInfo *info);
+
+/**
+ * Append an event of a controller to a trace.
+ *
+ * \param trace The trace created with trace_create().
+ * \param controller The index of the controller in the trace.
+ * \param event The event with the timestamp given by the kernel.
+ *
+ * \returns true on success, or false on failure.
+ */
+bool trace_write_event(Trace *trace, const unsigned int controller,
+                       const struct input_event *event);
+
+/**
+ * Open a trace file to read its records. The whole file is loaded so reading
+ * the records doesn't wait for the disk.
+ *
+ * \param path The path of the trace file.
+ *
+ * \returns a pointer to the trace, or NULL on failure.
+ */
+Trace *trace_open(const char *path);
+
+/**
+ * Read the next record of a trace.
+ *
+ * \param trace The trace opened with trace_open().
+ * \param record A pointer where the record will be stored.
+ *
+ * \returns the type of the record read.
+ */
+TraceRecordType trace_read(Trace *trace, TraceRecord *record);
+
+/**
+ * Close a trace and free its resources. The records of a created trace are
+ * written to the file.
+ *
+ * \param trace The trace to close.
+ *
+ * \returns true on success, or false if the records couldn't be written.
+ */
+bool trace_close(Trace *trace);
@@ -13,9 +13,14 @@
  */
 bool streq(const char *string1, const char *string2);
 
+#define NS_PER_US 1000ull
+#define NS_PER_MS 1000000ull
+#define NS_PER_S 1000000000ull
+
 /**
- * Get the number of milliseconds since the system was booted.
+ * Get the number of nanoseconds elapsed on the monotonic clock. This is the
+ * clock used by the timers of the event loop.
  *
- * \return the time in milliseconds.
+ * \return the time in nanoseconds.
  */
-uint64_t get_time_ms(void);
+uint64_t get_time_ns(void);